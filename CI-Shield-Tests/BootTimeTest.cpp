@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2024 Jamie Smith
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mbed.h"
+#include "greentea-client/test_env.h"
+#include "unity.h"
+#include "utest.h"
+
+#include <cinttypes>
+
+#include "ci_test_common.h"
+
+using namespace utest::v1;
+
+// This test measures how long the target takes to boot.  The first case resets the target while the host captures
+// the marker pin, and the marker is then pulsed at each stage of the boot:
+// 1. Right before the reset
+// 2. At the start of static initialization (the first constructor to run)
+// 3. At the end of static initialization (in mbed_main())
+// 4. At the start of main()
+// The host measures the time between the pulses, and the device measures the time of each stage with its own timers.
+
+/*
+ * Marker for the boot stages.  Constructed on first use, since the first stage is before the globals are constructed.
+ */
+TestMarker & boot_marker()
+{
+    static TestMarker marker;
+    return marker;
+}
+
+/*
+ * Pulse the marker.  The host uses the rising edges, since the marker pin floats while the target is in reset.
+ */
+void pulse_boot_marker()
+{
+    boot_marker().mark();
+    wait_us(2); // Long enough for the logic analyzer to see at 8MHz
+    boot_marker().mark();
+}
+
+uint32_t now_us()
+{
+    return static_cast<uint32_t>(HighResClock::now().time_since_epoch().count());
+}
+
+// Times of each boot stage.  These are zero-initialized, so they're valid before the static constructors run.
+struct BootTimes {
+    uint32_t kernelToStaticInit; // us from the RTOS kernel starting to the start of static init
+    uint32_t staticInitStart; // us ticker timestamps
+    uint32_t staticInitEnd;
+    uint32_t mainStart;
+};
+BootTimes bootTimes;
+
+// Start time of the construction of each timed global, in order.  The last entry marks the end of the last one.
+struct GlobalConstruction {
+    char const * name;
+    uint32_t startTime;
+};
+constexpr size_t MAX_GLOBAL_CONSTRUCTIONS = 8;
+GlobalConstruction globalConstructions[MAX_GLOBAL_CONSTRUCTIONS];
+size_t numGlobalConstructions;
+
+/*
+ * Record that the construction of a global is starting.  Globals in one file are constructed in order,
+ * so this is called from the initializer of a dummy global just before each timed one.
+ */
+bool start_global_construction(char const * name)
+{
+    if(numGlobalConstructions < MAX_GLOBAL_CONSTRUCTIONS)
+    {
+        globalConstructions[numGlobalConstructions++] = {name, now_us()};
+    }
+    return true;
+}
+
+/*
+ * Runs before any other static constructors (priorities up to 100 are reserved for the implementation).
+ * The RTOS kernel has already started at this point, since Mbed runs static init in the main thread.
+ */
+__attribute__((constructor(101))) void boot_static_init_start()
+{
+    pulse_boot_marker();
+    bootTimes.staticInitStart = now_us();
+    bootTimes.kernelToStaticInit = static_cast<uint64_t>(osKernelGetSysTimerCount()) * 1000000 / osKernelGetSysTimerFreq();
+}
+
+// Peripherals constructed as globals, like several of the other test suites do.  PwmOut and AnalogOut are left
+// out, since they would drive GPOUT_1, which is the marker pin (and the DAC loopback).
+bool const adcTimed = start_global_construction("AnalogIn");
+AnalogIn adc(PIN_ANALOG_IN);
+bool const digitalInTimed = start_global_construction("DigitalIn");
+DigitalIn gpin1(PIN_GPIN_1, PullNone);
+bool const i2cTimed = start_global_construction("I2C");
+I2C i2c(PIN_I2C_SDA, PIN_I2C_SCL);
+bool const spiTimed = start_global_construction("SPI");
+SPI spi(PIN_SPI_MOSI, PIN_SPI_MISO, PIN_SPI_SCLK);
+bool const globalsTimed = start_global_construction(nullptr);
+
+/*
+ * Called by Mbed after the static constructors, right before main()
+ */
+extern "C" void mbed_main()
+{
+    bootTimes.staticInitEnd = now_us();
+    pulse_boot_marker();
+}
+
+/*
+ * Reset the target while the host records the marker.  Does not return.
+ */
+void reset_target()
+{
+    greentea_send_kv("start_boot_capture", "please");
+    assert_next_message_from_host("start_boot_capture", "complete");
+
+    // The reset takes effect within a few instructions of this pulse
+    pulse_boot_marker();
+    system_reset();
+}
+
+/*
+ * Report the boot times measured after the reset
+ */
+void report_boot_times()
+{
+    report_metric("RTOS kernel start to static init start", bootTimes.kernelToStaticInit, "us");
+    report_metric("Static init time", bootTimes.staticInitEnd - bootTimes.staticInitStart, "us");
+    for(size_t constructionIdx = 0; constructionIdx + 1 < numGlobalConstructions; ++constructionIdx)
+    {
+        char metricName[64];
+        snprintf(metricName, sizeof(metricName), "%s constructor time", globalConstructions[constructionIdx].name);
+        report_metric(metricName, globalConstructions[constructionIdx + 1].startTime - globalConstructions[constructionIdx].startTime, "us");
+    }
+    report_metric("Static init end to main", bootTimes.mainStart - bootTimes.staticInitEnd, "us");
+
+    // Host measures the times from the reset, and needs the kernel start time to work out when the kernel started
+    char kernelToStaticInit[16];
+    snprintf(kernelToStaticInit, sizeof(kernelToStaticInit), "%" PRIu32, bootTimes.kernelToStaticInit);
+    greentea_send_kv("report_boot_times", kernelToStaticInit);
+    assert_next_message_from_host("report_boot_times", "complete");
+}
+
+utest::v1::status_t test_setup(const size_t number_of_cases)
+{
+    // Setup Greentea using a reasonable timeout in seconds
+    GREENTEA_SETUP(60, "boot_time_test");
+    utest::v1::status_t status = verbose_test_setup_handler(number_of_cases);
+    if(status != STATUS_CONTINUE)
+    {
+        return status;
+    }
+
+    // Since the first case resets the target, ask the host which case to start at
+    greentea_send_kv("get_start_case", "please");
+    char receivedKey[64], receivedValue[64];
+    do
+    {
+        greentea_parse_kv(receivedKey, receivedValue, sizeof(receivedKey), sizeof(receivedValue));
+    }
+    while(strcmp(receivedKey, "start_case") != 0);
+
+    return static_cast<utest::v1::status_t>(atoi(receivedValue));
+}
+
+// Test cases
+Case cases[] = {
+        Case("Boot Time - Reset Target", reset_target),
+        Case("Boot Time - Measure Boot Stages", report_boot_times),
+};
+
+Specification specification(test_setup, cases, greentea_continue_handlers);
+
+// Entry point into the tests
+int main()
+{
+    bootTimes.mainStart = now_us();
+    pulse_boot_marker();
+
+    return !Harness::run(specification);
+}
@@ -47,6 +47,7 @@ void DigitalIO_PropagationTime_Test()
     propTimer.stop();
 
     printf("0 -> 1 propagation took %" PRIi64 "us.\n", propTimer.elapsed_time().count());
+    report_metric("0 -> 1 propagation time", propTimer.elapsed_time().count(), "us");
     TEST_ASSERT(propTimer.elapsed_time() <= std::chrono::microseconds(GPIO_PROPAGATION_TIME));
 
     propTimer.reset();
@@ -60,6 +61,7 @@ void DigitalIO_PropagationTime_Test()
     propTimer.stop();
 
     printf("1 -> 0 propagation took %" PRIi64 "us.\n", propTimer.elapsed_time().count());
+    report_metric("1 -> 0 propagation time", propTimer.elapsed_time().count(), "us");
     TEST_ASSERT(propTimer.elapsed_time() <= std::chrono::microseconds(GPIO_PROPAGATION_TIME));
 }
 
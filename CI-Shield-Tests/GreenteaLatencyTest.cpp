@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2024 Jamie Smith
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mbed.h"
+#include "greentea-client/test_env.h"
+#include "unity.h"
+#include "utest.h"
+
+#include <cinttypes>
+
+#include "ci_test_common.h"
+
+using namespace utest::v1;
+
+// Measures the latency and throughput of host <-> device round trips through greentea, i.e. what every
+// host interaction in the other test suites costs.  The results depend a lot on the interface chip
+// (debug probe) that the target's serial port goes through, which the host test reports.
+
+// Number of round trips to time for each payload size
+constexpr size_t NUM_ROUND_TRIPS = 50;
+
+// Size of the key and value buffers used for receiving messages.  Matches assert_next_message_from_host().
+constexpr size_t KV_BUFFER_SIZE = 64;
+
+/*
+ * Time round trips where the device sends a message with a payload of the given size, and the host echoes it back.
+ */
+template<size_t payloadSize>
+void greentea_round_trip()
+{
+    static_assert(payloadSize < KV_BUFFER_SIZE, "Payload plus terminator must fit in the receive buffer");
+
+    // Payload can be anything that is not part of the KV syntax
+    char payload[payloadSize + 1];
+    for(size_t charIdx = 0; charIdx < payloadSize; ++charIdx)
+    {
+        payload[charIdx] = 'a' + (charIdx % 26);
+    }
+    payload[payloadSize] = '\0';
+
+    char receivedKey[KV_BUFFER_SIZE], receivedValue[KV_BUFFER_SIZE];
+
+    Timer totalTimer;
+    Timer roundTripTimer;
+    std::chrono::microseconds minRoundTrip = std::chrono::microseconds::max();
+    std::chrono::microseconds maxRoundTrip = std::chrono::microseconds::zero();
+
+    totalTimer.start();
+    for(size_t roundTripIdx = 0; roundTripIdx < NUM_ROUND_TRIPS; ++roundTripIdx)
+    {
+        roundTripTimer.reset();
+        roundTripTimer.start();
+
+        greentea_send_kv("echo", payload);
+        greentea_parse_kv(receivedKey, receivedValue, sizeof(receivedKey), sizeof(receivedValue));
+
+        roundTripTimer.stop();
+
+        TEST_ASSERT_EQUAL_STRING("echo", receivedKey);
+        TEST_ASSERT_EQUAL_STRING(payload, receivedValue);
+
+        auto const roundTripTime = std::chrono::duration_cast<std::chrono::microseconds>(roundTripTimer.elapsed_time());
+        minRoundTrip = std::min(minRoundTrip, roundTripTime);
+        maxRoundTrip = std::max(maxRoundTrip, roundTripTime);
+    }
+    totalTimer.stop();
+
+    auto const totalTime = std::chrono::duration_cast<std::chrono::microseconds>(totalTimer.elapsed_time());
+    printf("%zu round trips with a %zu byte payload took %" PRIi64 "us.\n", NUM_ROUND_TRIPS, payloadSize, totalTime.count());
+
+    double const meanRoundTripUs = static_cast<double>(totalTime.count()) / NUM_ROUND_TRIPS;
+    report_metric("Mean round trip time", meanRoundTripUs, "us");
+    report_metric("Min round trip time", minRoundTrip.count(), "us");
+    report_metric("Max round trip time", maxRoundTrip.count(), "us");
+
+    // Payload bytes moved in both directions.  Does not count the KV framing and key.
+    report_metric("Payload throughput", (2.0 * payloadSize * NUM_ROUND_TRIPS) / (totalTime.count() / 1e6), "B/s");
+}
+
+utest::v1::status_t test_setup(const size_t number_of_cases)
+{
+    // Setup Greentea using a reasonable timeout in seconds
+    GREENTEA_SETUP(60, "greentea_latency_test");
+    return verbose_test_setup_handler(number_of_cases);
+}
+
+// Test cases
+Case cases[] = {
+    Case("Round Trip with 1 Byte Payload", greentea_round_trip<1>),
+    Case("Round Trip with 8 Byte Payload", greentea_round_trip<8>),
+    Case("Round Trip with 16 Byte Payload", greentea_round_trip<16>),
+    Case("Round Trip with 32 Byte Payload", greentea_round_trip<32>),
+    Case("Round Trip with 63 Byte Payload", greentea_round_trip<63>),
+};
+
+Specification specification(test_setup, cases, greentea_continue_handlers);
+
+// Entry point into the tests
+int main()
+{
+    return !Harness::run(specification);
+}
@@ -37,22 +37,41 @@ using namespace utest::v1;
 I2C * i2c;
 
 /*
- * Uses the host test to start I2C logging from the device
+ * Uses the host test to start I2C logging from the device.
+ * Returns once the logic analyzer is armed.
  */
 void host_start_i2c_logging()
 {
     // Note: Value is not important but cannot be empty
-    greentea_send_kv("start_recording_i2c", "please");
-    assert_next_message_from_host("start_recording_i2c", "complete");
+    host_request_capture("start_recording_i2c", "please");
 }
 
 /*
- * Check that the host test saw the specified sequence on the wire
+ * Check that the host test saw the specified sequence on the wire.
+ * The verdict is collected asynchronously, at the latest when the test case finishes.
  */
 void host_verify_sequence(char const * sequenceName)
 {
-    greentea_send_kv("verify_sequence", sequenceName);
-    assert_next_message_from_host("verify_sequence", "complete");
+    host_request_verdict("verify_sequence", sequenceName);
+}
+
+/*
+ * Ask the host to start recording the marker and SDA, to measure latencies with a TestMarker.
+ * Returns once the logic analyzer is armed.
+ */
+void host_start_marker_capture()
+{
+    // Note: Value is not important but cannot be empty
+    host_request_capture("start_marker_capture", "please");
+}
+
+/*
+ * Ask the host to report the latency from the marker to the start condition.
+ * apiName is the name of the call that was measured.
+ */
+void host_report_start_latency(char const * apiName)
+{
+    host_request_verdict("report_start_latency", apiName);
 }
 
 #if STATIC_PINMAP_READY
@@ -93,6 +112,32 @@ void test_correct_addr_read_transaction()
 	TEST_ASSERT_EQUAL(I2C::Result::ACK, i2c->read(EEPROM_I2C_ADDRESS | 1, nullptr, 0));
 }
 
+// Measure the latency from calling start() to the start condition on the bus
+void measure_start_latency()
+{
+    TestMarker marker;
+    host_start_marker_capture();
+
+    marker.mark();
+	i2c->start();
+	TEST_ASSERT_EQUAL(I2C::Result::ACK, i2c->write_byte(EEPROM_I2C_ADDRESS));
+	i2c->stop();
+
+    host_report_start_latency("start()");
+}
+
+// Measure the latency from calling the transaction API to the start condition on the bus
+void measure_transaction_start_latency()
+{
+    TestMarker marker;
+    host_start_marker_capture();
+
+    marker.mark();
+	TEST_ASSERT_EQUAL(I2C::Result::ACK, i2c->write(EEPROM_I2C_ADDRESS, nullptr, 0, false));
+
+    host_report_start_latency("write()");
+}
+
 // Test that we receive a NACK when trying to use an address that doesn't exist
 void test_incorrect_addr_single_byte()
 {
@@ -264,10 +309,12 @@ void test_simple_write_async()
     host_start_i2c_logging();
 
     uint8_t const data[3] = {0x0, 0x01, 0x02}; // Writes 0x2 to address 1
+    CI_TEST_TRACE(TransferStart, sizeof(data));
     TEST_ASSERT_EQUAL(I2C::Result::ACK, i2c->transfer_and_wait(EEPROM_I2C_ADDRESS,
                                                                reinterpret_cast<const char *>(data), sizeof(data),
                                                                nullptr, 0,
                                                                1s));
+    CI_TEST_TRACE(TransferComplete, sizeof(data));
 
     // Maximum program time before the EEPROM responds again
     ThisThread::sleep_for(5ms);
@@ -282,9 +329,11 @@ void test_simple_read_async()
     // Set read address to 1, then read the data back in one fell swoop.
     uint8_t const writeData[2] = {0x0, 0x01};
     uint8_t readByte = 0;
+    CI_TEST_TRACE(TransferStart, sizeof(writeData) + 1);
     TEST_ASSERT_EQUAL(I2C::Result::ACK, i2c->transfer_and_wait(EEPROM_I2C_ADDRESS, reinterpret_cast<const char *>(writeData), sizeof(writeData),
                                                                reinterpret_cast<char *>(&readByte), 1,
                                                                1s));
+    CI_TEST_TRACE(TransferComplete, sizeof(writeData) + 1);
 
     TEST_ASSERT_EQUAL_UINT8(0x2, readByte);
 
@@ -381,6 +430,7 @@ void test_repeated_single_byte_to_async()
 volatile bool threadRan = false;
 void background_thread_func()
 {
+    CI_TEST_TRACE(Mark, 0);
     threadRan = true;
 }
 
@@ -394,9 +444,11 @@ void async_causes_thread_to_sleep()
 
     uint8_t const writeData[2] = {0x0, 0x01};
     uint8_t readByte = 0;
+    CI_TEST_TRACE(TransferStart, sizeof(writeData) + 1);
     TEST_ASSERT_EQUAL(I2C::Result::ACK, i2c->transfer_and_wait(EEPROM_I2C_ADDRESS, reinterpret_cast<const char *>(writeData), sizeof(writeData),
                                                                reinterpret_cast<char *>(&readByte), 1,
                                                                1s));
+    CI_TEST_TRACE(TransferComplete, sizeof(writeData) + 1);
 
     TEST_ASSERT_EQUAL_UINT8(0x2, readByte);
     TEST_ASSERT(threadRan);
@@ -425,7 +477,7 @@ utest::v1::status_t test_setup(const size_t number_of_cases)
 void test_teardown(const size_t passed, const size_t failed, const failure_t failure)
 {
     delete i2c;
-    return greentea_test_teardown_handler(passed, failed, failure);
+    return pipelined_test_teardown_handler(passed, failed, failure);
 }
 
 // Macro to help with async tests (can only run them if the device has the I2C_ASYNCH feature)
@@ -439,6 +491,8 @@ void test_teardown(const size_t passed, const size_t failed, const failure_t fai
 Case cases[] = {
 		Case("Correct Address - Single Byte", test_correct_addr_single_byte),
 		Case("Correct Address - Transaction", test_correct_addr_transaction),
+        Case("Measure Latency of start()", measure_start_latency),
+        Case("Measure Latency of Transaction", measure_transaction_start_latency),
         Case("Incorrect Address - Single Byte", test_incorrect_addr_single_byte),
 		Case("Incorrect Address - Zero Length Transaction", test_incorrect_addr_zero_len_transaction),
         Case("Incorrect Address - Write Transaction", test_incorrect_addr_write_transaction),
@@ -461,7 +515,7 @@ Case cases[] = {
         ADD_ASYNC_TEST(Case("Async causes thread to sleep?", async_causes_thread_to_sleep))
 };
 
-Specification specification(test_setup, cases, test_teardown, greentea_continue_handlers);
+Specification specification(test_setup, cases, test_teardown, pipelined_host_handlers);
 
 // Entry point into the tests
 int main()
@@ -25,6 +25,7 @@
 #include "utest.h"
 #include <I2CEEBlockDevice.h>
 #include "ci_test_common.h"
+#include "ci_test_profiler.h"
 
 using namespace utest::v1;
 
@@ -45,7 +46,9 @@ void init_string(char* buffer, int len)
 	DEBUG_PRINTF("\r\n****\r\nBuffer Len = `%d`, String = `%s`\r\n****\r\n",len,buffer);
 }
 
-constexpr size_t MAX_TEST_SIZE = 2048;
+// Size of the largest transfer.  Sized from the target's RAM (we need two buffers of it), but limited to a
+// fraction of the EEPROM so that writing it does not take forever.
+constexpr size_t MAX_TEST_SIZE = std::min<size_t>(BENCH_WORKING_SET_SIZE / 2, EEPROM_SIZE / 8);
 
 char test_string[MAX_TEST_SIZE];
 char read_string[MAX_TEST_SIZE];
@@ -65,8 +68,19 @@ void flash_WR()
 
 	DEBUG_PRINTF("\r\n****\r\n Test String = `%s` \r\n****\r\n", test_string);
 
+	profiler_start();
+
+	Timer programTimer;
+	programTimer.start();
 	int programRet = memory.program((const void *) test_string, address, size_of_data);
+	programTimer.stop();
+
+	Timer readTimer;
+	readTimer.start();
 	int readRet = memory.read((void *) read_string, address, size_of_data);
+	readTimer.stop();
+
+	profiler_stop();
 
 	if (programRet != BD_ERROR_OK || readRet != BD_ERROR_OK) {
 		// No point in the other asserts
@@ -84,6 +98,12 @@ void flash_WR()
 		DEBUG_PRINTF(
 				"\r\n****\r\n Address = `%d`\r\n Len = `%d`\r\n Written String = `%s` \r\n Read String = `%s` \r\n****\r\n",
 				address, size_of_data, test_string, read_string);
+
+		// Throughputs include the EEPROM's internal write cycle time, so they're what an application would see
+		auto const programTime = std::chrono::duration_cast<std::chrono::microseconds>(programTimer.elapsed_time());
+		auto const readTime = std::chrono::duration_cast<std::chrono::microseconds>(readTimer.elapsed_time());
+		report_metric("Write throughput", size_of_data / (programTime.count() / 1e6), "B/s");
+		report_metric("Read throughput", size_of_data / (readTime.count() / 1e6), "B/s");
 	}
 }
 
@@ -106,6 +126,122 @@ void single_byte_WR()
 	TEST_ASSERT_MESSAGE(test == read, "character written does not match character read")
 }
 
+/*
+ * Read from the EEPROM with one sequential read: the memory address is written once, then after a repeated start
+ * the whole length is read.  The 24FC64 increments its address pointer after each byte (wrapping at the end of the
+ * array), so any length can be read this way, unlike writes, which must be split at page boundaries.
+ */
+template<bool useAsync>
+I2C::Result eeprom_sequential_read(I2C & i2c, uint16_t address, char * buffer, size_t size)
+{
+	char const addressBytes[2] = {static_cast<char>(address >> 8), static_cast<char>(address & 0xFF)};
+#if DEVICE_I2C_ASYNCH
+	if(useAsync)
+	{
+		return i2c.transfer_and_wait(EEPROM_I2C_ADDRESS, addressBytes, sizeof(addressBytes), buffer, size, 2s);
+	}
+#endif
+	I2C::Result result = i2c.write(EEPROM_I2C_ADDRESS, addressBytes, sizeof(addressBytes), true);
+	if(result != I2C::Result::ACK)
+	{
+		i2c.stop();
+		return result;
+	}
+	return i2c.read(EEPROM_I2C_ADDRESS | 1, buffer, size);
+}
+
+// Test reading the whole working set with one sequential read, and check on the logic analyzer that there was
+// only one address phase
+template<uint32_t busSpeed, bool useAsync>
+void sequential_read()
+{
+	// Program the data with the block device.  This is not recorded, since it takes one address phase per page.
+	init_string(test_string, MAX_TEST_SIZE);
+	{
+		I2CEEBlockDevice memory(PIN_I2C_SDA, PIN_I2C_SCL, EEPROM_I2C_ADDRESS, EEPROM_SIZE, EEPROM_BLOCK_SIZE, busSpeed,
+		                        EEPROM_ADDRESS_8_BIT);
+		TEST_ASSERT_EQUAL(BD_ERROR_OK, memory.program(test_string, 0, MAX_TEST_SIZE));
+	}
+	memset(read_string, 0, MAX_TEST_SIZE);
+
+	I2C i2c(PIN_I2C_SDA, PIN_I2C_SCL);
+	i2c.frequency(busSpeed);
+
+	// Monitor the bus for twice the time the read should take (9 clocks per byte), plus some margin.  The address
+	// phases are counted as the capture is decoded, so it is never stored.
+	char recordTime[16];
+	snprintf(recordTime, sizeof(recordTime), "%.3f", 2.0 * 9 * MAX_TEST_SIZE / busSpeed + 0.1);
+	greentea_send_kv("start_monitoring_i2c", recordTime);
+	assert_next_message_from_host("start_monitoring_i2c", "complete");
+
+	Timer readTimer;
+	readTimer.start();
+	I2C::Result readRet = eeprom_sequential_read<useAsync>(i2c, 0, read_string, MAX_TEST_SIZE);
+	readTimer.stop();
+
+	TEST_ASSERT_EQUAL(I2C::Result::ACK, readRet);
+	TEST_ASSERT_MESSAGE(memcmp(test_string, read_string, MAX_TEST_SIZE) == 0, "Data read does not match the data written");
+
+	// Expect one write of the memory address and one read
+	char eepromAddress[8];
+	snprintf(eepromAddress, sizeof(eepromAddress), "0x%02x", EEPROM_I2C_ADDRESS);
+	greentea_send_kv("count_i2c_address_phases", eepromAddress);
+	assert_next_message_from_host("count_i2c_address_phases", "1,1");
+
+	auto const readTime = std::chrono::duration_cast<std::chrono::microseconds>(readTimer.elapsed_time());
+	report_metric("Sequential read throughput", MAX_TEST_SIZE / (readTime.count() / 1e6), "B/s");
+}
+
+// Number of reads made with each block device by the object switching benchmark
+constexpr size_t SWITCH_BENCHMARK_READS = 20;
+
+// Benchmark the cost of switching between two I2CEEBlockDevices on the same bus, one at 100kHz and one at 400kHz.
+// Each I2C object's frequency is applied to the peripheral whenever that object takes over the bus, so alternating
+// between the devices pays this cost on every read.  The same single byte reads are timed grouped by device and
+// then alternating between devices, and the difference is the time spent switching.
+void benchmark_i2c_object_switching()
+{
+	I2CEEBlockDevice memory100k(PIN_I2C_SDA, PIN_I2C_SCL, EEPROM_I2C_ADDRESS, EEPROM_SIZE, EEPROM_BLOCK_SIZE, 100000,
+	                            EEPROM_ADDRESS_8_BIT);
+	I2CEEBlockDevice memory400k(PIN_I2C_SDA, PIN_I2C_SCL, EEPROM_I2C_ADDRESS, EEPROM_SIZE, EEPROM_BLOCK_SIZE, 400000,
+	                            EEPROM_ADDRESS_8_BIT);
+	I2CEEBlockDevice * const memories[] = {&memory100k, &memory400k};
+	char readByte;
+
+	// Grouped: the object only changes once
+	Timer groupedTimer;
+	groupedTimer.start();
+	for(I2CEEBlockDevice * memory : memories)
+	{
+		for(size_t readIdx = 0; readIdx < SWITCH_BENCHMARK_READS; ++readIdx)
+		{
+			TEST_ASSERT_EQUAL(BD_ERROR_OK, memory->read(&readByte, readIdx, 1));
+		}
+	}
+	groupedTimer.stop();
+
+	// Alternating: the object changes on every read
+	Timer alternatingTimer;
+	alternatingTimer.start();
+	for(size_t readIdx = 0; readIdx < SWITCH_BENCHMARK_READS; ++readIdx)
+	{
+		for(I2CEEBlockDevice * memory : memories)
+		{
+			TEST_ASSERT_EQUAL(BD_ERROR_OK, memory->read(&readByte, readIdx, 1));
+		}
+	}
+	alternatingTimer.stop();
+
+	constexpr size_t numReads = SWITCH_BENCHMARK_READS * 2;
+	constexpr size_t extraSwitches = numReads - 2;
+	auto const groupedTime = std::chrono::duration_cast<std::chrono::microseconds>(groupedTimer.elapsed_time());
+	auto const alternatingTime = std::chrono::duration_cast<std::chrono::microseconds>(alternatingTimer.elapsed_time());
+
+	report_metric("Mean read time (grouped by device)", static_cast<float>(groupedTime.count()) / numReads, "us");
+	report_metric("Mean read time (alternating devices)", static_cast<float>(alternatingTime.count()) / numReads, "us");
+	report_metric("Object switch time", static_cast<float>(alternatingTime.count() - groupedTime.count()) / extraSwitches, "us");
+}
+
 utest::v1::status_t test_setup(const size_t number_of_cases)
 {
     // Initialize logic analyzer for I2C pinouts
@@ -113,7 +249,7 @@ utest::v1::status_t test_setup(const size_t number_of_cases)
     funcSelPins = 0b001;
 
 	// Setup Greentea using a reasonable timeout in seconds
-	GREENTEA_SETUP(20, "i2c_record_only_test");
+	GREENTEA_SETUP(60, "i2c_record_only_test");
 	return verbose_test_setup_handler(number_of_cases);
 }
 
@@ -153,14 +289,23 @@ Case cases[] = {
 		Case("I2C - 100kHz - EEPROM 2nd WR 2 Bytes", start_logging_case_setup, flash_WR<100000, 2, 1029>, display_data_case_teardown),
 		Case("I2C - 100kHz - EEPROM WR 1 Page", start_logging_case_setup, flash_WR<100000, EEPROM_BLOCK_SIZE, 100>, display_data_case_teardown),
 		Case("I2C - 100kHz - EEPROM 2nd WR 1 Page", start_logging_case_setup, flash_WR<100000, EEPROM_BLOCK_SIZE, 1124>, display_data_case_teardown),
-		Case("I2C - 100kHz - EEPROM WR 2kiB", start_logging_case_setup, flash_WR<100000, MAX_TEST_SIZE, 0>, display_data_case_teardown),
+		Case("I2C - 100kHz - EEPROM WR Working Set", start_logging_case_setup, flash_WR<100000, MAX_TEST_SIZE, 0>, display_data_case_teardown),
+		Case("I2C - 100kHz - EEPROM Sequential Read Working Set", sequential_read<100000, false>),
+#if DEVICE_I2C_ASYNCH
+		Case("I2C - 100kHz - EEPROM Sequential Read Working Set - Async", sequential_read<100000, true>),
+#endif
 		Case("I2C - 400kHz - EEPROM WR Single Byte", start_logging_case_setup, single_byte_WR<400000, 1>, display_data_case_teardown),
 		Case("I2C - 400kHz - EEPROM 2nd WR Single Byte", start_logging_case_setup, single_byte_WR<400000, 1025>, display_data_case_teardown),
 		Case("I2C - 400kHz - EEPROM WR 2 Bytes", start_logging_case_setup, flash_WR<400000, 2, 5>, display_data_case_teardown),
 		Case("I2C - 400kHz - EEPROM 2nd WR 2 Bytes", start_logging_case_setup, flash_WR<400000, 2, 1029>, display_data_case_teardown),
 		Case("I2C - 400kHz - EEPROM WR 1 Page", start_logging_case_setup, flash_WR<400000, EEPROM_BLOCK_SIZE, 100>, display_data_case_teardown),
 		Case("I2C - 400kHz - EEPROM 2nd WR 1 Page",start_logging_case_setup,  flash_WR<400000, EEPROM_BLOCK_SIZE, 1124>, display_data_case_teardown),
-		Case("I2C - 400kHz - EEPROM WR 2kiB", start_logging_case_setup, flash_WR<400000, MAX_TEST_SIZE, 0>, display_data_case_teardown),
+		Case("I2C - 400kHz - EEPROM WR Working Set", start_logging_case_setup, flash_WR<400000, MAX_TEST_SIZE, 0>, display_data_case_teardown),
+		Case("I2C - 400kHz - EEPROM Sequential Read Working Set", sequential_read<400000, false>),
+#if DEVICE_I2C_ASYNCH
+		Case("I2C - 400kHz - EEPROM Sequential Read Working Set - Async", sequential_read<400000, true>),
+#endif
+		Case("I2C - 100kHz/400kHz - EEPROM Object Switching", benchmark_i2c_object_switching),
 };
 
 Specification specification(test_setup, cases, greentea_continue_handlers);
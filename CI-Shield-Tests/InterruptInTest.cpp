@@ -25,6 +25,8 @@
 #include "ci_test_common.h"
 //#include "rtos.h"
 
+#include <algorithm>
+
 using namespace utest::v1;
 
 volatile bool result = false;
@@ -80,6 +82,54 @@ void InterruptInTest()
 	}
 }
 
+// Number of edges to average the interrupt latency over
+constexpr size_t LATENCY_ITERATIONS = 100;
+
+volatile bool latencyCallbackDone = false;
+volatile uint32_t latencyCallbackTimestamp = 0; // us
+
+// Callback for the latency test.  Linked into RAM in the -ram-isr variant of this test.
+CI_TEST_RAMFUNC void latency_cbfn()
+{
+	latencyCallbackTimestamp = static_cast<uint32_t>(HighResClock::now().time_since_epoch().count());
+	latencyCallbackDone = true;
+}
+
+// Measure the time from driving a rising edge on dout_pin to the InterruptIn callback running
+template <PinName int_pin, PinName dout_pin>
+void measure_interrupt_latency()
+{
+	InterruptIn intin(int_pin);
+	DigitalOut dout(dout_pin, 0);
+	wait_us(GPIO_PROPAGATION_TIME);
+	intin.rise(latency_cbfn);
+
+	uint32_t totalLatency = 0;
+	uint32_t maxLatency = 0;
+	for(size_t iteration = 0; iteration < LATENCY_ITERATIONS; ++iteration)
+	{
+		latencyCallbackDone = false;
+		uint32_t const edgeTimestamp = static_cast<uint32_t>(HighResClock::now().time_since_epoch().count());
+		dout = 1;
+
+		Timer timeoutTimer;
+		timeoutTimer.start();
+		while(!latencyCallbackDone && timeoutTimer.elapsed_time() < 10ms) {}
+		TEST_ASSERT_MESSAGE(latencyCallbackDone, "cbfn was not triggered on rising edge of pin");
+
+		uint32_t const latency = latencyCallbackTimestamp - edgeTimestamp;
+		totalLatency += latency;
+		maxLatency = std::max(maxLatency, latency);
+
+		dout = 0;
+		wait_us(GPIO_PROPAGATION_TIME);
+	}
+
+	// Timestamps only have 1us resolution, but the error averages out over the iterations
+	report_metric("Mean latency from edge to callback", static_cast<double>(totalLatency) / LATENCY_ITERATIONS, "us");
+	report_metric("Max latency from edge to callback", maxLatency, "us");
+}
+
 utest::v1::status_t test_setup(const size_t number_of_cases)
 {
 	// Setup Greentea using a reasonable timeout in seconds
@@ -108,6 +158,7 @@ Case cases[] = {
 		Case("Interrupt from GPIN_1 -> GPOUT_1", InterruptInTest<PIN_GPOUT_1_PWM,PIN_GPIN_1>,greentea_failure_handler),
 		Case("Interrupt from GPOUT_0 -> GPIN_0", InterruptInTest<PIN_GPIN_0,PIN_GPOUT_0>,greentea_failure_handler),
 		Case("Interrupt from GPIN_0 -> GPOUT_0", InterruptInTest<PIN_GPOUT_0,PIN_GPIN_0>,greentea_failure_handler),
+		Case("Measure Latency from GPOUT_0 -> GPIN_0", measure_interrupt_latency<PIN_GPIN_0,PIN_GPOUT_0>,greentea_failure_handler),
 };
 
 Specification specification(test_setup, cases);
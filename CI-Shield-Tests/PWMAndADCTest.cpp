@@ -196,6 +196,26 @@ void test_adc_analog_value()
     }
 }
 
+/*
+ * Measure how long one ADC read takes, including the conversion and the driver overhead.
+ */
+void measure_adc_read_time()
+{
+    const size_t numReads = 1000;
+
+    Timer readTimer;
+    readTimer.start();
+    for(size_t readIdx = 0; readIdx < numReads; ++readIdx)
+    {
+        adc.read_u16();
+    }
+    readTimer.stop();
+
+    const double readTimeUs = std::chrono::duration_cast<std::chrono::microseconds>(readTimer.elapsed_time()).count() / static_cast<double>(numReads);
+    printf("One ADC read took %.02fus on average.\n", readTimeUs);
+    report_metric("ADC read time", readTimeUs, "us");
+}
+
 /*
  * Test that we are actually hitting the PWM frequencies and duty cycles we are supposed to be.
  * This uses the Sigrok logic analyzer to detect the duty cycle and PWM frequency
@@ -299,6 +319,7 @@ Case cases[] = {
     Case("Test that target.default-adc-vref is set", verify_target_default_adc_vref_set),
     Case("Test reading digital values with the ADC", test_adc_digital_value),
     Case("Test reading analog values with the ADC", test_adc_analog_value),
+    Case("Measure ADC read time", measure_adc_read_time),
     Case("Test PWM frequency and duty cycle (freq = 50 Hz)", test_pwm<20000>),
     Case("Test PWM frequency and duty cycle (freq = 1 kHz)", test_pwm<1000>),
     Case("Test PWM frequency and duty cycle (freq = 10 kHz)", test_pwm<100>),
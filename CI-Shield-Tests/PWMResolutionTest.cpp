@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2024 Jamie Smith
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mbed.h"
+#include "static_pinmap.h"
+#include "greentea-client/test_env.h"
+#include "unity.h"
+#include "utest.h"
+
+#include "ci_test_common.h"
+
+#include <cmath>
+
+using namespace utest::v1;
+
+// This test characterizes the duty cycle resolution of PwmOut across periods from 1us to 20ms, so that we know
+// which PWM frequencies are usable for what on each target.  For each period, it finds the smallest step in duty
+// cycle that the hardware can actually make.
+//
+// Mbed has no input capture API, so the device side of the measurement reads the duty cycle back with
+// PwmOut::read(), which HALs calculate from the timer's compare and reload registers.  Where the readback is
+// quantized, the first write that changes it gives the step directly, at any period.  The logic analyzer then
+// confirms the step wherever it is long enough for the analyzer to see (it samples every 125ns, and can only
+// record a limited number of periods).  If the HAL just returns the value that was written, the step can only be
+// found with the analyzer, so the result is an upper bound, limited by the analyzer's precision.
+
+#if STATIC_PINMAP_READY
+constexpr auto pwmPinmap = get_pwm_pinmap(PIN_GPOUT_1_PWM);
+PwmOut pwmOut(pwmPinmap);
+#else
+PwmOut pwmOut(PIN_GPOUT_1_PWM);
+#endif
+
+// Duty cycle that the steps are made from
+constexpr float BASE_DUTY_CYCLE = 0.5f;
+
+// Smallest and largest duty cycle steps to try
+constexpr float MIN_DUTY_STEP = 1e-6f;
+constexpr float MAX_DUTY_STEP = 0.25f;
+
+// Sample period of the logic analyzer (which runs at 8MHz) and length of its recording, from sigrok_interface.py
+constexpr float ANALYZER_SAMPLE_PERIOD_US = 0.125f;
+constexpr float ANALYZER_RECORD_TIME_US = 100000;
+
+/*
+ * Get and return the frequency and duty cycle of the current signal via the host test.
+ */
+std::pair<float, float> read_freq_and_duty_cycle_via_host_test()
+{
+    // Use the host test to measure the signal attributes
+    greentea_send_kv("analyze_signal", "please");
+
+    char receivedKey[64], receivedValue[64];
+    float measuredFrequencyHz = 0;
+    float measuredDutyCycle = 0;
+    while (1) {
+        greentea_parse_kv(receivedKey, receivedValue, sizeof(receivedKey), sizeof(receivedValue));
+
+        if(strncmp("frequency", receivedKey, sizeof(receivedKey) - 1) == 0)
+        {
+            measuredFrequencyHz = atof(receivedValue);
+        }
+        if(strncmp("duty_cycle", receivedKey, sizeof(receivedKey) - 1) == 0)
+        {
+            measuredDutyCycle = atof(receivedValue);
+
+            // We get the duty cycle second so we can break once we have it
+            break;
+        }
+    }
+
+    return std::make_pair(measuredFrequencyHz, measuredDutyCycle);
+}
+
+/*
+ * Get the uncertainty of one duty cycle measurement by the logic analyzer at the given period.
+ * Each edge can be off by up to one sample, and the partial period at the end of the recording
+ * can be off by up to a whole period.
+ */
+float analyzer_duty_cycle_uncertainty(float periodUs)
+{
+    return ANALYZER_SAMPLE_PERIOD_US / periodUs + periodUs / ANALYZER_RECORD_TIME_US;
+}
+
+/*
+ * Set the duty cycle and measure it with the logic analyzer
+ */
+float measure_duty_cycle(float dutyCycle)
+{
+    pwmOut.write(dutyCycle);
+    return read_freq_and_duty_cycle_via_host_test().second;
+}
+
+/*
+ * Find the smallest duty cycle step the logic analyzer can see, starting from the smallest step that it could
+ * possibly resolve.  Returns 0 if no step up to the maximum produced a change.
+ */
+float find_duty_step_with_analyzer(float periodUs)
+{
+    float const uncertainty = analyzer_duty_cycle_uncertainty(periodUs);
+    float const baseDutyCycle = measure_duty_cycle(BASE_DUTY_CYCLE);
+
+    for(float step = 4 * uncertainty; step <= MAX_DUTY_STEP; step *= 2)
+    {
+        float const measuredStep = measure_duty_cycle(BASE_DUTY_CYCLE + step) - baseDutyCycle;
+        printf("Step of %.04f%% measured as %.04f%%\n", step * 100, measuredStep * 100);
+
+        if(measuredStep > step / 2)
+        {
+            return step;
+        }
+    }
+    return 0;
+}
+
+template<uint32_t periodUs>
+void measure_pwm_resolution()
+{
+    pwmOut.period_us(periodUs);
+
+    // If the HAL returns exactly what we wrote for a step far smaller than any timer can make, it isn't
+    // reading the duty cycle back from the hardware
+    pwmOut.write(BASE_DUTY_CYCLE + MIN_DUTY_STEP);
+    bool const readbackQuantized = pwmOut.read() != BASE_DUTY_CYCLE + MIN_DUTY_STEP;
+
+    float dutyStep;
+    float const uncertainty = analyzer_duty_cycle_uncertainty(periodUs);
+    if(readbackQuantized)
+    {
+        pwmOut.write(BASE_DUTY_CYCLE);
+        float const baseReadback = pwmOut.read();
+
+        // Increase the step until the duty cycle read back from the hardware changes
+        float step = MIN_DUTY_STEP;
+        float readbackStep = 0;
+        for(; step <= MAX_DUTY_STEP; step *= 2)
+        {
+            pwmOut.write(BASE_DUTY_CYCLE + step);
+            readbackStep = pwmOut.read() - baseReadback;
+            if(readbackStep != 0)
+            {
+                break;
+            }
+        }
+        TEST_ASSERT_MESSAGE(readbackStep > 0, "Duty cycle did not change with any step");
+
+        dutyStep = readbackStep;
+        printf("Duty cycle readback is quantized to steps of %.04f%%\n", dutyStep * 100);
+
+        // Confirm the step on the pin, if the analyzer can see it
+        if(dutyStep > 2 * uncertainty)
+        {
+            float const baseDutyCycle = measure_duty_cycle(BASE_DUTY_CYCLE);
+            float const measuredStep = measure_duty_cycle(BASE_DUTY_CYCLE + step) - baseDutyCycle;
+            printf("Host measured the step as %.04f%% (+-%.04f%%)\n", measuredStep * 100, 2 * uncertainty * 100);
+            TEST_ASSERT_FLOAT_WITHIN(2 * uncertainty, dutyStep, measuredStep);
+        }
+        else
+        {
+            printf("Step is too small for the logic analyzer to confirm (+-%.04f%%)\n", uncertainty * 100);
+        }
+    }
+    else
+    {
+        printf("Duty cycle readback is not quantized, measuring the step with the logic analyzer instead\n");
+        if(4 * uncertainty > MAX_DUTY_STEP)
+        {
+            pwmOut.write(0);
+            TEST_SKIP_MESSAGE("Logic analyzer cannot resolve duty cycle steps at this period");
+        }
+        dutyStep = find_duty_step_with_analyzer(periodUs);
+        TEST_ASSERT_MESSAGE(dutyStep > 0, "Logic analyzer did not see the duty cycle change with any step");
+        printf("Note: result is an upper bound, limited by the logic analyzer's resolution at this period\n");
+    }
+
+    report_metric("Duty cycle resolution", dutyStep * 100, "%");
+    report_metric("Pulse width resolution", dutyStep * periodUs * 1000, "ns");
+    report_metric("Effective resolution", std::log2(1 / dutyStep), "bits");
+
+    pwmOut.write(0);
+}
+
+utest::v1::status_t test_setup(const size_t number_of_cases) {
+    // Setup Greentea using a reasonable timeout in seconds.  The cases where the analyzer has to search
+    // for the step make a lot of measurements.
+    GREENTEA_SETUP(400, "signal_analyzer_test");
+
+#ifdef PIN_ANALOG_OUT
+    // DAC pin is connected to GPOUT1 so make sure to tristate it for this test
+    static DigitalIn dacPin(PIN_ANALOG_OUT, PullNone);
+#endif
+
+    return verbose_test_setup_handler(number_of_cases);
+}
+
+// Test cases
+Case cases[] = {
+    Case("PWM Resolution (period = 1us)", measure_pwm_resolution<1>),
+    Case("PWM Resolution (period = 2us)", measure_pwm_resolution<2>),
+    Case("PWM Resolution (period = 5us)", measure_pwm_resolution<5>),
+    Case("PWM Resolution (period = 10us)", measure_pwm_resolution<10>),
+    Case("PWM Resolution (period = 20us)", measure_pwm_resolution<20>),
+    Case("PWM Resolution (period = 50us)", measure_pwm_resolution<50>),
+    Case("PWM Resolution (period = 100us)", measure_pwm_resolution<100>),
+    Case("PWM Resolution (period = 200us)", measure_pwm_resolution<200>),
+    Case("PWM Resolution (period = 500us)", measure_pwm_resolution<500>),
+    Case("PWM Resolution (period = 1ms)", measure_pwm_resolution<1000>),
+    Case("PWM Resolution (period = 2ms)", measure_pwm_resolution<2000>),
+    Case("PWM Resolution (period = 5ms)", measure_pwm_resolution<5000>),
+    Case("PWM Resolution (period = 10ms)", measure_pwm_resolution<10000>),
+    Case("PWM Resolution (period = 20ms)", measure_pwm_resolution<20000>),
+};
+
+Specification specification(test_setup, cases, greentea_continue_handlers);
+
+// Entry point into the tests
+int main()
+{
+    return !Harness::run(specification);
+}
@@ -25,6 +25,7 @@
 #include "unity.h"
 #include "utest.h"
 #include "ci_test_common.h"
+#include "ci_test_profiler.h"
 #include <cinttypes>
 
 using namespace utest::v1;
@@ -95,13 +96,13 @@ void create_spi_object()
 }
 
 /*
- * Uses the host test to start SPI logging from the device
+ * Uses the host test to start SPI logging from the device.
+ * captureSeconds is how long to record for, as a string.
+ * Returns once the logic analyzer is armed.
  */
-void host_start_spi_logging()
+void host_start_spi_logging(char const * captureSeconds = "0.05")
 {
-    // Note: Value is not important but cannot be empty
-    greentea_send_kv("start_recording_spi", "please");
-    assert_next_message_from_host("start_recording_spi", "complete");
+    host_request_capture("start_recording_spi", captureSeconds);
 }
 
 /*
@@ -110,18 +111,56 @@ void host_start_spi_logging()
 void host_print_spi_data()
 {
     // Note: Value is not important but cannot be empty
-    greentea_send_kv("print_spi_data", "please");
-    assert_next_message_from_host("print_spi_data", "complete");
+    host_request_verdict("print_spi_data", "please");
+}
+
+/*
+ * Ask the host to start recording the marker and SCLK, to measure latencies with a TestMarker.
+ * Returns once the logic analyzer is armed.
+ */
+void host_start_marker_capture()
+{
+    host_request_capture("start_marker_capture", "0.05");
+}
+
+/*
+ * Ask the host to report the latency from the first marker to the first SCLK edge.  If numMarkers is 2,
+ * the second marker must be in the transfer callback, and the latency from the last SCLK edge to it is
+ * reported as well.
+ */
+void host_report_marker_latency(int numMarkers)
+{
+    host_request_verdict("report_marker_latency", numMarkers == 2 ? "2" : "1");
 }
 
 /*
- * Assert that the host machine has seen the "standard message" over the SPI bus
+ * Assert that the host machine has seen the "standard message" over the SPI bus.
+ * The verdict is collected asynchronously, at the latest when the test case finishes.
  */
 void host_assert_standard_message()
 {
-    // Note: Value is not important but cannot be empty
-    greentea_send_kv("verify_sequence", "standard_word");
-    assert_next_message_from_host("verify_sequence", "complete");
+    host_request_verdict("verify_sequence", "standard_word");
+}
+
+/*
+ * Assert that the host machine has seen the given Tx data on MOSI, followed by fillLength bytes of fillValue.
+ */
+void host_assert_tx_then_fill(uint8_t const * txData, size_t txLength, size_t fillLength, uint8_t fillValue)
+{
+    // Payload is "<tx data in hex, or - if none> <fill length> <fill value in hex>"
+    // Note: Only meant for short Tx data, longer data is truncated.
+    char payload[64];
+    size_t payloadLength = 0;
+    if(txLength == 0)
+    {
+        payloadLength = snprintf(payload, sizeof(payload), "-");
+    }
+    for(size_t byteIdx = 0; byteIdx < txLength && payloadLength < sizeof(payload) - 24; ++byteIdx)
+    {
+        payloadLength += snprintf(payload + payloadLength, sizeof(payload) - payloadLength, "%02" PRIx8, txData[byteIdx]);
+    }
+    snprintf(payload + payloadLength, sizeof(payload) - payloadLength, " %zu %02" PRIx8, fillLength, fillValue);
+    host_request_verdict("verify_tx_then_fill", payload);
 }
 
 /*
@@ -279,6 +318,98 @@ void free_and_reallocate_spi()
     host_assert_standard_message();
 }
 
+// Number of transfers made with each SPI object by the object switching benchmarks
+constexpr size_t SWITCH_BENCHMARK_TRANSFERS = 100;
+
+/*
+ * Benchmark the cost of switching between SPI objects with different configurations on one bus, in the same
+ * pattern as use_multiple_spi_objects().  Each object's format and frequency are applied to the peripheral
+ * whenever that object takes over the bus, so alternating between the objects pays this cost on every transfer.
+ * The same transfers are timed grouped by object and then alternating between objects, and the difference
+ * is the time spent switching.
+ * spiObjects must already be configured, and doTransfer makes a one byte transfer with the given object.
+ */
+template<typename TransferFunc>
+void time_spi_object_switching(SPI * const (&spiObjects)[3], TransferFunc doTransfer)
+{
+    // Grouped: the object only changes twice
+    Timer groupedTimer;
+    groupedTimer.start();
+    for(SPI * spiObject : spiObjects)
+    {
+        for(size_t transferIdx = 0; transferIdx < SWITCH_BENCHMARK_TRANSFERS; ++transferIdx)
+        {
+            doTransfer(spiObject);
+        }
+    }
+    groupedTimer.stop();
+
+    // Alternating: the object changes on every transfer
+    Timer alternatingTimer;
+    alternatingTimer.start();
+    for(size_t transferIdx = 0; transferIdx < SWITCH_BENCHMARK_TRANSFERS; ++transferIdx)
+    {
+        for(SPI * spiObject : spiObjects)
+        {
+            doTransfer(spiObject);
+        }
+    }
+    alternatingTimer.stop();
+
+    constexpr size_t numTransfers = SWITCH_BENCHMARK_TRANSFERS * 3;
+    constexpr size_t extraSwitches = numTransfers - 3;
+    auto const groupedTime = std::chrono::duration_cast<std::chrono::microseconds>(groupedTimer.elapsed_time());
+    auto const alternatingTime = std::chrono::duration_cast<std::chrono::microseconds>(alternatingTimer.elapsed_time());
+
+    printf("%zu transfers took %" PRIi64 "us grouped by object and %" PRIi64 "us alternating between objects\n",
+           numTransfers, groupedTime.count(), alternatingTime.count());
+
+    report_metric("Mean transfer time (grouped by object)", static_cast<float>(groupedTime.count()) / numTransfers, "us");
+    report_metric("Mean transfer time (alternating objects)", static_cast<float>(alternatingTime.count()) / numTransfers, "us");
+    report_metric("Object switch time", static_cast<float>(alternatingTime.count() - groupedTime.count()) / extraSwitches, "us");
+}
+
+/*
+ * Benchmark switching between SPI objects with the synchronous API
+ */
+void benchmark_spi_object_switching()
+{
+    auto * spi2 = new SPI(PIN_SPI_MOSI, PIN_SPI_MISO, PIN_SPI_SCLK);
+    auto * spi3 = new SPI(PIN_SPI_MOSI, PIN_SPI_MISO, PIN_SPI_SCLK);
+    SPI * const spiObjects[] = {spi, spi2, spi3};
+
+    uint32_t frequency = spiFreq;
+    for(SPI * spiObject : spiObjects)
+    {
+        spiObject->format(8, spiMode);
+        spiObject->frequency(frequency);
+        frequency *= 2;
+    }
+
+    time_spi_object_switching(spiObjects, [](SPI * spiObject) {
+        spiObject->write(standardMessageBytes, 1, nullptr, 0);
+    });
+
+    delete spi2;
+    delete spi3;
+    spi->frequency(spiFreq);
+}
+
+/*
+ * Measure the latency from calling the transactional API to the first clock edge on the bus
+ */
+void measure_transfer_latency()
+{
+    TestMarker marker;
+    spi->format(8, spiMode);
+    host_start_marker_capture();
+
+    marker.mark();
+    spi->write(standardMessageBytes, sizeof(standardMessageBytes), nullptr, 0);
+
+    host_report_marker_latency(1);
+}
+
 #if DEVICE_SPI_ASYNCH
 
 StaticCacheAlignedBuffer<uint8_t, sizeof(standardMessageBytes)> dmaRxBuffer;
@@ -304,14 +435,58 @@ void write_async_rx_only()
     auto ret = spi->transfer_and_wait(nullptr, 0, dmaRxBuffer, sizeof(standardMessageBytes), 1s);
     TEST_ASSERT_EQUAL(ret, 0);
 
-    // Note: Currently Mbed does not respect the default write value for async SPI transactions.
+    // Note: Currently Mbed does not respect the default write value for async SPI transactions on all targets.
     // What's written when the tx buffer is technically undefined but is 0xFF on most platforms.
-    // See https://github.com/ARMmbed/mbed-os/issues/13941
+    // See https://github.com/ARMmbed/mbed-os/issues/13941.  async_rx_fill_value() checks it on targets which
+    // enable app.async-spi-fill-value.
     printf("Got: %hhx %hhx %hhx %hhx\n", dmaRxBuffer[0], dmaRxBuffer[1], dmaRxBuffer[2], dmaRxBuffer[3]);
 
     host_print_spi_data();
 }
 
+/*
+ * Rx-only and asymmetric transfers must clock out the default write value for every byte past the end of
+ * the Tx data.  Uses a sector-sized read, like an SD card block read, so that a fill source that is too
+ * short or doesn't hold still shows up partway through.
+ */
+template<DMAUsage dmaUsage, size_t txLength>
+void async_rx_fill_value()
+{
+    static_assert(txLength <= sizeof(standardMessageBytes), "Tx data comes from the standard message");
+    constexpr size_t rxLength = 512;
+
+    // Not all async SPI HALs do this yet, so it's only checked on targets which enable it in mbed_app.json5
+    TEST_SKIP_UNLESS_MESSAGE(CI_TEST_ASYNC_SPI_FILL_VALUE, "Target's async SPI HAL is not marked as sending the default write value");
+
+    // Long enough to capture 512 bytes at 100kHz plus some slack
+    host_start_spi_logging("0.1");
+    spi->set_dma_usage(dmaUsage);
+    spi->format(8, spiMode);
+
+    DynamicCacheAlignedBuffer<uint8_t> rxData(rxLength);
+    memset(rxData.data(), 0, rxLength);
+
+    auto ret = spi->transfer_and_wait(txLength == 0 ? nullptr : standardMessageBytes, txLength, rxData, rxLength, 1s);
+    TEST_ASSERT_EQUAL(ret, 0);
+
+    // Thanks to the SPI mirror resistor, we receive what was sent on MOSI.
+    // (Unity fails zero length array compares, so this is skipped for the Rx only cases.)
+    if constexpr(txLength > 0)
+    {
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(standardMessageBytes, rxData.data(), txLength);
+    }
+    for(size_t byteIdx = txLength; byteIdx < rxLength; ++byteIdx)
+    {
+        if(rxData[byteIdx] != DEFAULT_WRITE_VALUE)
+        {
+            printf("Byte %zu was 0x%02" PRIx8 " instead of the default write value\n", byteIdx, rxData[byteIdx]);
+            TEST_FAIL_MESSAGE("Default write value not sent for the whole transfer");
+        }
+    }
+
+    host_assert_tx_then_fill(standardMessageBytes, txLength, rxLength - txLength, DEFAULT_WRITE_VALUE);
+}
+
 template<DMAUsage dmaUsage>
 void write_async_tx_rx()
 {
@@ -351,43 +526,135 @@ void write_async_tx_rx_32_bit()
 }
 
 /*
- * This test measures how long it takes to do an asynchronous transaction and how much of that time may
- * be used to execute a foreground thread.
+ * Spin until done becomes true, and return how many times the loop ran.  Comparing this count to the count for the
+ * same amount of time with nothing else going on tells us how much of the CPU was left over for the application,
+ * including the time taken by interrupts.
  */
-template<DMAUsage dmaUsage>
+MBED_NOINLINE uint32_t count_spin_iterations(volatile bool & done)
+{
+    uint32_t iterations = 0;
+    while(!done)
+    {
+        ++iterations;
+    }
+    return iterations;
+}
+
+/*
+ * Count the spin loop iterations in the given time, with nothing else running
+ */
+uint32_t count_idle_spin_iterations(std::chrono::microseconds duration)
+{
+    volatile bool done = false;
+    Timeout timeout;
+    timeout.attach([&]() {
+        done = true;
+    }, duration);
+    return count_spin_iterations(done);
+}
+
+/*
+ * Completion callback for the async benchmark.  Linked into RAM in the -ram-isr variant of this test.
+ */
+CI_TEST_RAMFUNC void async_benchmark_callback(volatile bool * transactionDone, int event)
+{
+    CI_TEST_TRACE(Callback, event);
+    *transactionDone = true;
+}
+
+/*
+ * This test measures how long it takes to do an asynchronous transaction with the given word size, and how
+ * much of the CPU is left over while it executes.
+ * The words are sent straight from, and received straight into, native-width buffers, and the payload
+ * is the same for every word size so that the results can be compared.
+ */
+template<typename WordT, DMAUsage dmaUsage>
 void benchmark_async_transaction()
 {
     spi->set_dma_usage(dmaUsage);
-    spi->format(8, spiMode);
+    spi->format(sizeof(WordT) * 8, spiMode);
+
+    // Transfer half a working set each way, so that the fixed per-transaction overhead doesn't dominate the result
+    constexpr size_t payloadBytes = BENCH_WORKING_SET_SIZE / 2;
+    constexpr size_t numWords = payloadBytes / sizeof(WordT);
+    DynamicCacheAlignedBuffer<WordT> txData(numWords);
+    DynamicCacheAlignedBuffer<WordT> rxData(numWords);
+    for(size_t wordIdx = 0; wordIdx < numWords; ++wordIdx)
+    {
+        // Every byte of each word is different, so that any byte reordering shows up
+        txData.data()[wordIdx] = static_cast<WordT>(0x04030201 + wordIdx * 0x01010101);
+    }
+    memset(rxData.data(), 0, payloadBytes);
 
     Timer transactionTimer;
-    Timer backgroundTimer;
 
     volatile bool transactionDone = false;
-
-    event_callback_t transferCallback([&](int event) {
-        transactionDone = true;
-    });
+    event_callback_t transferCallback(async_benchmark_callback, &transactionDone);
 
     // Kick off the transaction in the main thread
+    profiler_start();
     transactionTimer.start();
-    spi->transfer(longMessage, sizeof(longMessage), nullptr, 0, transferCallback);
+    CI_TEST_TRACE(TransferStart, payloadBytes);
+    spi->transfer(txData.data(), payloadBytes, rxData, payloadBytes, transferCallback);
 
-    // Now count how much time we have free while the transaction executes in the background
-    backgroundTimer.start();
-    while(!transactionDone)
-    {}
-    backgroundTimer.stop();
+    // Now count how much we can get done while the transaction executes in the background
+    uint32_t const backgroundIterations = count_spin_iterations(transactionDone);
     transactionTimer.stop();
+    profiler_stop();
+
+    auto const transactionTime = std::chrono::duration_cast<std::chrono::microseconds>(transactionTimer.elapsed_time());
+    uint32_t const idleIterations = count_idle_spin_iterations(transactionTime);
+    double const cpuAvailableFraction = idleIterations == 0 ? 0 : std::min(1.0, static_cast<double>(backgroundIterations) / idleIterations);
+
+    // MISO is looped back to MOSI, so we should get back exactly what we sent
+    TEST_ASSERT_MESSAGE(memcmp(txData.data(), rxData.data(), payloadBytes) == 0, "Data received does not match data sent");
 
-    printf("Transferred %zu bytes @ %" PRIu32 "kHz in %" PRIi64 "us, with %" PRIi64 "us occurring in the background.\n",
-           sizeof(longMessage), spiFreq / 1000,
-           std::chrono::duration_cast<std::chrono::microseconds>(transactionTimer.elapsed_time()).count(),
-           std::chrono::duration_cast<std::chrono::microseconds>(backgroundTimer.elapsed_time()).count());
+    printf("Transferred %zu bytes as %zu-bit words @ %" PRIu32 "kHz in %" PRIi64 "us, with %.1f%% of the CPU available in the background.\n",
+           payloadBytes, sizeof(WordT) * 8, spiFreq / 1000, transactionTime.count(), cpuAvailableFraction * 100);
     auto oneClockPeriod = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<float>(1.0/spiFreq));
     printf("Note: Based on the byte count and frequency, the theoretical best time for this SPI transaction is %" PRIi64 "us\n",
-            std::chrono::duration_cast<std::chrono::microseconds>(oneClockPeriod * sizeof(longMessage) * 8).count());
-    printf("Note: the above background time does not include overhead from interrupts, which may be significant.\n");
+            std::chrono::duration_cast<std::chrono::microseconds>(oneClockPeriod * payloadBytes * 8).count());
+
+    report_metric("Transaction time", transactionTime.count(), "us");
+    report_metric("Throughput", payloadBytes / (transactionTime.count() / 1e6), "B/s");
+    report_metric("CPU available during transfer", cpuAvailableFraction * 100, "%");
+    report_metric("CPU time used by transfer", (1 - cpuAvailableFraction) * transactionTime.count(), "us");
+}
+
+struct AsyncLatencyState {
+    TestMarker marker;
+    volatile bool transactionDone = false;
+};
+
+/*
+ * Completion callback for the async latency test.  Linked into RAM in the -ram-isr variant of this test.
+ */
+CI_TEST_RAMFUNC void async_latency_callback(AsyncLatencyState * state, int event)
+{
+    state->marker.mark();
+    state->transactionDone = true;
+}
+
+/*
+ * Measure the latency from starting an async transfer to the first clock edge on the bus, and from the last
+ * clock edge to the transfer callback
+ */
+template<DMAUsage dmaUsage>
+void measure_async_transfer_latency()
+{
+    AsyncLatencyState state;
+    spi->set_dma_usage(dmaUsage);
+    spi->format(8, spiMode);
+
+    event_callback_t transferCallback(async_latency_callback, &state);
+
+    host_start_marker_capture();
+
+    state.marker.mark();
+    spi->transfer(standardMessageBytes, sizeof(standardMessageBytes), dmaRxBuffer, sizeof(standardMessageBytes), transferCallback);
+    while(!state.transactionDone) {}
+
+    host_report_marker_latency(2);
 }
 
 template<DMAUsage dmaUsage>
@@ -417,17 +684,21 @@ void async_queue_and_abort()
     // Set up a callback to save the value of the event, if delivered
     volatile int callbackEvent1 = 0;
     event_callback_t transferCallback1([&](int event) {
+        CI_TEST_TRACE(Callback, event);
         callbackEvent1 = event;
     });
 
     volatile int callbackEvent2 = 0;
     event_callback_t transferCallback2([&](int event) {
+        CI_TEST_TRACE(Callback, event);
         callbackEvent2 = event;
     });
 
     // Start two transfers: one which we're going to abort, and one which we will allow to complete.
+    CI_TEST_TRACE(TransferStart, sizeof(longMessage));
     auto ret = spi->transfer(longMessage, sizeof(longMessage), logMessageRxData1, sizeof(longMessage), transferCallback1, SPI_EVENT_ALL);
     TEST_ASSERT_EQUAL(ret, 0);
+    CI_TEST_TRACE(TransferStart, sizeof(longMessage));
     ret = spi->transfer(longMessage, sizeof(longMessage), logMessageRxData2, sizeof(longMessage), transferCallback2, SPI_EVENT_ALL);
     TEST_ASSERT_EQUAL(ret, 0);
 
@@ -435,6 +706,7 @@ void async_queue_and_abort()
     wait_us(384);
 
     // Now cancel the first transfer
+    CI_TEST_TRACE(TransferAbort, 0);
     spi->abort_transfer();
 
     // Allow the second transfer to run to completion
@@ -455,8 +727,7 @@ void async_queue_and_abort()
     TEST_ASSERT_EQUAL(0, callbackEvent1);
     TEST_ASSERT_EQUAL(SPI_EVENT_COMPLETE, callbackEvent2);
 
-    greentea_send_kv("verify_queue_and_abort_test", "please");
-    assert_next_message_from_host("verify_queue_and_abort_test", "pass");
+    host_request_verdict("verify_queue_and_abort_test", "please");
 }
 
 /*
@@ -492,6 +763,34 @@ void async_use_multiple_spi_objects()
     host_assert_standard_message();
 }
 
+/*
+ * Benchmark switching between SPI objects with the asynchronous API
+ */
+template<DMAUsage dmaUsage>
+void async_benchmark_spi_object_switching()
+{
+    auto * spi2 = new SPI(PIN_SPI_MOSI, PIN_SPI_MISO, PIN_SPI_SCLK);
+    auto * spi3 = new SPI(PIN_SPI_MOSI, PIN_SPI_MISO, PIN_SPI_SCLK);
+    SPI * const spiObjects[] = {spi, spi2, spi3};
+
+    uint32_t frequency = spiFreq;
+    for(SPI * spiObject : spiObjects)
+    {
+        spiObject->format(8, spiMode);
+        spiObject->frequency(frequency);
+        spiObject->set_dma_usage(dmaUsage);
+        frequency *= 2;
+    }
+
+    time_spi_object_switching(spiObjects, [](SPI * spiObject) {
+        spiObject->transfer_and_wait(standardMessageBytes, 1, nullptr, 0);
+    });
+
+    delete spi2;
+    delete spi3;
+    spi->frequency(spiFreq);
+}
+
 /*
  * Tests that we can delete the SPI object (causing the peripheral to be deleted) and
  * create it again without bad effects
@@ -532,14 +831,14 @@ utest::v1::status_t test_setup(const size_t number_of_cases)
     static DigitalOut sdcardEnablePin(PIN_SDCARD_ENABLE, 0);
 
     // Setup Greentea using a reasonable timeout in seconds
-    GREENTEA_SETUP(90, "spi_basic_test");
+    GREENTEA_SETUP(120, "spi_basic_test");
     return verbose_test_setup_handler(number_of_cases);
 }
 
 void test_teardown(const size_t passed, const size_t failed, const failure_t failure)
 {
     delete spi;
-    return greentea_test_teardown_handler(passed, failed, failure);
+    return pipelined_test_teardown_handler(passed, failed, failure);
 }
 
 Case cases[] = {
@@ -569,33 +868,51 @@ Case cases[] = {
         Case("Transfer 32 Bit Data via Transactional API (Tx/Rx)", write_transactional_tx_rx<uint32_t>),
 #endif
         Case("Use Multiple SPI Instances (synchronous API)", use_multiple_spi_objects),
+        Case("Benchmark SPI Object Switching (synchronous API)", benchmark_spi_object_switching),
+        Case("Measure Latency of Transactional API", measure_transfer_latency),
 
 #if DEVICE_SPI_ASYNCH
         Case("Send Data via Async Interrupt API (Tx only)", write_async_tx_only<DMA_USAGE_NEVER>),
         Case("Send Data via Async Interrupt API (Rx only)", write_async_rx_only<DMA_USAGE_NEVER>),
+        Case("Read Sector via Async Interrupt API (Rx only)", async_rx_fill_value<DMA_USAGE_NEVER, 0>),
+        Case("Read Sector with Short Tx via Async Interrupt API", async_rx_fill_value<DMA_USAGE_NEVER, 4>),
         Case("Free and Reallocate SPI Instance with Interrupts", async_free_and_reallocate_spi<DMA_USAGE_NEVER>),
         Case("Send Data via Async Interrupt API (Tx/Rx)", write_async_tx_rx<DMA_USAGE_NEVER>),
         Case("Send 16-Bit Data via Interrupt API (Tx/Rx)", write_async_tx_rx_16_bit<DMA_USAGE_NEVER>),
         Case("Send 32-Bit Data via Interrupt API (Tx/Rx)", write_async_tx_rx_32_bit<DMA_USAGE_NEVER>),
-        Case("Benchmark Async SPI via Interrupts", benchmark_async_transaction<DMA_USAGE_NEVER>),
+        Case("Benchmark 8-Bit Async SPI via Interrupts", benchmark_async_transaction<uint8_t, DMA_USAGE_NEVER>),
+        Case("Benchmark 16-Bit Async SPI via Interrupts", benchmark_async_transaction<uint16_t, DMA_USAGE_NEVER>),
+#if DEVICE_SPI_32BIT_WORDS
+        Case("Benchmark 32-Bit Async SPI via Interrupts", benchmark_async_transaction<uint32_t, DMA_USAGE_NEVER>),
+#endif
+        Case("Measure Latency of Async SPI via Interrupts", measure_async_transfer_latency<DMA_USAGE_NEVER>),
         Case("Queueing and Aborting Async SPI via Interrupts", async_queue_and_abort<DMA_USAGE_NEVER>),
         Case("Use Multiple SPI Instances with Interrupts", async_use_multiple_spi_objects<DMA_USAGE_NEVER>),
+        Case("Benchmark SPI Object Switching with Interrupts", async_benchmark_spi_object_switching<DMA_USAGE_NEVER>),
         Case("Send Data via Async DMA API (Tx only)", write_async_tx_only<DMA_USAGE_ALWAYS>),
         Case("Send Data via Async DMA API (Rx only)", write_async_rx_only<DMA_USAGE_ALWAYS>),
+        Case("Read Sector via Async DMA API (Rx only)", async_rx_fill_value<DMA_USAGE_ALWAYS, 0>),
+        Case("Read Sector with Short Tx via Async DMA API", async_rx_fill_value<DMA_USAGE_ALWAYS, 4>),
         Case("Free and Reallocate SPI Instance with DMA", async_free_and_reallocate_spi<DMA_USAGE_ALWAYS>),
         Case("Send Data via Async DMA API (Tx/Rx)", write_async_tx_rx<DMA_USAGE_ALWAYS>),
         Case("Send 16-Bit Data via Async DMA API (Tx/Rx)", write_async_tx_rx_16_bit<DMA_USAGE_ALWAYS>),
         Case("Send 32-Bit Data via Async DMA API (Tx/Rx)", write_async_tx_rx_32_bit<DMA_USAGE_ALWAYS>),
-        Case("Benchmark Async SPI via DMA", benchmark_async_transaction<DMA_USAGE_ALWAYS>),
+        Case("Benchmark 8-Bit Async SPI via DMA", benchmark_async_transaction<uint8_t, DMA_USAGE_ALWAYS>),
+        Case("Benchmark 16-Bit Async SPI via DMA", benchmark_async_transaction<uint16_t, DMA_USAGE_ALWAYS>),
+#if DEVICE_SPI_32BIT_WORDS
+        Case("Benchmark 32-Bit Async SPI via DMA", benchmark_async_transaction<uint32_t, DMA_USAGE_ALWAYS>),
+#endif
+        Case("Measure Latency of Async SPI via DMA", measure_async_transfer_latency<DMA_USAGE_ALWAYS>),
         Case("Queueing and Aborting Async SPI via DMA", async_queue_and_abort<DMA_USAGE_ALWAYS>),
         Case("Use Multiple SPI Instances with DMA", async_use_multiple_spi_objects<DMA_USAGE_ALWAYS>),
+        Case("Benchmark SPI Object Switching with DMA", async_benchmark_spi_object_switching<DMA_USAGE_ALWAYS>),
 
         // Verify that the non-async API can still be used after enabling and using the async API
         Case("Transfer 8 Bit Data via Transactional API (Tx/Rx)", write_transactional_tx_rx<uint8_t>),
 #endif
 };
 
-Specification specification(test_setup, cases, test_teardown, greentea_continue_handlers);
+Specification specification(test_setup, cases, test_teardown, pipelined_host_handlers);
 
 // Entry point into the tests
 int main()
@@ -24,17 +24,36 @@
 #include "unity.h"
 #include "utest.h"
 #include "ci_test_common.h"
+#include "ci_test_sd_card.h"
+#include "ci_test_sd_benchmarks.h"
+#include "ci_test_profiler.h"
 #include "FATFileSystem.h"
 #include "SDBlockDevice.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <memory>
+#include <vector>
+
 using namespace utest::v1;
 
-#define SD_TEST_STRING_MAX 100
+// Length of the file written by the file test, including the terminator.  Sized from the target's RAM, but kept
+// to a fraction of the working set since the SPI traffic for it gets printed by the host test.
+#define SD_TEST_STRING_MAX (BENCH_WORKING_SET_SIZE / 8)
 
 char SD_TEST_STRING[SD_TEST_STRING_MAX] = {0};
+char SD_READ_STRING[SD_TEST_STRING_MAX] = {0};
 
 alignas(SDBlockDevice) uint8_t sdBlockDevMemory[sizeof(SDBlockDevice)];
 
+// Controls power to the SD card
+DigitalOut * sdcardEnablePin;
+
+// Used by the init timing tests.  Remembers the card across test cases so that it can be re-initialized quickly.
+alignas(RawSDCard) uint8_t rawSDCardMemory[sizeof(RawSDCard)];
+RawSDCard * rawSDCard;
+
 /*
  * Wait for the next host message with the given key, and then assert that its
  * value is expectedVal.
@@ -74,6 +93,46 @@ void host_print_spi_data()
 }
 
 
+/*
+ * Uses the host test to start logging SD card commands.  Unlike the SPI data logging above, the host
+ * decodes the SD command frames out of the capture so that the command sequence can be checked.
+ */
+void host_start_sd_command_logging()
+{
+    // Note: Value is not important but cannot be empty
+    host_request_capture("start_recording_sd", "please");
+}
+
+/*
+ * Ask the host to check that the given sequence of SD commands was seen.
+ * The verdict is collected asynchronously, at the latest when the test case finishes.
+ */
+void host_verify_sd_commands(char const * sequenceName)
+{
+    host_request_verdict("verify_sd_commands", sequenceName);
+}
+
+/*
+ * Ask the host to check that the SD commands sent during identification, before the clock was switched to the
+ * data frequency, start with the given sequence.  Used when the data frequency is too fast for the logic analyzer
+ * to decode.
+ */
+void host_verify_sd_init_commands(char const * sequenceName)
+{
+    host_request_verdict("verify_sd_init_commands", sequenceName);
+}
+
+/*
+ * Turn the SD card off and on again, so that it has to be fully initialized
+ */
+void power_cycle_sd_card()
+{
+    *sdcardEnablePin = 0;
+    rtos::ThisThread::sleep_for(100ms);
+    *sdcardEnablePin = 1;
+    rtos::ThisThread::sleep_for(100ms);
+}
+
 void init_string()
 {
     int x = 0;
@@ -191,17 +250,30 @@ void test_sd_file()
     FILE * file = fopen("/sd/test_sd_w.txt", "w");
     TEST_ASSERT_MESSAGE(file != nullptr,"Failed to create file");
 	init_string();
+    profiler_start();
+    Timer writeTimer;
+    writeTimer.start();
+    CI_TEST_TRACE(TransferStart, sizeof(SD_TEST_STRING) - 1);
     TEST_ASSERT_MESSAGE(fprintf(file, SD_TEST_STRING) > 0,"Writing file to sd card failed");
     fclose(file);
+    CI_TEST_TRACE(TransferComplete, sizeof(SD_TEST_STRING) - 1);
+    writeTimer.stop();
 
 	// Now open it and read the string back.
     // Note: Since fprintf will not print the terminating null to the file, the file will have only
     // sizeof(SD_TEST_STRING) - 1 chars.
-	char read_string[SD_TEST_STRING_MAX] = {0};
+	char * const read_string = SD_READ_STRING;
+	memset(read_string, 0, SD_TEST_STRING_MAX);
+    Timer readTimer;
+    readTimer.start();
+    CI_TEST_TRACE(TransferStart, sizeof(SD_TEST_STRING) - 1);
     file = fopen("/sd/test_sd_w.txt", "r");
 	TEST_ASSERT_MESSAGE(file != nullptr,"Failed to open file");
 
 	ret = fread(read_string, sizeof(char), sizeof(SD_TEST_STRING) - 1, file);
+    CI_TEST_TRACE(TransferComplete, ret);
+    readTimer.stop();
+    profiler_stop();
 	TEST_ASSERT_MESSAGE(ret == (sizeof(SD_TEST_STRING) - 1), "Failed to read data");
 	DEBUG_PRINTF("\r\n****\r\nRead '%s' in read test\r\n, read returns %d, string comparison returns %d\r\n****\r\n",read_string, ret, strcmp(read_string,SD_TEST_STRING));
 	TEST_ASSERT_MESSAGE(strcmp(read_string,SD_TEST_STRING) == 0,"String read does not match string written");
@@ -213,6 +285,12 @@ void test_sd_file()
 
 	fclose(file);
 
+    // The write time includes closing (and so flushing) the file, and the read time includes opening it
+    auto const writeTime = std::chrono::duration_cast<std::chrono::microseconds>(writeTimer.elapsed_time());
+    auto const readTime = std::chrono::duration_cast<std::chrono::microseconds>(readTimer.elapsed_time());
+    report_metric("File write throughput", (sizeof(SD_TEST_STRING) - 1) / (writeTime.count() / 1e6), "B/s");
+    report_metric("File read throughput", (sizeof(SD_TEST_STRING) - 1) / (readTime.count() / 1e6), "B/s");
+
 	// Delete the file and make sure it's gone
 	remove("/sd/test_sd_w.txt");
 	TEST_ASSERT(fopen("/sd/test_sd_w.txt", "r") == nullptr);
@@ -226,15 +304,598 @@ void test_sd_file()
     host_print_spi_data();
 }
 
+/*
+ * Block device adapter which times the calls to the block device under it.  FATFileSystem already serializes
+ * every call to its block device with its own mutex, so the calls here never wait for each other, and the time
+ * threads spend waiting for the filesystem has to be measured by the caller.  To allow that, a callback can be
+ * given which is called from the calling thread whenever a call is entered.
+ */
+class TimedBlockDevice : public BlockDevice {
+public:
+    struct Stats {
+        uint32_t calls = 0;
+        std::chrono::microseconds totalTime{};
+        std::chrono::microseconds maxTime{};
+    };
+
+    TimedBlockDevice(BlockDevice * underlying, Callback<void()> onCallEntered = nullptr):
+    underlying(underlying),
+    onCallEntered(onCallEntered)
+    {}
+
+    int init() override { return underlying->init(); }
+    int deinit() override { return underlying->deinit(); }
+    int sync() override { return timed_call([&]() { return underlying->sync(); }); }
+    int read(void * buffer, bd_addr_t addr, bd_size_t size) override { return timed_call([&]() { return underlying->read(buffer, addr, size); }); }
+    int program(const void * buffer, bd_addr_t addr, bd_size_t size) override { return timed_call([&]() { return underlying->program(buffer, addr, size); }); }
+    int erase(bd_addr_t addr, bd_size_t size) override { return timed_call([&]() { return underlying->erase(addr, size); }); }
+    int trim(bd_addr_t addr, bd_size_t size) override { return timed_call([&]() { return underlying->trim(addr, size); }); }
+    bd_size_t get_read_size() const override { return underlying->get_read_size(); }
+    bd_size_t get_program_size() const override { return underlying->get_program_size(); }
+    bd_size_t get_erase_size() const override { return underlying->get_erase_size(); }
+    bd_size_t get_erase_size(bd_addr_t addr) const override { return underlying->get_erase_size(addr); }
+    int get_erase_value() const override { return underlying->get_erase_value(); }
+    bd_size_t size() const override { return underlying->size(); }
+    const char * get_type() const override { return underlying->get_type(); }
+
+    Stats get_stats()
+    {
+        mutex.lock();
+        Stats const statsCopy = stats;
+        mutex.unlock();
+        return statsCopy;
+    }
+
+private:
+    template<typename F>
+    int timed_call(F const & call)
+    {
+        if(onCallEntered)
+        {
+            onCallEntered();
+        }
+
+        auto const callStart = HighResClock::now();
+        int const ret = call();
+        auto const callTime = std::chrono::duration_cast<std::chrono::microseconds>(HighResClock::now() - callStart);
+
+        // Only protects the stats while they're read by get_stats()
+        mutex.lock();
+        ++stats.calls;
+        stats.totalTime += callTime;
+        stats.maxTime = std::max(stats.maxTime, callTime);
+        mutex.unlock();
+        return ret;
+    }
+
+    BlockDevice * underlying;
+    Callback<void()> onCallEntered;
+    rtos::Mutex mutex;
+    Stats stats;
+};
+
+// Settings for the concurrent file access benchmark
+constexpr size_t CONCURRENT_RECORD_SIZE = 128; // Bytes written by each writer operation
+constexpr size_t CONCURRENT_WRITER_OPS = 32; // Operations done by each writer
+constexpr size_t CONCURRENT_MAX_READER_OPS = 64; // Max operations done by each reader
+constexpr size_t CONCURRENT_CONFIG_FILE_SIZE = 512; // Size of the file the readers read
+constexpr uint32_t CONCURRENT_THREAD_STACK_SIZE = 4096;
+
+/*
+ * Latencies of the operations done by one benchmark thread
+ */
+struct ConcurrentWorker {
+    size_t index = 0;
+    uint32_t latencies[std::max(CONCURRENT_WRITER_OPS, CONCURRENT_MAX_READER_OPS)]; // us
+    size_t numOps = 0;
+    size_t bytesMoved = 0;
+    int error = 0;
+
+    // Writers only: time from the start of each operation until its first block device call was entered, which
+    // is mostly time spent waiting for the filesystem lock.  Operations which never reached the block device
+    // are not counted.
+    HighResClock::time_point opStartTime;
+    bool waitingForBlockDevice = false;
+    std::atomic<osThreadId_t> threadId{nullptr};
+    uint32_t blockDeviceWaits[CONCURRENT_WRITER_OPS]; // us
+    size_t numBlockDeviceWaits = 0;
+};
+
+struct ConcurrentBenchmarkState {
+    FATFileSystem * fs;
+    std::vector<ConcurrentWorker> * writers = nullptr; // Only set while the worker threads run
+    std::atomic<bool> writersDone{false};
+};
+
+ConcurrentBenchmarkState concurrentState;
+
+/*
+ * Called by the block device whenever a call is entered.  Records how long the calling writer's current
+ * operation took to get to the block device.
+ */
+void concurrent_block_device_call_entered()
+{
+    if(concurrentState.writers == nullptr)
+    {
+        return;
+    }
+
+    osThreadId_t const currentThread = rtos::ThisThread::get_id();
+    for(ConcurrentWorker & writer : *concurrentState.writers)
+    {
+        if(writer.threadId == currentThread)
+        {
+            if(writer.waitingForBlockDevice)
+            {
+                writer.waitingForBlockDevice = false;
+                writer.blockDeviceWaits[writer.numBlockDeviceWaits++] =
+                    std::chrono::duration_cast<std::chrono::microseconds>(HighResClock::now() - writer.opStartTime).count();
+            }
+            return;
+        }
+    }
+}
+
+/*
+ * Writer thread.  Appends records to its own log file, syncing after each one like a logger would.
+ */
+void concurrent_writer(ConcurrentWorker * worker)
+{
+    worker->threadId = rtos::ThisThread::get_id();
+
+    char path[32];
+    snprintf(path, sizeof(path), "concurrent_%zu.log", worker->index);
+
+    File file;
+    worker->error = file.open(concurrentState.fs, path, O_WRONLY | O_CREAT | O_TRUNC);
+    if(worker->error != 0)
+    {
+        return;
+    }
+
+    char record[CONCURRENT_RECORD_SIZE];
+    memset(record, 'A' + worker->index, sizeof(record));
+
+    for(size_t opIdx = 0; opIdx < CONCURRENT_WRITER_OPS; ++opIdx)
+    {
+        Timer opTimer;
+        worker->opStartTime = HighResClock::now();
+        worker->waitingForBlockDevice = true;
+        opTimer.start();
+        ssize_t const written = file.write(record, sizeof(record));
+        int const syncRet = file.sync();
+        opTimer.stop();
+        worker->waitingForBlockDevice = false;
+
+        if(written != static_cast<ssize_t>(sizeof(record)) || syncRet != 0)
+        {
+            worker->error = written < 0 ? static_cast<int>(written) : (syncRet != 0 ? syncRet : -1);
+            break;
+        }
+        worker->latencies[worker->numOps++] = std::chrono::duration_cast<std::chrono::microseconds>(opTimer.elapsed_time()).count();
+        worker->bytesMoved += sizeof(record);
+    }
+
+    file.close();
+    concurrentState.fs->remove(path);
+}
+
+/*
+ * Reader thread.  Repeatedly opens and reads the whole config file, until the writers are done.
+ */
+void concurrent_reader(ConcurrentWorker * worker)
+{
+    char buffer[CONCURRENT_CONFIG_FILE_SIZE];
+    while(!concurrentState.writersDone && worker->numOps < CONCURRENT_MAX_READER_OPS)
+    {
+        Timer opTimer;
+        opTimer.start();
+        File file;
+        int ret = file.open(concurrentState.fs, "concurrent_config.txt", O_RDONLY);
+        ssize_t const bytesRead = ret == 0 ? file.read(buffer, sizeof(buffer)) : ret;
+        file.close();
+        opTimer.stop();
+
+        if(bytesRead != static_cast<ssize_t>(sizeof(buffer)))
+        {
+            worker->error = bytesRead < 0 ? static_cast<int>(bytesRead) : -1;
+            break;
+        }
+        worker->latencies[worker->numOps++] = std::chrono::duration_cast<std::chrono::microseconds>(opTimer.elapsed_time()).count();
+        worker->bytesMoved += sizeof(buffer);
+    }
+}
+
+/*
+ * Report percentiles of a list of times in us, as metrics named "<name> p<percentile>" and "<name> max"
+ */
+void report_time_percentiles(char const * name, std::vector<uint32_t> times)
+{
+    if(times.empty())
+    {
+        return;
+    }
+    std::sort(times.begin(), times.end());
+
+    char metricName[64];
+    for(int percentile : {50, 90, 99})
+    {
+        snprintf(metricName, sizeof(metricName), "%s p%d", name, percentile);
+        report_metric(metricName, times[(times.size() - 1) * percentile / 100], "us");
+    }
+    snprintf(metricName, sizeof(metricName), "%s max", name);
+    report_metric(metricName, times.back(), "us");
+}
+
+/*
+ * Report percentiles of the latencies of a set of workers' operations
+ */
+void report_latency_percentiles(char const * opName, std::vector<ConcurrentWorker> const & workers)
+{
+    std::vector<uint32_t> latencies;
+    for(ConcurrentWorker const & worker : workers)
+    {
+        latencies.insert(latencies.end(), worker.latencies, worker.latencies + worker.numOps);
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "%s latency", opName);
+    report_time_percentiles(name, std::move(latencies));
+}
+
+/*
+ * Runs numWriters threads which each append records to their own file, and numReaders threads which
+ * repeatedly read a shared config file, all on one FATFileSystem over SDBlockDevice.
+ * Measures the aggregate throughput, the latency percentiles of each kind of operation, how long each write
+ * waits before it gets to the block device, and how busy the block device is.  Comparing the time threads
+ * spend in filesystem operations with the time the block device is busy shows where work gets serialized.
+ */
+template<uint64_t spiFreq, bool useAsync, DMAUsage dmaHint, size_t numWriters, size_t numReaders>
+void benchmark_concurrent_file_access()
+{
+    SDBlockDevice * sdDev = constructSDBlockDev(spiFreq);
+
+#if DEVICE_SPI_ASYNCH
+    sdDev->set_async_spi_mode(useAsync, dmaHint);
+#endif
+
+    int ret = sdDev->init();
+    TEST_ASSERT_MESSAGE(ret == BD_ERROR_OK, "Failed to connect to SD card");
+
+    TimedBlockDevice timedDev(sdDev, concurrent_block_device_call_entered);
+    FATFileSystem fs("sd");
+    ret = fs.mount(&timedDev);
+    TEST_ASSERT_MESSAGE(ret==0,"SD file system mount failed.");
+
+    // Create the file the readers read
+    {
+        File configFile;
+        TEST_ASSERT_EQUAL(0, configFile.open(&fs, "concurrent_config.txt", O_WRONLY | O_CREAT | O_TRUNC));
+        char configData[CONCURRENT_CONFIG_FILE_SIZE];
+        memset(configData, 'C', sizeof(configData));
+        TEST_ASSERT_EQUAL(sizeof(configData), configFile.write(configData, sizeof(configData)));
+        configFile.close();
+    }
+
+    // Allocated on the heap, as the latency arrays are too big for the main thread's stack
+    std::vector<ConcurrentWorker> writers(numWriters);
+    std::vector<ConcurrentWorker> readers(numReaders);
+    std::vector<std::unique_ptr<Thread>> writerThreads(numWriters);
+    std::vector<std::unique_ptr<Thread>> readerThreads(numReaders);
+    for(size_t writerIdx = 0; writerIdx < numWriters; ++writerIdx)
+    {
+        writers[writerIdx].index = writerIdx;
+    }
+
+    concurrentState.fs = &fs;
+    concurrentState.writers = &writers;
+    concurrentState.writersDone = false;
+
+    TimedBlockDevice::Stats const statsBefore = timedDev.get_stats();
+    Timer wallTimer;
+    wallTimer.start();
+
+    for(size_t readerIdx = 0; readerIdx < numReaders; ++readerIdx)
+    {
+        readerThreads[readerIdx] = std::make_unique<Thread>(osPriorityNormal, CONCURRENT_THREAD_STACK_SIZE);
+        readerThreads[readerIdx]->start(callback(concurrent_reader, &readers[readerIdx]));
+    }
+    for(size_t writerIdx = 0; writerIdx < numWriters; ++writerIdx)
+    {
+        writerThreads[writerIdx] = std::make_unique<Thread>(osPriorityNormal, CONCURRENT_THREAD_STACK_SIZE);
+        writerThreads[writerIdx]->start(callback(concurrent_writer, &writers[writerIdx]));
+    }
+
+    for(size_t writerIdx = 0; writerIdx < numWriters; ++writerIdx)
+    {
+        writerThreads[writerIdx]->join();
+    }
+    concurrentState.writersDone = true;
+    for(size_t readerIdx = 0; readerIdx < numReaders; ++readerIdx)
+    {
+        readerThreads[readerIdx]->join();
+    }
+
+    wallTimer.stop();
+    TimedBlockDevice::Stats const statsAfter = timedDev.get_stats();
+    concurrentState.writers = nullptr;
+
+    // Check that every thread worked
+    size_t bytesWritten = 0;
+    size_t bytesRead = 0;
+    std::chrono::microseconds totalOpTime{};
+    std::vector<uint32_t> blockDeviceWaits;
+    for(size_t writerIdx = 0; writerIdx < numWriters; ++writerIdx)
+    {
+        TEST_ASSERT_EQUAL_MESSAGE(0, writers[writerIdx].error, "Writer thread failed");
+        bytesWritten += writers[writerIdx].bytesMoved;
+        blockDeviceWaits.insert(blockDeviceWaits.end(), writers[writerIdx].blockDeviceWaits,
+                                writers[writerIdx].blockDeviceWaits + writers[writerIdx].numBlockDeviceWaits);
+        for(size_t opIdx = 0; opIdx < writers[writerIdx].numOps; ++opIdx)
+        {
+            totalOpTime += std::chrono::microseconds(writers[writerIdx].latencies[opIdx]);
+        }
+    }
+    for(size_t readerIdx = 0; readerIdx < numReaders; ++readerIdx)
+    {
+        TEST_ASSERT_EQUAL_MESSAGE(0, readers[readerIdx].error, "Reader thread failed");
+        bytesRead += readers[readerIdx].bytesMoved;
+        for(size_t opIdx = 0; opIdx < readers[readerIdx].numOps; ++opIdx)
+        {
+            totalOpTime += std::chrono::microseconds(readers[readerIdx].latencies[opIdx]);
+        }
+    }
+
+    fs.remove("concurrent_config.txt");
+    ret = fs.unmount();
+    TEST_ASSERT_MESSAGE(ret==0,"SD file system unmount failed.");
+    destroySDBlockDev(sdDev);
+
+    auto const wallTime = std::chrono::duration_cast<std::chrono::microseconds>(wallTimer.elapsed_time());
+    uint32_t const bdCalls = statsAfter.calls - statsBefore.calls;
+    auto const bdTime = statsAfter.totalTime - statsBefore.totalTime;
+
+    printf("%zu writers wrote %zu bytes and %zu readers read %zu bytes in %" PRIi64 "us, making %" PRIu32 " block device calls.\n",
+           numWriters, bytesWritten, numReaders, bytesRead, wallTime.count(), bdCalls);
+
+    report_metric("Aggregate write throughput", bytesWritten / (wallTime.count() / 1e6), "B/s");
+    if(numReaders > 0)
+    {
+        report_metric("Aggregate read throughput", bytesRead / (wallTime.count() / 1e6), "B/s");
+    }
+    report_latency_percentiles("Write", writers);
+    report_latency_percentiles("Read", readers);
+
+    // Mean number of threads inside a filesystem operation (running or waiting).  If this is well above the
+    // block device utilization as a fraction, threads are queueing on the filesystem lock rather than doing I/O.
+    report_metric("Mean threads in filesystem operations", static_cast<double>(totalOpTime.count()) / wallTime.count(), "");
+    report_metric("Block device utilization", static_cast<double>(bdTime.count()) * 100 / wallTime.count(), "%");
+    report_metric("Block device mean call time", bdCalls == 0 ? 0 : static_cast<double>(bdTime.count()) / bdCalls, "us");
+    report_metric("Block device max call time", statsAfter.maxTime.count(), "us");
+
+    // Time each write took to get through the filesystem to the block device.  With one writer this is the
+    // filesystem's own overhead; the increase with more threads is time spent queued on the filesystem lock.
+    report_time_percentiles("Write wait for block device", std::move(blockDeviceWaits));
+}
+
+/*
+ * Check that the card works after initialization by reading the first block, which is
+ * the MBR or boot sector of the filesystem created by the earlier test cases.
+ */
+void assert_raw_card_readable()
+{
+    uint8_t block[RawSDCard::BLOCK_SIZE];
+    TEST_ASSERT_MESSAGE(rawSDCard->read_block(0, block), "Failed to read block 0");
+    TEST_ASSERT_EQUAL_HEX8(0x55, block[510]);
+    TEST_ASSERT_EQUAL_HEX8(0xAA, block[511]);
+}
+
+// Times each step of a full initialization after a power cycle, done the same way as SDBlockDevice
+template<uint32_t initFreq, uint32_t dataFreq>
+void time_full_init()
+{
+    if(rawSDCard == nullptr)
+    {
+        rawSDCard = new (rawSDCardMemory) RawSDCard(PIN_SPI_MOSI, PIN_SPI_MISO, PIN_SPI_SCLK, PIN_SPI_SD_CS, MBED_CONF_SD_CRC_ENABLED);
+    }
+
+    power_cycle_sd_card();
+
+    host_start_sd_command_logging();
+
+    RawSDCard::InitPhaseTimes times;
+    TEST_ASSERT_MESSAGE(rawSDCard->full_init(initFreq, dataFreq, times), "Failed to initialize SD card");
+    report_init_phase_times(times);
+
+    assert_raw_card_readable();
+
+    host_verify_sd_commands("full_init");
+}
+
+// Times the fast re-init of the card from the previous test case, optionally power cycling it first
+template<uint32_t dataFreq, bool powerCycle>
+void time_fast_reinit()
+{
+    TEST_ASSERT_MESSAGE(rawSDCard != nullptr, "Full init test case must run first");
+
+    if(powerCycle)
+    {
+        power_cycle_sd_card();
+    }
+
+    host_start_sd_command_logging();
+
+    RawSDCard::InitPhaseTimes times;
+    TEST_ASSERT_MESSAGE(rawSDCard->fast_reinit(dataFreq, times), "Failed to re-initialize SD card");
+    report_init_phase_times(times);
+
+    assert_raw_card_readable();
+
+    host_verify_sd_commands(powerCycle ? "fast_reinit_power_cycle" : "fast_reinit_powered");
+}
+
+// Measures how long it takes from power up to the first write being finished, in the usual way:
+// SDBlockDevice::init(), then mounting the filesystem, then writing a file.
+template<uint64_t spiFreq>
+void time_mount_and_first_write()
+{
+    // Done with the raw card now.  Destroy it so its pins are free for SDBlockDevice.
+    if(rawSDCard != nullptr)
+    {
+        rawSDCard->~RawSDCard();
+        rawSDCard = nullptr;
+    }
+
+    power_cycle_sd_card();
+
+    SDBlockDevice * sdDev = constructSDBlockDev(spiFreq);
+    FATFileSystem fs("sd");
+
+    Timer totalTimer;
+    Timer phaseTimer;
+    totalTimer.start();
+    phaseTimer.start();
+
+    int ret = sdDev->init();
+    TEST_ASSERT_MESSAGE(ret == BD_ERROR_OK, "Failed to connect to SD card");
+    auto const initTime = phaseTimer.elapsed_time();
+
+    phaseTimer.reset();
+    ret = fs.mount(sdDev);
+    TEST_ASSERT_MESSAGE(ret==0,"SD file system mount failed.");
+    auto const mountTime = phaseTimer.elapsed_time();
+
+    phaseTimer.reset();
+    FILE * file = fopen("/sd/first_write.txt", "w");
+    TEST_ASSERT_MESSAGE(file != nullptr,"Failed to create file");
+    TEST_ASSERT_MESSAGE(fputs("first write", file) >= 0,"Writing file to sd card failed");
+    fclose(file);
+    auto const firstWriteTime = phaseTimer.elapsed_time();
+    auto const totalTime = totalTimer.elapsed_time();
+
+    printf("SDBlockDevice::init() took %" PRIi64 "us, mount took %" PRIi64 "us, and the first write took %" PRIi64 "us.\n",
+           initTime.count(), mountTime.count(), firstWriteTime.count());
+    report_metric("SDBlockDevice init time", initTime.count(), "us");
+    report_metric("Mount time", mountTime.count(), "us");
+    report_metric("First write time", firstWriteTime.count(), "us");
+    report_metric("Time to first write", totalTime.count(), "us");
+
+    remove("/sd/first_write.txt");
+
+    ret = fs.unmount();
+    TEST_ASSERT_MESSAGE(ret==0,"SD file system unmount failed.");
+
+    destroySDBlockDev(sdDev);
+}
+
+// Initializes the card for a data frequency of 25MHz (the max in default speed mode) or above, then times writing and
+// reading back a working set of blocks.  Above 25MHz, the card must be switched to high speed mode with CMD6 first.
+// The logic analyzer samples at 8MHz, so it can only check the commands sent during identification (at 400kHz).
+// Data integrity at the fast clock is checked with the data CRCs instead: the card checks the CRC of each block
+// written, RawSDCard checks the CRC of each block read, and then the data read is compared to the data written.
+template<uint32_t dataFreq>
+void benchmark_high_speed()
+{
+    if(dataFreq > RawSDCard::MAX_DEFAULT_SPEED_FREQUENCY)
+    {
+        spi_capabilities_t capabilities;
+        spi_get_capabilities(NC, false, &capabilities);
+        TEST_SKIP_UNLESS_MESSAGE(capabilities.maximum_frequency > RawSDCard::MAX_DEFAULT_SPEED_FREQUENCY,
+                                 "This target's SPI cannot go faster than 25MHz");
+    }
+
+    // Blocks used for the benchmark.  The filesystem is reformatted by the first test cases of each run,
+    // so overwriting whatever is here does no harm.
+    constexpr uint32_t blockAddress = 1024;
+    constexpr size_t blockCount = BENCH_WORKING_SET_SIZE / RawSDCard::BLOCK_SIZE;
+
+    if(rawSDCard == nullptr)
+    {
+        rawSDCard = new (rawSDCardMemory) RawSDCard(PIN_SPI_MOSI, PIN_SPI_MISO, PIN_SPI_SCLK, PIN_SPI_SD_CS, MBED_CONF_SD_CRC_ENABLED);
+    }
+
+    power_cycle_sd_card();
+
+    host_start_sd_command_logging();
+
+    RawSDCard::InitPhaseTimes times;
+    TEST_ASSERT_MESSAGE(rawSDCard->full_init(RawSDCard::MAX_IDENTIFICATION_FREQUENCY, dataFreq, times), "Failed to initialize SD card");
+    report_init_phase_times(times);
+    if(dataFreq > RawSDCard::MAX_DEFAULT_SPEED_FREQUENCY)
+    {
+        TEST_ASSERT_MESSAGE(rawSDCard->is_high_speed(), "SD card did not switch to high speed mode");
+    }
+    report_metric("SPI data clock frequency", rawSDCard->data_frequency(), "Hz");
+
+    host_verify_sd_init_commands(dataFreq > RawSDCard::MAX_DEFAULT_SPEED_FREQUENCY ? "init_high_speed" : "init_default_speed");
+
+    std::vector<uint8_t> writeData(BENCH_WORKING_SET_SIZE);
+    std::vector<uint8_t> readData(BENCH_WORKING_SET_SIZE);
+    for(size_t byteIdx = 0; byteIdx < writeData.size(); ++byteIdx)
+    {
+        writeData[byteIdx] = static_cast<uint8_t>(rand());
+    }
+
+    Timer writeTimer;
+    writeTimer.start();
+    TEST_ASSERT_MESSAGE(rawSDCard->write_blocks(blockAddress, writeData.data(), blockCount), "Failed to write blocks");
+    writeTimer.stop();
+
+    Timer readTimer;
+    readTimer.start();
+    TEST_ASSERT_MESSAGE(rawSDCard->read_blocks(blockAddress, readData.data(), blockCount), "Failed to read blocks");
+    readTimer.stop();
+
+    TEST_ASSERT_MESSAGE(writeData == readData, "Data read does not match data written");
+
+    auto const writeTime = std::chrono::duration_cast<std::chrono::microseconds>(writeTimer.elapsed_time());
+    auto const readTime = std::chrono::duration_cast<std::chrono::microseconds>(readTimer.elapsed_time());
+    printf("Wrote %zu bytes in %" PRIi64 "us and read them back in %" PRIi64 "us at %" PRIu32 "Hz.\n",
+           static_cast<size_t>(BENCH_WORKING_SET_SIZE), writeTime.count(), readTime.count(), rawSDCard->data_frequency());
+    report_metric("Multi block write throughput", BENCH_WORKING_SET_SIZE / (writeTime.count() / 1e6), "B/s");
+    report_metric("Multi block read throughput", BENCH_WORKING_SET_SIZE / (readTime.count() / 1e6), "B/s");
+}
+
+// Times sustained writing over a region of the card which has already been filled (see benchmark_overwrite_region())
+template<uint32_t dataFreq, OverwriteMode mode>
+void benchmark_sustained_overwrite()
+{
+    if(rawSDCard == nullptr)
+    {
+        rawSDCard = new (rawSDCardMemory) RawSDCard(PIN_SPI_MOSI, PIN_SPI_MISO, PIN_SPI_SCLK, PIN_SPI_SD_CS, MBED_CONF_SD_CRC_ENABLED);
+        power_cycle_sd_card();
+        RawSDCard::InitPhaseTimes times;
+        TEST_ASSERT_MESSAGE(rawSDCard->full_init(RawSDCard::MAX_IDENTIFICATION_FREQUENCY, dataFreq, times), "Failed to initialize SD card");
+    }
+    else
+    {
+        RawSDCard::InitPhaseTimes times;
+        TEST_ASSERT_MESSAGE(rawSDCard->fast_reinit(dataFreq, times), "Failed to re-initialize SD card");
+    }
+
+    // Fill the region first
+    std::vector<uint8_t> writeData(BENCH_WORKING_SET_SIZE);
+    for(size_t byteIdx = 0; byteIdx < writeData.size(); ++byteIdx)
+    {
+        writeData[byteIdx] = static_cast<uint8_t>(rand());
+    }
+    fill_overwrite_region(*rawSDCard, writeData.data());
+
+    // Write different data than the fill, so that a write which didn't happen is caught
+    std::reverse(writeData.begin(), writeData.end());
+    benchmark_overwrite_region(*rawSDCard, mode, writeData);
+}
+
 utest::v1::status_t test_setup(const size_t number_of_cases)
 {
     // Setup Greentea using a reasonable timeout in seconds
-    GREENTEA_SETUP(30, "default_auto");
+    GREENTEA_SETUP(120, "sd_card_test");
 
     // Enable power and SPI to the SD card
-    static DigitalOut sdcardEnablePin(PIN_SDCARD_ENABLE, 0);
+    static DigitalOut sdcardEnablePinObj(PIN_SDCARD_ENABLE, 0);
+    sdcardEnablePin = &sdcardEnablePinObj;
     rtos::ThisThread::sleep_for(100ms);
-    sdcardEnablePin = 1;
+    *sdcardEnablePin = 1;
     rtos::ThisThread::sleep_for(100ms);
 
     // Initialize logic analyzer for SPI pinouts
@@ -259,9 +920,31 @@ Case cases[] = {
     Case("[Async DMA] SPI - Mount FS, Create File (1MHz)", mount_fs_create_file<1000000, true, DMA_USAGE_ALWAYS>),
     Case("[Async DMA] SPI - Write, Read, and Delete File (1MHz)", test_sd_file<1000000, true, DMA_USAGE_ALWAYS>),
 #endif
+
+    Case("SD Concurrency - 1 Writer (1MHz)", benchmark_concurrent_file_access<1000000, false, DMA_USAGE_NEVER, 1, 0>),
+    Case("SD Concurrency - 2 Writers, 1 Reader (1MHz)", benchmark_concurrent_file_access<1000000, false, DMA_USAGE_NEVER, 2, 1>),
+    Case("SD Concurrency - 3 Writers, 2 Readers (1MHz)", benchmark_concurrent_file_access<1000000, false, DMA_USAGE_NEVER, 3, 2>),
+#if DEVICE_SPI_ASYNCH
+    Case("[Async DMA] SD Concurrency - 1 Writer (1MHz)", benchmark_concurrent_file_access<1000000, true, DMA_USAGE_ALWAYS, 1, 0>),
+    Case("[Async DMA] SD Concurrency - 2 Writers, 1 Reader (1MHz)", benchmark_concurrent_file_access<1000000, true, DMA_USAGE_ALWAYS, 2, 1>),
+    Case("[Async DMA] SD Concurrency - 3 Writers, 2 Readers (1MHz)", benchmark_concurrent_file_access<1000000, true, DMA_USAGE_ALWAYS, 3, 2>),
+#endif
+
+    // Note: These must run after a filesystem has been created by the cases above, and in this order
+    Case("SD Init Timing - Full Init (100kHz, then 1MHz)", time_full_init<100000, 1000000>),
+    Case("SD Init Timing - Fast Re-init after Power Cycle (1MHz)", time_fast_reinit<1000000, true>),
+    Case("SD Init Timing - Fast Re-init of Powered Card (1MHz)", time_fast_reinit<1000000, false>),
+    Case("SD Mount Latency - Init, Mount, and First Write (1MHz)", time_mount_and_first_write<1000000>),
+
+    // Note: These overwrite blocks of the filesystem, so they must run last
+    Case("SD High Speed - Multi Block Write and Read (25MHz)", benchmark_high_speed<25000000>),
+    Case("SD High Speed - Multi Block Write and Read (50MHz)", benchmark_high_speed<50000000>),
+    Case("SD Sustained Write - Overwrite Filled Region (25MHz)", benchmark_sustained_overwrite<25000000, OverwriteMode::Overwrite>),
+    Case("SD Sustained Write - Overwrite with ACMD23 Pre-Erase (25MHz)", benchmark_sustained_overwrite<25000000, OverwriteMode::PreErase>),
+    Case("SD Sustained Write - Overwrite after Erase (25MHz)", benchmark_sustained_overwrite<25000000, OverwriteMode::EraseFirst>),
 };
 
-Specification specification(test_setup, cases, greentea_continue_handlers);
+Specification specification(test_setup, cases, pipelined_host_handlers);
 
 // // Entry point into the tests
 int main() {
@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2024 Jamie Smith
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CI_TEST_BENCH_SIZES_H
+#define CI_TEST_BENCH_SIZES_H
+
+// This header defines the following macros, sized for the target being built:
+
+// CI_TEST_RAM_SIZE        - Size of the target's main RAM bank, in bytes.  Not defined if unknown.
+// BENCH_WORKING_SET_SIZE  - Number of bytes that a benchmark may use for its data buffers.  Always a power of 2.
+
+// The sizes for the target come from ci_test_target_bench_sizes.h, which the CMake build generates from the
+// target's RAM banks in the CMSIS MCU data when it is configured (see bench_size_generator.py in the
+// Test-Result-Evaluator).  Builds which don't generate it, like the native tests, use the defaults.
+#if __has_include("ci_test_target_bench_sizes.h")
+#include "ci_test_target_bench_sizes.h"
+#endif
+
+// Defaults for targets without memory data.  Must match DEFAULT_WORKING_SET_SIZE in bench_size_generator.py.
+#ifndef BENCH_WORKING_SET_SIZE
+#define BENCH_WORKING_SET_SIZE 4096
+#endif
+
+#endif
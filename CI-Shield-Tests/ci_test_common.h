@@ -16,9 +16,16 @@
 #ifndef CI_TEST_CONFIG_H
 #define CI_TEST_CONFIG_H
 
+#include "utest/utest.h"
 #include "utest_print.h"
 #include "greentea-client/test_env.h"
 #include "ci_test_pins.h"
+#include "ci_test_bench_sizes.h"
+#include "ci_test_trace.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
 
 // Set to 1 to enable debug messages from the test shield tests
 #define TESTSHIELD_DEBUG_MESSAGES 0
@@ -58,4 +65,256 @@ inline void assert_next_message_from_host(char const * key, char const * expecte
     }
 }
 
-#endif
\ No newline at end of file
+/*
+ * Report a benchmark result.  This prints a line like "Metric: Mean round trip time = 1234.000 us", which the
+ * Test-Result-Evaluator picks out of the test output and stores per test case, target, and interface chip.
+ * The name must not contain " = ".
+ */
+inline void report_metric(char const * name, double value, char const * unit)
+{
+    printf("Metric: %s = %.3f %s\n", name, value, unit);
+}
+
+/*
+ * ISR placement.  Functions marked CI_TEST_RAMFUNC are linked into RAM when CI_TEST_ISR_IN_RAM is 1, so that they
+ * don't pay for flash wait states when they run.  This is used on the callbacks which run in interrupt context in
+ * the latency and throughput tests, and those tests are also built as "-ram-isr" variants with it enabled, so that
+ * the two placements can be compared on each target.  It can also be set for all tests with the app.isr-in-ram
+ * option in mbed_app.json5.
+ * By default, functions go in a .data subsection, which the startup code copies to RAM on every GCC_ARM target.
+ * Targets whose linker script has a tightly coupled instruction memory section can override CI_TEST_RAMFUNC_SECTION.
+ */
+#ifndef CI_TEST_ISR_IN_RAM
+#define CI_TEST_ISR_IN_RAM 0
+#endif
+
+#ifndef CI_TEST_RAMFUNC_SECTION
+#define CI_TEST_RAMFUNC_SECTION ".data.ci_test_ramfunc"
+#endif
+
+#if CI_TEST_ISR_IN_RAM
+// long_call is needed because RAM is usually out of range of a BL instruction in flash
+#define CI_TEST_RAMFUNC __attribute__((section(CI_TEST_RAMFUNC_SECTION), long_call, noinline))
+
+// Mbed's MPU manager makes RAM execute-never by default, so running anything from RAM would fault.
+// Hold a lock on RAM execution from static init until the test exits.
+inline mbed::ScopedRamExecutionLock ciTestRamExecutionLock;
+#else
+#define CI_TEST_RAMFUNC
+#endif
+
+/*
+ * Marker output for measuring the latency from a point in the code to activity on the bus.
+ * Each call to mark() toggles PIN_TEST_MARKER, which the logic analyzer records alongside the bus signals, so the
+ * host can measure the time from the marker to a bus edge with the precision of its sample clock.
+ * Markers are edges rather than pulses so that they can't be too short for the logic analyzer to see.
+ * mark() is safe to call from an ISR.
+ */
+class TestMarker {
+public:
+    TestMarker():
+    pin(PIN_TEST_MARKER, 0)
+    {}
+
+    void mark()
+    {
+        level = !level;
+        pin.write(level);
+    }
+
+private:
+    mbed::DigitalOut pin;
+    int level = 0;
+};
+
+/*
+ * Pipelined host requests.
+ *
+ * Rather than doing a blocking round trip for every request to the host test, requests are tagged with a
+ * sequence number and the device only waits as long as it actually has to:
+ * - host_request_capture() returns as soon as the host reports that the capture is armed
+ *   (the host replies {{armed;<seq>}}).
+ * - host_request_verdict() does not wait at all.  The host replies {{verdict;<seq> pass}} or
+ *   {{verdict;<seq> fail}} once it has checked the capture, and this verdict is collected whenever the device
+ *   next waits on the host, or at the latest by pipelined_case_teardown_handler() when the Case finishes.
+ * Requests are sent with the value "<seq> <payload>".
+ *
+ * To use this, the test's Specification must use pipelined_host_handlers (or call the pipelined teardown handlers
+ * from its own teardown functions) so that a failed verdict fails the Case that requested it.
+ */
+
+// Maximum number of verdicts which can be outstanding at once.  If this many are outstanding, the next
+// request waits for the oldest one.
+constexpr size_t MAX_PENDING_HOST_VERDICTS = 8;
+
+struct HostPipelineState {
+    uint32_t nextSequenceNumber = 0;
+
+    // Sequence numbers of requests which have not received a verdict yet
+    uint32_t pendingVerdicts[MAX_PENDING_HOST_VERDICTS];
+    size_t numPendingVerdicts = 0;
+
+    // Number of failed verdicts received since the start of the current Case
+    size_t failedVerdicts = 0;
+
+    // Number of Cases which only failed because of a failed verdict.  The test teardown needs this
+    // to report the correct totals, since the utest harness does not know about these failures.
+    size_t casesFailedByHost = 0;
+};
+
+inline HostPipelineState & host_pipeline_state()
+{
+    static HostPipelineState state;
+    return state;
+}
+
+/*
+ * Send a request to the host, tagged with a new sequence number.  Returns the sequence number.
+ */
+inline uint32_t host_send_request(char const * key, char const * payload)
+{
+    HostPipelineState & state = host_pipeline_state();
+    uint32_t const sequenceNumber = state.nextSequenceNumber++;
+
+    char value[64];
+    snprintf(value, sizeof(value), "%" PRIu32 " %s", sequenceNumber, payload);
+    greentea_send_kv(key, value);
+
+    return sequenceNumber;
+}
+
+/*
+ * Wait for the next pipelined message from the host.  If it is a verdict, it is recorded.
+ * Returns true if the message was an armed message for the given sequence number.
+ */
+inline bool host_receive_pipelined_message(uint32_t armedSequenceNumber)
+{
+    HostPipelineState & state = host_pipeline_state();
+
+    char receivedKey[64], receivedValue[64];
+    greentea_parse_kv(receivedKey, receivedValue, sizeof(receivedKey), sizeof(receivedValue));
+
+    uint32_t sequenceNumber;
+    char verdict[16];
+    if(strcmp(receivedKey, "armed") == 0 && sscanf(receivedValue, "%" SCNu32, &sequenceNumber) == 1)
+    {
+        return sequenceNumber == armedSequenceNumber;
+    }
+    else if(strcmp(receivedKey, "verdict") == 0 && sscanf(receivedValue, "%" SCNu32 " %15s", &sequenceNumber, verdict) == 2)
+    {
+        for(size_t pendingIdx = 0; pendingIdx < state.numPendingVerdicts; ++pendingIdx)
+        {
+            if(state.pendingVerdicts[pendingIdx] == sequenceNumber)
+            {
+                // Remove it from the list, keeping the list in order
+                memmove(&state.pendingVerdicts[pendingIdx], &state.pendingVerdicts[pendingIdx + 1],
+                        (state.numPendingVerdicts - pendingIdx - 1) * sizeof(uint32_t));
+                --state.numPendingVerdicts;
+
+                if(strcmp(verdict, "pass") != 0)
+                {
+                    utest_printf("Host verification of request %" PRIu32 " failed!\n", sequenceNumber);
+                    ++state.failedVerdicts;
+                }
+                break;
+            }
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Ask the host to start a capture, and return once the host reports that the capture is armed.
+ */
+inline void host_request_capture(char const * key, char const * payload)
+{
+    uint32_t const sequenceNumber = host_send_request(key, payload);
+    while(!host_receive_pipelined_message(sequenceNumber)) {}
+}
+
+/*
+ * Ask the host to verify something.  Does not wait for the verdict.
+ */
+inline void host_request_verdict(char const * key, char const * payload)
+{
+    HostPipelineState & state = host_pipeline_state();
+
+    // Make room if needed.  No armed message will have this sequence number, so this only handles verdicts.
+    while(state.numPendingVerdicts == MAX_PENDING_HOST_VERDICTS)
+    {
+        host_receive_pipelined_message(state.nextSequenceNumber);
+    }
+
+    state.pendingVerdicts[state.numPendingVerdicts++] = host_send_request(key, payload);
+}
+
+/*
+ * Wait for all outstanding verdicts.  Returns the number of failed verdicts since the last call, and resets
+ * that count.
+ */
+inline size_t host_collect_verdicts()
+{
+    HostPipelineState & state = host_pipeline_state();
+
+    while(state.numPendingVerdicts > 0)
+    {
+        host_receive_pipelined_message(state.nextSequenceNumber);
+    }
+
+    size_t const failedVerdicts = state.failedVerdicts;
+    state.failedVerdicts = 0;
+    return failedVerdicts;
+}
+
+/*
+ * Case teardown handler which collects the verdicts requested by the Case, and fails the Case if any failed.
+ * Also dumps the events traced during the Case, if tracing is enabled.
+ */
+inline utest::v1::status_t pipelined_case_teardown_handler(const utest::v1::Case *const source, const size_t passed, const size_t failed,
+                                                           const utest::v1::failure_t failure)
+{
+    trace_dump();
+
+    size_t const failedVerdicts = host_collect_verdicts();
+    if(failedVerdicts == 0)
+    {
+        return utest::v1::greentea_case_teardown_handler(source, passed, failed, failure);
+    }
+
+    if(failed == 0)
+    {
+        ++host_pipeline_state().casesFailedByHost;
+        return utest::v1::greentea_case_teardown_handler(source, passed, failedVerdicts,
+                                                         utest::v1::failure_t(utest::v1::REASON_CASES, utest::v1::LOCATION_CASE_TEARDOWN));
+    }
+    return utest::v1::greentea_case_teardown_handler(source, passed, failed + failedVerdicts, failure);
+}
+
+/*
+ * Test teardown handler which includes Cases that failed due to a failed verdict in the totals.
+ */
+inline void pipelined_test_teardown_handler(const size_t passed, const size_t failed, const utest::v1::failure_t failure)
+{
+    size_t const casesFailedByHost = host_pipeline_state().casesFailedByHost;
+    if(casesFailedByHost == 0)
+    {
+        utest::v1::greentea_test_teardown_handler(passed, failed, failure);
+        return;
+    }
+
+    utest::v1::greentea_test_teardown_handler(passed - casesFailedByHost, failed + casesFailedByHost,
+                                              failed == 0 ? utest::v1::failure_t(utest::v1::REASON_CASES, utest::v1::LOCATION_UNKNOWN) : failure);
+}
+
+// Same as greentea_continue_handlers, but with the pipelined teardown handlers
+static const utest::v1::handlers_t pipelined_host_handlers = {
+    utest::v1::greentea_test_setup_handler,
+    pipelined_test_teardown_handler,
+    utest::v1::greentea_test_failure_handler,
+    utest::v1::greentea_case_setup_handler,
+    pipelined_case_teardown_handler,
+    utest::v1::greentea_case_failure_continue_handler
+};
+
+#endif
@@ -44,6 +44,8 @@
 // PIN_UART_MCU_TX   - Pin connected to UART_MCU_TX on the test shield.  Must be mappable as UART Tx. Default D0.
 // PIN_UART_MCU_RX   - Pin connected to UART_MCU_RX on the test shield.  Must be mappable as UART Rx. Default D1.
 // PIN_ANALOG_OUT    - Pin connected to the DAC on the MCU.  Should be looped back to PIN_GPOUT_1_PWM.  Don't define if not available.
+// PIN_TEST_MARKER   - Output toggled by TestMarker for code-to-bus latency measurements.  Must be connected to logic analyzer
+//                     channel D6.  Default PIN_GPOUT_1_PWM.
 
 // Overrides for RP2040
 #if TARGET_RASPBERRY_PI_PICO
@@ -185,4 +187,9 @@
 
 #endif
 
+// GPOUT_1 is always recorded by the logic analyzer, whatever FUNC_SEL is set to, so it's used for markers
+#if !defined(PIN_TEST_MARKER) && defined(PIN_GPOUT_1_PWM)
+#define PIN_TEST_MARKER PIN_GPOUT_1_PWM
+#endif
+
 #endif /* CI_TEST_PINS_H */
@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2024 Jamie Smith
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef CI_TEST_PROFILER_H
+#define CI_TEST_PROFILER_H
+
+/*
+ * Statistical PC-sampling profiler for the benchmark cases.
+ *
+ * Between profiler_start() and profiler_stop(), a Ticker interrupt fires every PROFILER_SAMPLE_PERIOD and records
+ * the PC that it interrupted, whether that was in a thread or in a lower priority ISR.  profiler_stop() prints the
+ * number of samples at each PC as lines like "Profile: 0x08001234 57".  When the test run is imported with the test ELFs,
+ * the Test-Result-Evaluator adds up the samples for each function using the ELF's symbol table, and shows the top
+ * functions of each benchmark on the results site.
+ *
+ * To get the interrupted PC, the profiler hooks the vector of the IRQ that the Ticker runs from with a small
+ * handler that reads the PC from the exception stack frame and then jumps to the original handler.
+ *
+ * The profiler is enabled with the app.profiler-enabled option in mbed_app.json5.  Sampling slows down the
+ * code being profiled, so benchmark results from profiling builds should not be compared with normal results.
+ * When it's disabled, profiler_start() and profiler_stop() do nothing.
+ *
+ * Note: This header defines non-inline functions, so it must only be included from one source file per test.
+ */
+
+#ifndef CI_TEST_PROFILER_ENABLED
+#define CI_TEST_PROFILER_ENABLED 0
+#endif
+
+#if CI_TEST_PROFILER_ENABLED
+
+#include "mbed.h"
+
+#include <cinttypes>
+#include <cstdio>
+
+#if !defined(__CORTEX_M)
+#error The profiler only supports Cortex-M targets
+#endif
+
+// Rate that the PC is sampled at
+constexpr std::chrono::microseconds PROFILER_SAMPLE_PERIOD = 100us; // 10kHz
+
+// Number of distinct PCs which can be recorded.  Must be a power of 2.  Samples at new PCs once the table is full
+// are counted as dropped.
+constexpr size_t PROFILER_TABLE_SIZE = 512;
+static_assert((PROFILER_TABLE_SIZE & (PROFILER_TABLE_SIZE - 1)) == 0, "PROFILER_TABLE_SIZE must be a power of 2");
+
+// Number of slots to look at when searching the table for a PC
+constexpr size_t PROFILER_MAX_PROBES = 8;
+
+struct ProfilerSlot {
+    uint32_t pc;
+    uint32_t count;
+};
+
+struct ProfilerState {
+    ProfilerSlot table[PROFILER_TABLE_SIZE];
+    uint32_t droppedSamples;
+    volatile bool running;
+    IRQn_Type sampleIrq;
+    bool vectorHooked;
+};
+
+ProfilerState profilerState;
+
+// Original handler of the sampled IRQ.  Read by profiler_irq_entry().
+extern "C" uint32_t profilerOriginalHandler;
+uint32_t profilerOriginalHandler = 0;
+
+Ticker profilerTicker;
+
+/*
+ * Record one sample.  Called from profiler_irq_entry() with the interrupted PC.
+ */
+extern "C" MBED_USED void profiler_record_sample(uint32_t pc)
+{
+    if(!profilerState.running)
+    {
+        return;
+    }
+
+    // Multiplicative hash of the PC (ignoring the always-zero bit 0)
+    size_t slotIdx = ((pc >> 1) * 2654435761u) & (PROFILER_TABLE_SIZE - 1);
+    for(size_t probe = 0; probe < PROFILER_MAX_PROBES; ++probe)
+    {
+        ProfilerSlot & slot = profilerState.table[slotIdx];
+        if(slot.pc == pc)
+        {
+            ++slot.count;
+            return;
+        }
+        if(slot.count == 0)
+        {
+            slot.pc = pc;
+            slot.count = 1;
+            return;
+        }
+        slotIdx = (slotIdx + 1) & (PROFILER_TABLE_SIZE - 1);
+    }
+    ++profilerState.droppedSamples;
+}
+
+/*
+ * Entry point of the sampled IRQ while profiling.  Gets the PC from the exception stack frame (on the process
+ * stack if a thread was interrupted, or the main stack if an ISR was), records it, and then jumps to the
+ * original handler with LR still set to the EXC_RETURN value.
+ * Only uses instructions which exist on ARMv6-M so that it works on every Cortex-M core.
+ */
+extern "C" MBED_NAKED void profiler_irq_entry()
+{
+    __asm volatile(
+        "    mov r0, lr                      \n"
+        "    movs r1, #4                     \n"
+        "    tst r0, r1                      \n" // EXC_RETURN bit 2 set -> frame is on the PSP
+        "    beq 1f                          \n"
+        "    mrs r0, psp                     \n"
+        "    b 2f                            \n"
+        "1:  mrs r0, msp                     \n"
+        "2:  ldr r0, [r0, #24]               \n" // Stacked PC
+        "    push {r0, lr}                   \n" // Save EXC_RETURN (r0 keeps the stack 8 byte aligned)
+        "    bl profiler_record_sample       \n"
+        "    pop {r0, r1}                    \n"
+        "    mov lr, r1                      \n"
+        "    ldr r0, =profilerOriginalHandler\n"
+        "    ldr r0, [r0]                    \n"
+        "    bx r0                           \n"
+        "    .align 2                        \n"
+        "    .ltorg                          \n" // Keep the literal for the ldr above in range
+    );
+}
+
+/*
+ * Ticker callback.  The first time it runs, it hooks the vector of the IRQ it is running from.
+ */
+inline void profiler_ticker_callback()
+{
+    if(!profilerState.vectorHooked)
+    {
+        profilerState.sampleIrq = static_cast<IRQn_Type>(static_cast<int32_t>(__get_IPSR()) - 16);
+        profilerOriginalHandler = NVIC_GetVector(profilerState.sampleIrq);
+        NVIC_SetVector(profilerState.sampleIrq, reinterpret_cast<uint32_t>(&profiler_irq_entry));
+        profilerState.vectorHooked = true;
+    }
+}
+
+/*
+ * Start sampling.  Clears any samples from the last run.
+ */
+inline void profiler_start()
+{
+    memset(profilerState.table, 0, sizeof(profilerState.table));
+    profilerState.droppedSamples = 0;
+    profilerState.running = true;
+    profilerTicker.attach(profiler_ticker_callback, PROFILER_SAMPLE_PERIOD);
+}
+
+/*
+ * Stop sampling, and print out the samples.
+ */
+inline void profiler_stop()
+{
+    profilerState.running = false;
+    profilerTicker.detach();
+
+    if(profilerState.vectorHooked)
+    {
+        NVIC_SetVector(profilerState.sampleIrq, profilerOriginalHandler);
+        profilerState.vectorHooked = false;
+    }
+
+    for(ProfilerSlot const & slot : profilerState.table)
+    {
+        if(slot.count > 0)
+        {
+            printf("Profile: 0x%08" PRIx32 " %" PRIu32 "\n", slot.pc, slot.count);
+        }
+    }
+    if(profilerState.droppedSamples > 0)
+    {
+        printf("Profile: dropped %" PRIu32 " samples\n", profilerState.droppedSamples);
+    }
+}
+
+#else
+
+inline void profiler_start()
+{}
+
+inline void profiler_stop()
+{}
+
+#endif
+
+#endif
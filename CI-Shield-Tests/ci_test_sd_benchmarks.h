@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2024 Jamie Smith
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef CI_TEST_SD_BENCHMARKS_H
+#define CI_TEST_SD_BENCHMARKS_H
+
+#include "ci_test_sd_card.h"
+#include "ci_test_bench_sizes.h"
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <vector>
+
+// RawSDCard benchmark code shared between the SD card test (SPIMicroSDTest.cpp) and the native SD card emulator
+// test, so that the two measure exactly the same thing.
+// The includer must provide the test assertion macros (from unity.h or native_test.h) and report_metric().
+
+/*
+ * Report the time taken by each phase of a RawSDCard initialization
+ */
+inline void report_init_phase_times(RawSDCard::InitPhaseTimes const & times)
+{
+    report_metric("CMD0 (go idle) time", times.goIdle.count(), "us");
+    report_metric("CMD8 (interface condition) time", times.interfaceCondition.count(), "us");
+    report_metric("CMD59 (CRC on) time", times.crcOn.count(), "us");
+    report_metric("CMD58 (read OCR) time", times.readOCR.count(), "us");
+    report_metric("ACMD41 loop time", times.opCondLoop.count(), "us");
+    report_metric("ACMD41 iterations", times.opCondIterations, "");
+    report_metric("CMD58 (read CCS) time", times.readCCS.count(), "us");
+    report_metric("CMD9 (read CSD) time", times.readCSD.count(), "us");
+    report_metric("CMD16 (set block length) time", times.setBlockLength.count(), "us");
+    report_metric("CMD6 (high speed switch) time", times.highSpeedSwitch.count(), "us");
+    report_metric("Clock switch time", times.clockSwitch.count(), "us");
+    report_metric("CMD13 (check status) time", times.checkStatus.count(), "us");
+    report_metric("Total init time", times.total.count(), "us");
+}
+
+/*
+ * Ways of writing over blocks which already have data in them
+ */
+enum class OverwriteMode {
+    Overwrite,  // Just write with CMD25, which is what SDBlockDevice::program() does
+    PreErase,   // Send ACMD23 with the block count before each CMD25
+    EraseFirst, // Erase the blocks with CMD38 before writing them, which is what SDBlockDevice::trim() does
+};
+
+// Region of the card used by the sustained overwrite benchmark.  Overwriting it does no harm to the card's contents.
+constexpr uint32_t OVERWRITE_REGION_ADDRESS = 2048;
+constexpr size_t OVERWRITE_REGION_CHUNKS = 16;
+constexpr size_t OVERWRITE_CHUNK_BLOCKS = BENCH_WORKING_SET_SIZE / RawSDCard::BLOCK_SIZE;
+
+/*
+ * Fill the sustained overwrite benchmark's region, a working set at a time, with the given working set of data
+ */
+inline void fill_overwrite_region(RawSDCard & card, uint8_t const * data)
+{
+    for(size_t chunkIdx = 0; chunkIdx < OVERWRITE_REGION_CHUNKS; ++chunkIdx)
+    {
+        TEST_ASSERT_MESSAGE(card.write_blocks(OVERWRITE_REGION_ADDRESS + chunkIdx * OVERWRITE_CHUNK_BLOCKS, data, OVERWRITE_CHUNK_BLOCKS),
+                            "Failed to fill region");
+    }
+}
+
+/*
+ * Time sustained writing of the region filled by fill_overwrite_region(), so that the card has to deal with the
+ * old data, like it does once a filesystem has been filled and files deleted without trimming.
+ * The region is written a working set at a time, like a filesystem writing a large file.
+ * data should differ from the fill, so that a write which didn't happen is caught.
+ */
+inline void benchmark_overwrite_region(RawSDCard & card, OverwriteMode mode, std::vector<uint8_t> const & data)
+{
+    Timer writeTimer;
+    writeTimer.start();
+    std::chrono::microseconds eraseTime{};
+    if(mode == OverwriteMode::EraseFirst)
+    {
+        TEST_ASSERT_MESSAGE(card.erase_blocks(OVERWRITE_REGION_ADDRESS, OVERWRITE_REGION_CHUNKS * OVERWRITE_CHUNK_BLOCKS), "Failed to erase region");
+        eraseTime = std::chrono::duration_cast<std::chrono::microseconds>(writeTimer.elapsed_time());
+    }
+    for(size_t chunkIdx = 0; chunkIdx < OVERWRITE_REGION_CHUNKS; ++chunkIdx)
+    {
+        TEST_ASSERT_MESSAGE(card.write_blocks(OVERWRITE_REGION_ADDRESS + chunkIdx * OVERWRITE_CHUNK_BLOCKS, data.data(), OVERWRITE_CHUNK_BLOCKS,
+                                              mode == OverwriteMode::PreErase),
+                            "Failed to write blocks");
+    }
+    writeTimer.stop();
+
+    // Check the last chunk, since every chunk has the same data
+    std::vector<uint8_t> readData(BENCH_WORKING_SET_SIZE);
+    TEST_ASSERT_MESSAGE(card.read_blocks(OVERWRITE_REGION_ADDRESS + (OVERWRITE_REGION_CHUNKS - 1) * OVERWRITE_CHUNK_BLOCKS, readData.data(), OVERWRITE_CHUNK_BLOCKS),
+                        "Failed to read blocks");
+    TEST_ASSERT_MESSAGE(data == readData, "Data read does not match data written");
+
+    auto const writeTime = std::chrono::duration_cast<std::chrono::microseconds>(writeTimer.elapsed_time());
+    printf("Wrote %zu bytes over old data in %" PRIi64 "us.\n", OVERWRITE_REGION_CHUNKS * BENCH_WORKING_SET_SIZE, static_cast<int64_t>(writeTime.count()));
+    if(mode == OverwriteMode::EraseFirst)
+    {
+        report_metric("Erase time", eraseTime.count(), "us");
+    }
+    report_metric("Sustained write throughput", OVERWRITE_REGION_CHUNKS * BENCH_WORKING_SET_SIZE / (writeTime.count() / 1e6), "B/s");
+}
+
+#endif
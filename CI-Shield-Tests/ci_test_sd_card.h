@@ -0,0 +1,664 @@
+/*
+ * Copyright (c) 2024 Jamie Smith
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef CI_TEST_SD_CARD_H
+#define CI_TEST_SD_CARD_H
+
+#include "mbed.h"
+#include "ci_test_trace.h"
+
+#include <chrono>
+
+/*
+ * Minimal driver for talking to an SD card in SPI mode using raw commands.
+ *
+ * SDBlockDevice::init() runs the whole initialization sequence in one go, so it can't tell us how long each
+ * step takes, and it always does every step.  This class runs the same sequence as SDBlockDevice one step
+ * at a time so the steps can be timed, and also provides a fast re-init path for a card which is already known.
+ *
+ * Only SD v2 cards (SDSC v2, SDHC, and SDXC) are supported, which is everything that has been sold for many years.
+ */
+class RawSDCard
+{
+public:
+    // Commands used by this class
+    enum Command : uint8_t {
+        CMD0_GO_IDLE_STATE = 0,
+        CMD6_SWITCH_FUNC = 6,
+        CMD8_SEND_IF_COND = 8,
+        CMD9_SEND_CSD = 9,
+        CMD12_STOP_TRANSMISSION = 12,
+        CMD13_SEND_STATUS = 13,
+        CMD16_SET_BLOCKLEN = 16,
+        CMD17_READ_SINGLE_BLOCK = 17,
+        CMD18_READ_MULTIPLE_BLOCK = 18,
+        CMD24_WRITE_BLOCK = 24,
+        CMD25_WRITE_MULTIPLE_BLOCK = 25,
+        CMD32_ERASE_WR_BLK_START = 32,
+        CMD33_ERASE_WR_BLK_END = 33,
+        CMD38_ERASE = 38,
+        CMD55_APP_CMD = 55,
+        CMD58_READ_OCR = 58,
+        CMD59_CRC_ON_OFF = 59,
+        ACMD23_SET_WR_BLK_ERASE_COUNT = 23,
+        ACMD41_SD_SEND_OP_COND = 41,
+    };
+
+    // R1 response bits
+    static constexpr uint8_t R1_READY = 0x00;
+    static constexpr uint8_t R1_IDLE_STATE = 0x01;
+    static constexpr uint8_t R1_NO_RESPONSE = 0xFF;
+
+    // Data token which precedes a block of data read from the card, or written with CMD24
+    static constexpr uint8_t DATA_START_TOKEN = 0xFE;
+
+    // Data tokens for CMD25
+    static constexpr uint8_t MULTI_WRITE_START_TOKEN = 0xFC;
+    static constexpr uint8_t MULTI_WRITE_STOP_TOKEN = 0xFD;
+
+    // Data response token sent by the card when it accepts a block
+    static constexpr uint8_t DATA_RESPONSE_ACCEPTED = 0x05;
+
+    static constexpr size_t BLOCK_SIZE = 512;
+
+    // Max time an erase may take.  The spec allows 250ms per allocation unit, so this covers erases of a few AUs.
+    static constexpr std::chrono::milliseconds ERASE_TIMEOUT{1000};
+
+    // Max frequency allowed by the SD spec during card identification
+    static constexpr uint32_t MAX_IDENTIFICATION_FREQUENCY = 400000;
+
+    // Max frequency in default speed mode, and in high speed mode (which must be switched to with CMD6)
+    static constexpr uint32_t MAX_DEFAULT_SPEED_FREQUENCY = 25000000;
+    static constexpr uint32_t MAX_HIGH_SPEED_FREQUENCY = 50000000;
+
+    // CMD6 arguments to check for, and to switch to, the high speed function (function 1 of group 1).
+    // The other groups are set to 0xF, meaning no change.
+    static constexpr uint32_t CMD6_CHECK_HIGH_SPEED = 0x00FFFFF1;
+    static constexpr uint32_t CMD6_SWITCH_HIGH_SPEED = 0x80FFFFF1;
+
+    // Length of the switch function status sent after CMD6
+    static constexpr size_t SWITCH_STATUS_LENGTH = 64;
+
+    // Time spent on each step of initialization.  Steps which were skipped have a time of zero.
+    struct InitPhaseTimes {
+        std::chrono::microseconds goIdle{};           // CMD0 (including the initial dummy clocks)
+        std::chrono::microseconds interfaceCondition{}; // CMD8
+        std::chrono::microseconds crcOn{};            // CMD59
+        std::chrono::microseconds readOCR{};          // CMD58, before ACMD41
+        std::chrono::microseconds opCondLoop{};       // ACMD41 loop, until the card leaves the idle state
+        std::chrono::microseconds readCCS{};          // CMD58, after ACMD41
+        std::chrono::microseconds readCSD{};          // CMD9
+        std::chrono::microseconds setBlockLength{};   // CMD16
+        std::chrono::microseconds highSpeedSwitch{};  // CMD6 check and switch, only if the data frequency needs high speed mode
+        std::chrono::microseconds clockSwitch{};      // Changing the SPI frequency to the data frequency
+        std::chrono::microseconds checkStatus{};      // CMD13, used by the fast re-init to detect a card that is still initialized
+        std::chrono::microseconds total{};
+        size_t opCondIterations = 0;                  // Number of times ACMD41 was sent
+    };
+
+    /*
+     * Create a RawSDCard.  The CS pin is driven manually as a GPIO.
+     */
+    RawSDCard(PinName mosi, PinName miso, PinName sclk, PinName cs, bool crcOn):
+    _spi(mosi, miso, sclk),
+    _cs(cs, 1),
+    _crcOn(crcOn)
+    {
+        _spi.format(8, 0);
+        _spi.set_default_write_value(0xFF);
+    }
+
+    /*
+     * Run the full initialization sequence, the same way as SDBlockDevice::init() does:
+     * CMD0, CMD8, CMD59 (if CRC is on), CMD58, ACMD41 until ready, CMD58, CMD9, CMD16.
+     * The identification steps run at initFrequency, then the clock is switched to dataFrequency.
+     * If dataFrequency is above 25MHz, the card is first switched to high speed mode with CMD6.  If the card does
+     * not support high speed mode, the data frequency is limited to 25MHz instead.
+     * Returns true on success.
+     */
+    bool full_init(uint32_t initFrequency, uint32_t dataFrequency, InitPhaseTimes & times)
+    {
+        times = InitPhaseTimes();
+        Timer totalTimer;
+        totalTimer.start();
+
+        if(!identify(initFrequency, true, times)) {
+            return false;
+        }
+
+        // Read CCS to find out if the card uses block or byte addressing
+        Timer phaseTimer;
+        phaseTimer.start();
+        uint8_t ocr[4];
+        if(command(CMD58_READ_OCR, 0, ocr, sizeof(ocr)) != R1_READY) {
+            return false;
+        }
+        _highCapacity = (ocr[0] & 0x40) != 0;
+        times.readCCS = elapsed_us(phaseTimer);
+
+        phaseTimer.reset();
+        if(!read_register(CMD9_SEND_CSD, _csd, sizeof(_csd))) {
+            return false;
+        }
+        times.readCSD = elapsed_us(phaseTimer);
+
+        phaseTimer.reset();
+        if(command(CMD16_SET_BLOCKLEN, BLOCK_SIZE) != R1_READY) {
+            return false;
+        }
+        times.setBlockLength = elapsed_us(phaseTimer);
+
+        phaseTimer.reset();
+        _highSpeed = dataFrequency > MAX_DEFAULT_SPEED_FREQUENCY && switch_high_speed();
+        if(dataFrequency > MAX_DEFAULT_SPEED_FREQUENCY) {
+            times.highSpeedSwitch = elapsed_us(phaseTimer);
+        }
+
+        phaseTimer.reset();
+        set_data_frequency(dataFrequency);
+        times.clockSwitch = elapsed_us(phaseTimer);
+
+        times.total = elapsed_us(totalTimer);
+        _known = true;
+        return true;
+    }
+
+    /*
+     * Re-initialize a card which has already been initialized with full_init(), and has not been swapped since
+     * (e.g. because the firmware power-cycled it, or deinitialized it to share the bus).
+     *
+     * If the card is still powered and initialized, CMD13 returns a ready status and nothing else needs to be done.
+     * Otherwise, the card is taken through identification again, but at the maximum identification frequency
+     * rather than initFrequency, and without re-reading the OCR, CCS, and CSD (which cannot have changed) or
+     * setting the block length (which SD v2 cards reset to 512 anyway).  High speed mode is lost with power, so
+     * it is switched to again if dataFrequency needs it.
+     */
+    bool fast_reinit(uint32_t dataFrequency, InitPhaseTimes & times)
+    {
+        times = InitPhaseTimes();
+        if(!_known) {
+            return false;
+        }
+
+        Timer totalTimer;
+        totalTimer.start();
+
+        // A card that is still initialized will happily answer CMD13 at full speed.  A card that was power cycled
+        // is in SD mode and will not answer at all, so this costs little either way.
+        Timer phaseTimer;
+        phaseTimer.start();
+        set_data_frequency(dataFrequency);
+        uint8_t status;
+        uint8_t const r1 = command(CMD13_SEND_STATUS, 0, &status, 1);
+        times.checkStatus = elapsed_us(phaseTimer);
+
+        if(r1 == R1_READY && status == 0) {
+            times.total = elapsed_us(totalTimer);
+            return true;
+        }
+
+        if(!identify(MAX_IDENTIFICATION_FREQUENCY, false, times)) {
+            return false;
+        }
+
+        phaseTimer.reset();
+        _highSpeed = dataFrequency > MAX_DEFAULT_SPEED_FREQUENCY && switch_high_speed();
+        if(dataFrequency > MAX_DEFAULT_SPEED_FREQUENCY) {
+            times.highSpeedSwitch = elapsed_us(phaseTimer);
+        }
+
+        phaseTimer.reset();
+        set_data_frequency(dataFrequency);
+        times.clockSwitch = elapsed_us(phaseTimer);
+
+        times.total = elapsed_us(totalTimer);
+        return true;
+    }
+
+    /*
+     * Read one block from the card.  Returns true on success.
+     */
+    bool read_block(uint32_t blockAddress, uint8_t * buffer)
+    {
+        select();
+        bool success = send_command_frame(CMD17_READ_SINGLE_BLOCK, card_address(blockAddress)) == R1_READY
+            && read_data(buffer, BLOCK_SIZE);
+        deselect();
+        return success;
+    }
+
+    /*
+     * Read consecutive blocks from the card with CMD18.  Returns true on success.
+     */
+    bool read_blocks(uint32_t blockAddress, uint8_t * buffer, size_t blockCount)
+    {
+        select();
+        bool success = send_command_frame(CMD18_READ_MULTIPLE_BLOCK, card_address(blockAddress)) == R1_READY;
+        if(success) {
+            for(size_t blockIdx = 0; success && blockIdx < blockCount; ++blockIdx) {
+                success = read_data(buffer + blockIdx * BLOCK_SIZE, BLOCK_SIZE);
+            }
+
+            // The byte after CMD12 is a stuff byte, so skip it before looking for the response
+            success = send_command_frame(CMD12_STOP_TRANSMISSION, 0, true) == R1_READY && success;
+            success = wait_ready() && success;
+        }
+        deselect();
+        return success;
+    }
+
+    /*
+     * Write one block to the card with CMD24, and wait for it to finish programming.  Returns true on success.
+     */
+    bool write_block(uint32_t blockAddress, uint8_t const * buffer)
+    {
+        select();
+        bool success = send_command_frame(CMD24_WRITE_BLOCK, card_address(blockAddress)) == R1_READY
+            && write_data(DATA_START_TOKEN, buffer) && wait_ready();
+        deselect();
+        return success;
+    }
+
+    /*
+     * Write consecutive blocks to the card with CMD25, and wait for them to finish programming.
+     * If preErase is true, the card is first told how many blocks will be written with ACMD23, so that it can erase
+     * them all at once instead of as it goes.  Returns true on success.
+     */
+    bool write_blocks(uint32_t blockAddress, uint8_t const * buffer, size_t blockCount, bool preErase = false)
+    {
+        if(preErase && app_command(ACMD23_SET_WR_BLK_ERASE_COUNT, blockCount) != R1_READY) {
+            return false;
+        }
+
+        select();
+        bool success = send_command_frame(CMD25_WRITE_MULTIPLE_BLOCK, card_address(blockAddress)) == R1_READY;
+        if(success) {
+            for(size_t blockIdx = 0; success && blockIdx < blockCount; ++blockIdx) {
+                success = write_data(MULTI_WRITE_START_TOKEN, buffer + blockIdx * BLOCK_SIZE) && wait_ready();
+            }
+
+            // The stop token must be sent even if a block failed.  It's followed by one byte, then busy.
+            _spi.write(MULTI_WRITE_STOP_TOKEN);
+            _spi.write(0xFF);
+            success = wait_ready() && success;
+        }
+        deselect();
+        return success;
+    }
+
+    /*
+     * Erase consecutive blocks with CMD32, CMD33, and CMD38, and wait for the erase to finish.  This is how
+     * SDBlockDevice implements trim(), and tells the card that the blocks are free, so that it doesn't have to
+     * preserve their contents when writing nearby.  Returns true on success.
+     */
+    bool erase_blocks(uint32_t blockAddress, size_t blockCount)
+    {
+        if(command(CMD32_ERASE_WR_BLK_START, card_address(blockAddress)) != R1_READY ||
+           command(CMD33_ERASE_WR_BLK_END, card_address(blockAddress + blockCount - 1)) != R1_READY) {
+            return false;
+        }
+
+        select();
+        bool const success = send_command_frame(CMD38_ERASE, 0) == R1_READY && wait_ready(ERASE_TIMEOUT);
+        deselect();
+        return success;
+    }
+
+    bool is_high_capacity() const
+    {
+        return _highCapacity;
+    }
+
+    /*
+     * Whether the card was switched to high speed mode by the last init
+     */
+    bool is_high_speed() const
+    {
+        return _highSpeed;
+    }
+
+    /*
+     * SPI frequency used for data transfers after the last init.  May be lower than requested if the
+     * card does not support high speed mode.
+     */
+    uint32_t data_frequency() const
+    {
+        return _dataFrequency;
+    }
+
+    /*
+     * Switch the card to high speed mode with CMD6, which allows clocking it at up to 50MHz.  First checks that
+     * the card supports the switch function command class (class 10, from the CSD) and the high speed function.
+     * Must be called at 25MHz or less, after the CSD has been read.  Returns true if the card is now in high
+     * speed mode.
+     */
+    bool switch_high_speed()
+    {
+        if(!(_csd[4] & 0x40)) {
+            return false;
+        }
+
+        // Byte 13 of the status has the functions supported in group 1, and the low nibble of byte 16
+        // has the function that was (or would be) selected, or 0xF on error
+        uint8_t status[SWITCH_STATUS_LENGTH];
+        if(!switch_function(CMD6_CHECK_HIGH_SPEED, status) || !(status[13] & 0x02) || (status[16] & 0x0F) != 1) {
+            return false;
+        }
+        if(!switch_function(CMD6_SWITCH_HIGH_SPEED, status) || (status[16] & 0x0F) != 1) {
+            return false;
+        }
+
+        // The card switches within 8 clocks of the end of the status
+        _spi.write(0xFF);
+        return true;
+    }
+
+    /*
+     * Send a command and get its R1 response.  If extraResponseLen is nonzero, the bytes of the response after the
+     * R1 (e.g. the OCR for R3) are read into extraResponse.
+     */
+    uint8_t command(uint8_t cmd, uint32_t arg, uint8_t * extraResponse = nullptr, size_t extraResponseLen = 0)
+    {
+        select();
+        uint8_t const r1 = send_command_frame(cmd, arg);
+        if(!(r1 & 0x80)) {
+            for(size_t byteIdx = 0; byteIdx < extraResponseLen; ++byteIdx) {
+                extraResponse[byteIdx] = _spi.write(0xFF);
+            }
+        }
+        deselect();
+        return r1;
+    }
+
+    /*
+     * Send an application-specific command (CMD55 followed by the command)
+     */
+    uint8_t app_command(uint8_t acmd, uint32_t arg)
+    {
+        uint8_t const r1 = command(CMD55_APP_CMD, 0);
+        if(r1 & ~R1_IDLE_STATE) {
+            return r1;
+        }
+        return command(acmd, arg);
+    }
+
+    /*
+     * Calculate the CRC16 of an SD data block
+     */
+    static uint16_t crc16(uint8_t const * data, size_t length)
+    {
+        uint16_t crc = 0;
+        for(size_t byteIdx = 0; byteIdx < length; ++byteIdx) {
+            crc ^= static_cast<uint16_t>(data[byteIdx]) << 8;
+            for(int bitIdx = 0; bitIdx < 8; ++bitIdx) {
+                crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+            }
+        }
+        return crc;
+    }
+
+    /*
+     * Calculate the CRC7 of an SD command frame
+     */
+    static uint8_t crc7(uint8_t const * data, size_t length)
+    {
+        uint8_t crc = 0;
+        for(size_t byteIdx = 0; byteIdx < length; ++byteIdx) {
+            uint8_t byte = data[byteIdx];
+            for(int bitIdx = 0; bitIdx < 8; ++bitIdx) {
+                crc <<= 1;
+                if((byte ^ crc) & 0x80) {
+                    crc ^= 0x09;
+                }
+                byte <<= 1;
+            }
+        }
+        return crc & 0x7F;
+    }
+
+private:
+
+    static std::chrono::microseconds elapsed_us(Timer & timer)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(timer.elapsed_time());
+    }
+
+    uint32_t card_address(uint32_t blockAddress) const
+    {
+        // Standard capacity cards are addressed in bytes, and high capacity cards in blocks
+        return _highCapacity ? blockAddress : blockAddress * BLOCK_SIZE;
+    }
+
+    void select()
+    {
+        _cs = 0;
+    }
+
+    void deselect()
+    {
+        _cs = 1;
+
+        // The card needs 8 clocks after CS goes high to release MISO
+        _spi.write(0xFF);
+    }
+
+    /*
+     * Common identification steps: dummy clocks, CMD0, CMD8, CMD59, [CMD58], and the ACMD41 loop
+     */
+    bool identify(uint32_t frequency, bool readOCR, InitPhaseTimes & times)
+    {
+        Timer phaseTimer;
+        phaseTimer.start();
+
+        _spi.frequency(frequency);
+
+        // The card needs at least 74 clocks with CS high after power up before it can accept commands
+        for(size_t byteIdx = 0; byteIdx < 10; ++byteIdx) {
+            _spi.write(0xFF);
+        }
+
+        // CMD0 with CS low puts the card into SPI mode.  The card may need a few tries if it was in the middle
+        // of something.
+        uint8_t r1 = R1_NO_RESPONSE;
+        for(size_t attempt = 0; attempt < 5 && r1 != R1_IDLE_STATE; ++attempt) {
+            r1 = command(CMD0_GO_IDLE_STATE, 0);
+        }
+        if(r1 != R1_IDLE_STATE) {
+            return false;
+        }
+        times.goIdle = elapsed_us(phaseTimer);
+
+        // CMD8 must be sent for the card to accept ACMD41 with HCS set, so it cannot be skipped
+        phaseTimer.reset();
+        uint8_t ifCond[4];
+        if(command(CMD8_SEND_IF_COND, 0x1AA, ifCond, sizeof(ifCond)) != R1_IDLE_STATE || ifCond[3] != 0xAA) {
+            return false;
+        }
+        times.interfaceCondition = elapsed_us(phaseTimer);
+
+        // CRC checking is off after every power up
+        if(_crcOn) {
+            phaseTimer.reset();
+            if(command(CMD59_CRC_ON_OFF, 1) != R1_IDLE_STATE) {
+                return false;
+            }
+            times.crcOn = elapsed_us(phaseTimer);
+        }
+
+        if(readOCR) {
+            phaseTimer.reset();
+            uint8_t ocr[4];
+            if(command(CMD58_READ_OCR, 0, ocr, sizeof(ocr)) != R1_IDLE_STATE) {
+                return false;
+            }
+            times.readOCR = elapsed_us(phaseTimer);
+        }
+
+        // Send ACMD41 with HCS set until the card finishes initializing.  The spec allows up to 1 second.
+        phaseTimer.reset();
+        do {
+            r1 = app_command(ACMD41_SD_SEND_OP_COND, 0x40000000);
+            ++times.opCondIterations;
+        }
+        while(r1 == R1_IDLE_STATE && phaseTimer.elapsed_time() < 1s);
+        if(r1 != R1_READY) {
+            return false;
+        }
+        times.opCondLoop = elapsed_us(phaseTimer);
+
+        return true;
+    }
+
+    /*
+     * Send a command frame and wait for the R1 response.  CS must already be selected.
+     * If skipStuffByte is true, the byte after the command is ignored (needed for CMD12).
+     */
+    uint8_t send_command_frame(uint8_t cmd, uint32_t arg, bool skipStuffByte = false)
+    {
+        CI_TEST_TRACE(SDCommand, cmd);
+
+        // Wait for the card to not be busy
+        for(size_t byteIdx = 0; byteIdx < 100 && _spi.write(0xFF) != 0xFF; ++byteIdx) {}
+
+        uint8_t frame[6] = {
+            static_cast<uint8_t>(0x40 | cmd),
+            static_cast<uint8_t>(arg >> 24),
+            static_cast<uint8_t>(arg >> 16),
+            static_cast<uint8_t>(arg >> 8),
+            static_cast<uint8_t>(arg),
+            0
+        };
+        frame[5] = static_cast<uint8_t>((crc7(frame, 5) << 1) | 1);
+
+        for(uint8_t frameByte : frame) {
+            _spi.write(frameByte);
+        }
+
+        if(skipStuffByte) {
+            _spi.write(0xFF);
+        }
+
+        // The response comes within 8 bytes
+        uint8_t r1 = R1_NO_RESPONSE;
+        for(size_t byteIdx = 0; byteIdx < 8 && (r1 & 0x80); ++byteIdx) {
+            r1 = _spi.write(0xFF);
+        }
+        return r1;
+    }
+
+    /*
+     * Wait for a data token and read a block of data and its CRC.  CS must already be selected.
+     */
+    bool read_data(uint8_t * buffer, size_t length)
+    {
+        Timer tokenTimer;
+        tokenTimer.start();
+        uint8_t token;
+        do {
+            token = _spi.write(0xFF);
+        }
+        while(token == 0xFF && tokenTimer.elapsed_time() < 100ms);
+
+        if(token != DATA_START_TOKEN) {
+            return false;
+        }
+
+        _spi.write(nullptr, 0, reinterpret_cast<char *>(buffer), length);
+
+        // Check the CRC16 if CRC checking is on, so that data corrupted on the bus (e.g. from clocking the card
+        // too fast for the wiring) is caught
+        uint16_t const receivedCrc = (static_cast<uint16_t>(_spi.write(0xFF)) << 8) | static_cast<uint8_t>(_spi.write(0xFF));
+        return !_crcOn || receivedCrc == crc16(buffer, length);
+    }
+
+    /*
+     * Send a block of data with the given start token, and check the data response.  CS must already be selected.
+     */
+    bool write_data(uint8_t token, uint8_t const * buffer)
+    {
+        uint16_t const crc = crc16(buffer, BLOCK_SIZE);
+
+        // One byte gap, then the token, data, and CRC (which the card only checks if CRC checking is on)
+        _spi.write(0xFF);
+        _spi.write(token);
+        _spi.write(reinterpret_cast<const char *>(buffer), BLOCK_SIZE, nullptr, 0);
+        _spi.write(crc >> 8);
+        _spi.write(crc & 0xFF);
+
+        return (_spi.write(0xFF) & 0x1F) == DATA_RESPONSE_ACCEPTED;
+    }
+
+    /*
+     * Wait for the card to stop holding MISO low, which it does while it's busy programming.
+     * CS must already be selected.
+     */
+    bool wait_ready(std::chrono::milliseconds timeout = 500ms)
+    {
+        CI_TEST_TRACE(SDBusy, 0);
+        Timer busyTimer;
+        busyTimer.start();
+        while(_spi.write(0xFF) != 0xFF) {
+            if(busyTimer.elapsed_time() > timeout) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /*
+     * Send CMD6 with the given argument and read the switch function status
+     */
+    bool switch_function(uint32_t arg, uint8_t * status)
+    {
+        select();
+        bool success = send_command_frame(CMD6_SWITCH_FUNC, arg) == R1_READY && read_data(status, SWITCH_STATUS_LENGTH);
+        deselect();
+        return success;
+    }
+
+    /*
+     * Switch the SPI clock to the data frequency, limited to what the card's current speed mode allows
+     */
+    void set_data_frequency(uint32_t dataFrequency)
+    {
+        uint32_t const maxFrequency = _highSpeed ? MAX_HIGH_SPEED_FREQUENCY : MAX_DEFAULT_SPEED_FREQUENCY;
+        _dataFrequency = dataFrequency < maxFrequency ? dataFrequency : maxFrequency;
+        _spi.frequency(_dataFrequency);
+    }
+
+    /*
+     * Read a 16 byte register (CSD or CID) which is sent like a data block
+     */
+    bool read_register(uint8_t cmd, uint8_t * buffer, size_t length)
+    {
+        select();
+        bool success = send_command_frame(cmd, 0) == R1_READY && read_data(buffer, length);
+        deselect();
+        return success;
+    }
+
+    SPI _spi;
+    DigitalOut _cs;
+    bool _crcOn;
+
+    // Info saved about the card by full_init()
+    bool _known = false;
+    bool _highCapacity = false;
+    bool _highSpeed = false;
+    uint32_t _dataFrequency = 0;
+    uint8_t _csd[16] = {};
+};
+
+#endif
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2024 Jamie Smith
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef CI_TEST_TRACE_H
+#define CI_TEST_TRACE_H
+
+/*
+ * Event trace for instrumenting drivers and tests.
+ *
+ * CI_TEST_TRACE(event, arg) records a timestamped event in a ring buffer.  Recording is lock-free and safe to do
+ * from ISRs, and takes a few dozen cycles, so it disturbs the timing much less than a printf would.
+ * The pipelined case teardown handler in ci_test_common.h dumps the buffer after each Case as lines like
+ * "Trace: 123456 TransferStart 32", and the Test-Result-Evaluator's render_trace script turns these into a timeline.
+ *
+ * Tracing is enabled with the app.trace-enabled option in mbed_app.json5.  When it's disabled, CI_TEST_TRACE()
+ * compiles to nothing.  Tracepoints can also be added to driver and HAL code while debugging by including this header.
+ */
+
+#ifndef CI_TEST_TRACE_ENABLED
+#define CI_TEST_TRACE_ENABLED 0
+#endif
+
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+
+enum class TraceEvent : uint8_t {
+    Mark,             // Generic point of interest.  arg is up to the caller.
+    TransferStart,    // Started a transfer.  arg is the length in bytes.
+    TransferComplete, // A transfer finished.  arg is the length in bytes.
+    TransferAbort,    // Aborted a transfer
+    DmaComplete,      // A DMA transfer finished.  arg is the DMA channel.
+    IrqEntry,         // Entered an ISR.  arg is the IRQ number.
+    IrqExit,          // Left an ISR.  arg is the IRQ number.
+    Callback,         // A completion callback ran.  arg is the event flags.
+    MutexWait,        // Started waiting for a mutex
+    MutexAcquired,    // Got the mutex that was waited for
+    SDCommand,        // Sent an SD card command.  arg is the command index.
+    SDBusy,           // Started waiting for the SD card to finish programming
+};
+
+inline char const * trace_event_name(TraceEvent event)
+{
+    switch(event)
+    {
+        case TraceEvent::Mark: return "Mark";
+        case TraceEvent::TransferStart: return "TransferStart";
+        case TraceEvent::TransferComplete: return "TransferComplete";
+        case TraceEvent::TransferAbort: return "TransferAbort";
+        case TraceEvent::DmaComplete: return "DmaComplete";
+        case TraceEvent::IrqEntry: return "IrqEntry";
+        case TraceEvent::IrqExit: return "IrqExit";
+        case TraceEvent::Callback: return "Callback";
+        case TraceEvent::MutexWait: return "MutexWait";
+        case TraceEvent::MutexAcquired: return "MutexAcquired";
+        case TraceEvent::SDCommand: return "SDCommand";
+        case TraceEvent::SDBusy: return "SDBusy";
+        default: return "Unknown";
+    }
+}
+
+#if CI_TEST_TRACE_ENABLED
+
+#include "mbed.h"
+
+// Number of events kept.  Must be a power of 2.  Once the buffer is full, the oldest events are overwritten.
+constexpr size_t TRACE_BUFFER_SIZE = 256;
+static_assert((TRACE_BUFFER_SIZE & (TRACE_BUFFER_SIZE - 1)) == 0, "TRACE_BUFFER_SIZE must be a power of 2");
+
+struct TraceRecord {
+    uint32_t timestamp; // us, from the HighResClock
+    uint32_t arg;
+    TraceEvent event;
+};
+
+struct TraceBuffer {
+    TraceRecord records[TRACE_BUFFER_SIZE];
+
+    // Total number of events ever recorded.  Each writer claims a slot by incrementing this, so writers in
+    // different contexts never share a slot.
+    uint32_t writeCount = 0;
+
+    // Value of writeCount at the last dump
+    uint32_t dumpedCount = 0;
+};
+
+inline TraceBuffer & trace_buffer()
+{
+    static TraceBuffer buffer;
+    return buffer;
+}
+
+inline void trace_record(TraceEvent event, uint32_t arg)
+{
+    TraceBuffer & buffer = trace_buffer();
+    uint32_t const index = core_util_atomic_fetch_add_u32(&buffer.writeCount, 1);
+
+    // Note: The timestamp is taken after claiming the slot, so if an ISR records an event in between, the two
+    // events can be out of order by a microsecond or so.
+    TraceRecord & record = buffer.records[index & (TRACE_BUFFER_SIZE - 1)];
+    record.timestamp = static_cast<uint32_t>(HighResClock::now().time_since_epoch().count());
+    record.arg = arg;
+    record.event = event;
+}
+
+/*
+ * Print out the events recorded since the last dump.  Must not be called while events are being recorded.
+ */
+inline void trace_dump()
+{
+    TraceBuffer & buffer = trace_buffer();
+    uint32_t const writeCount = core_util_atomic_load_u32(&buffer.writeCount);
+
+    uint32_t firstIndex = buffer.dumpedCount;
+    if(writeCount - firstIndex > TRACE_BUFFER_SIZE)
+    {
+        printf("Trace: dropped %" PRIu32 " events\n", static_cast<uint32_t>(writeCount - firstIndex - TRACE_BUFFER_SIZE));
+        firstIndex = writeCount - TRACE_BUFFER_SIZE;
+    }
+
+    for(uint32_t index = firstIndex; index != writeCount; ++index)
+    {
+        TraceRecord const & record = buffer.records[index & (TRACE_BUFFER_SIZE - 1)];
+        printf("Trace: %" PRIu32 " %s %" PRIu32 "\n", record.timestamp, trace_event_name(record.event), record.arg);
+    }
+
+    buffer.dumpedCount = writeCount;
+}
+
+#define CI_TEST_TRACE(event, arg) trace_record(TraceEvent::event, (arg))
+
+#else
+
+inline void trace_dump()
+{}
+
+#define CI_TEST_TRACE(event, arg) do {} while(0)
+
+#endif
+
+#endif
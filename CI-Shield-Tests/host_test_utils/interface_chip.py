@@ -0,0 +1,29 @@
+## Module to identify the interface chip (debug probe) that the target's serial port goes through.
+## Round trip times to the target depend heavily on this chip, so host tests which measure them report it
+## in a line like "Interface chip: STM32 STLink (0483:374b)", which the Test-Result-Evaluator stores with the results.
+from typing import Optional
+
+from serial.tools import list_ports
+
+
+def get_interface_chip_name(serial_port: Optional[str]) -> str:
+    """
+    Get a human readable name for the USB device providing the given serial port.
+    Returns "Unknown" if it cannot be determined.
+    """
+    if serial_port is None:
+        return "Unknown"
+
+    for port_info in list_ports.comports():
+        if port_info.device != serial_port or port_info.vid is None:
+            continue
+
+        if port_info.product is not None:
+            name = port_info.product
+        elif port_info.manufacturer is not None:
+            name = port_info.manufacturer
+        else:
+            name = "USB Serial Port"
+        return f"{name} ({port_info.vid:04x}:{port_info.pid:04x})"
+
+    return "Unknown"
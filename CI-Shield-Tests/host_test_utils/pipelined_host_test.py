@@ -0,0 +1,68 @@
+## Host side of the pipelined request protocol used by the test shield tests.
+## See the "Pipelined host requests" section of ci_test_common.h for the device side.
+## Note: Host test modules should import this module rather than the class, otherwise the test runner will
+## find and register PipelinedHostTest itself as the host test.
+import traceback
+from typing import Callable
+
+from mbed_host_tests import BaseHostTest
+from mbed_host_tests.host_tests_logger import HtrunLogger
+
+
+class PipelinedHostTest(BaseHostTest):
+    """
+    Base class for host tests which use pipelined requests.
+
+    Requests from the device have the value "<seq> <payload>".  Capture requests are answered with
+    {{armed;<seq>}} as soon as the capture is running, and verification requests are answered with
+    {{verdict;<seq> pass}} or {{verdict;<seq> fail}}.
+    """
+
+    def __init__(self):
+        super(PipelinedHostTest, self).__init__()
+        self.logger = HtrunLogger('TEST')
+
+    @staticmethod
+    def _parse_request(value: str):
+        """
+        Split a request value into its sequence number and payload
+        """
+        sequence_number, _, payload = value.partition(" ")
+        return int(sequence_number), payload
+
+    def register_capture_callback(self, key: str, start_capture: Callable[[str], None]):
+        """
+        Register a callback which starts a capture.  start_capture() is called with the request payload, and must
+        return once the capture is armed.
+        """
+
+        def _callback(_key: str, value: str, _timestamp):
+            sequence_number, payload = self._parse_request(value)
+            start_capture(payload)
+            self.send_kv('armed', str(sequence_number))
+
+        self.register_callback(key, _callback)
+
+    def register_verdict_callback(self, key: str, verify: Callable[[str], bool]):
+        """
+        Register a callback which verifies something.  verify() is called with the request payload, and returns
+        whether the verification passed.  Exceptions count as a failed verification.
+        """
+
+        def _callback(_key: str, value: str, _timestamp):
+            sequence_number, payload = self._parse_request(value)
+            try:
+                passed = verify(payload)
+            except Exception:
+                self.logger.prn_err(f"Exception while handling {key} request {sequence_number}:\n" + traceback.format_exc())
+                passed = False
+            self.send_kv('verdict', f"{sequence_number} {'pass' if passed else 'fail'}")
+
+        self.register_callback(key, _callback)
+
+    def report_metric(self, name: str, value: float, unit: str):
+        """
+        Report a benchmark result measured on the host.  This prints the same line as report_metric() in
+        ci_test_common.h, so the Test-Result-Evaluator stores it with the test case that requested the verification.
+        """
+        self.logger.prn_inf(f"Metric: {name} = {value:.3f} {unit}")
@@ -0,0 +1,103 @@
+## Module to decode SD card commands out of the MOSI data of an SPI capture.
+from typing import List, Optional
+
+from mbed_host_tests.host_tests_logger import HtrunLogger
+
+# Length of an SD command frame: start bits + command index, 4 argument bytes, CRC7 + end bit
+SD_COMMAND_FRAME_LENGTH = 6
+
+# Command which says that the next command is an application-specific command (ACMD)
+SD_CMD55_APP_CMD = 55
+
+
+def sd_crc7(data: bytes) -> int:
+    """
+    Calculate the CRC7 of an SD command frame
+    """
+    crc = 0
+    for byte in data:
+        for bit_idx in range(8):
+            crc <<= 1
+            if ((byte << bit_idx) ^ crc) & 0x80:
+                crc ^= 0x09
+    return crc & 0x7F
+
+
+def is_valid_command_frame(frame: bytes) -> bool:
+    """
+    Check the length, start and end bits, and CRC of an SD command frame
+    """
+    return len(frame) == SD_COMMAND_FRAME_LENGTH and (frame[0] & 0xC0) == 0x40 and (frame[5] & 0x1) == 0x1 \
+        and (frame[5] >> 1) == sd_crc7(frame[0:5])
+
+
+class SDCommand:
+    """
+    One command sent to an SD card
+    """
+
+    def __init__(self, index: int, argument: int, is_app_command: bool):
+        self.index = index
+        self.argument = argument
+        self.is_app_command = is_app_command
+
+    @property
+    def name(self) -> str:
+        return f"{'ACMD' if self.is_app_command else 'CMD'}{self.index}"
+
+    def __str__(self):
+        return f"{self.name}(0x{self.argument:08x})"
+
+
+def decode_sd_commands(logger: HtrunLogger, mosi_bytes: bytes, stop_at_invalid: bool = False) -> Optional[List[SDCommand]]:
+    """
+    Decode the SD commands sent on MOSI.  In SPI mode, the host sends 0xFF whenever it is not sending a command
+    (or a data block, which this function does not handle), so any other byte is the start of a command frame.
+    CMD55 is not returned on its own, instead the command after it is marked as an app command.
+    Returns None if a frame is invalid, or if stop_at_invalid is set, the commands before the invalid frame.
+    This is useful when the clock is switched to a frequency too high for the logic analyzer partway through.
+    """
+    commands = []
+    next_is_app_command = False
+    byte_idx = 0
+    while byte_idx < len(mosi_bytes):
+        if mosi_bytes[byte_idx] == 0xFF:
+            byte_idx += 1
+            continue
+
+        frame = mosi_bytes[byte_idx:byte_idx + SD_COMMAND_FRAME_LENGTH]
+        if stop_at_invalid and not is_valid_command_frame(frame):
+            logger.prn_inf(f"Stopped decoding SD commands at invalid frame at byte {byte_idx}")
+            return commands
+        if len(frame) < SD_COMMAND_FRAME_LENGTH:
+            logger.prn_err(f"Truncated SD command frame at byte {byte_idx}: {frame.hex()}")
+            return None
+        if (frame[0] & 0xC0) != 0x40 or (frame[5] & 0x1) != 0x1:
+            logger.prn_err(f"Invalid SD command frame at byte {byte_idx}: {frame.hex()}")
+            return None
+        if (frame[5] >> 1) != sd_crc7(frame[0:5]):
+            logger.prn_err(f"Bad CRC in SD command frame at byte {byte_idx}: {frame.hex()}")
+            return None
+
+        index = frame[0] & 0x3F
+        if index == SD_CMD55_APP_CMD:
+            next_is_app_command = True
+        else:
+            commands.append(SDCommand(index, int.from_bytes(frame[1:5], "big"), next_is_app_command))
+            next_is_app_command = False
+
+        byte_idx += SD_COMMAND_FRAME_LENGTH
+
+    return commands
+
+
+def collapse_repeated_commands(commands: List[SDCommand]) -> List[str]:
+    """
+    Convert a list of commands to a list of command names, where consecutive repeats of a command (e.g. retries of
+    CMD0, or polling ACMD41 until the card is ready) are collapsed into one.
+    """
+    names = []
+    for command in commands:
+        if len(names) == 0 or names[-1] != command.name:
+            names.append(command.name)
+    return names
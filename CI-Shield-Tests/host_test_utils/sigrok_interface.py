@@ -13,7 +13,7 @@ import shlex
 import subprocess
 import sys
 import time
-from typing import List, cast, Optional, Tuple
+from typing import Any, Dict, Iterator, List, cast, Optional, Tuple
 from dataclasses import dataclass
 
 import usb1
@@ -105,6 +105,14 @@ class SigrokRecorderBase(abc.ABC):
         self._sigrok_process = subprocess.Popen(command, text=True, stdout = subprocess.PIPE)
         time.sleep(SIGROK_START_DELAY)
 
+    def _start_sigrok_monitor(self, sigrok_args: List[str], record_time: float):
+        """
+        Starts recording data without a trigger, for monitor().  Sampling starts as soon as sigrok launches,
+        before the start delay, so the recording is lengthened by the start delay.
+        :param record_time: Time to record for after this function returns, in seconds
+        """
+        self._start_sigrok(sigrok_args, SIGROK_START_DELAY + record_time)
+
     def _get_sigrok_output(self) -> List[str]:
         """
         Get the output from sigrok as a list of text lines.
@@ -130,6 +138,19 @@ class SigrokRecorderBase(abc.ABC):
 
         return output.split("\n")
 
+    def _stream_sigrok_output(self) -> Iterator[str]:
+        """
+        Get the output from sigrok line by line, as it's produced.  Unlike _get_sigrok_output(), the output is
+        never stored, so this can be used for long recordings.  Should only be used for recordings without a trigger,
+        since the recording must end by itself.
+        """
+
+        for line in self._sigrok_process.stdout:
+            yield line.rstrip("\n")
+
+        if self._sigrok_process.wait() != 0:
+            raise RuntimeError("Sigrok failed!")
+
     def teardown(self):
         """
         Call from test case teardown function.  Ensures that sigrok is stopped
@@ -267,6 +288,55 @@ SR_I2C_ACK = re.compile(r'i2c-1: ACK')
 SR_I2C_NACK = re.compile(r'i2c-1: NACK')
 SR_I2C_STOP = re.compile(r'i2c-1: Stop')
 
+# Regex for the sample numbers that Sigrok prints before each decoder annotation with --protocol-decoder-samplenum,
+# e.g. "1234-1250 i2c-1: Start".  Allows extracting the start sample and the rest of the line.
+SR_SAMPLENUM_PREFIX = re.compile(r'^(\d+)-\d+ (.*)$')
+
+# Option to print sample numbers before each decoder annotation
+SR_SAMPLENUM_OPTION = "--protocol-decoder-samplenum"
+
+
+@dataclass
+class SPIDataByte:
+    """
+    One byte transferred on the SPI bus
+    """
+    mosi: int
+    miso: int
+
+    def __str__(self):
+        return f"[mosi: {self.mosi:02x}, miso: {self.miso:02x}]"
+
+
+@dataclass
+class ChannelEdge:
+    """
+    An edge on one logic analyzer channel
+    """
+    channel: int
+
+    # New level of the channel (True for rising edges)
+    level: bool
+
+    def __str__(self):
+        return f"D{self.channel} {'rise' if self.level else 'fall'}"
+
+
+# Event streamed from a recording: (sample index, I2CBusData, SPIDataByte, or ChannelEdge).
+# See software_triggers.py for filtering these.
+CaptureEvent = Tuple[int, Any]
+
+
+def split_samplenum(line: str) -> Tuple[Optional[int], str]:
+    """
+    Split the sample number prefix off a line of decoder output.
+    :return: Tuple of (start sample, or None if there was no prefix, rest of the line)
+    """
+    match_info = SR_SAMPLENUM_PREFIX.match(line)
+    if match_info is None:
+        return None, line
+    return int(match_info.group(1)), match_info.group(2)
+
 
 def pretty_print_i2c_data(data: List[I2CBusData]) -> str:
     """
@@ -314,11 +384,15 @@ def pretty_diff_i2c_data(logger: HtrunLogger, expected: List[I2CBusData], actual
 
 class SigrokI2CRecorder(SigrokRecorderBase):
 
-    # i2c sigrok command
-    SIGROK_I2C_COMMAND = ["--protocol-decoders",
+    # i2c sigrok decoder arguments
+    SIGROK_I2C_DECODER = ["--protocol-decoders",
                           "i2c:scl=D1:sda=D2:address_format=unshifted",  # Set up I2C decoder
                           "--protocol-decoder-annotations",
                           "i2c=address-read:address-write:data-read:data-write:start:repeat-start:ack:nack:stop",  # Request output of all detectable conditions
+                          ]
+
+    # i2c sigrok command
+    SIGROK_I2C_COMMAND = [*SIGROK_I2C_DECODER,
 
                           # Trigger on falling edge of SCL
                           "--triggers",
@@ -335,6 +409,53 @@ class SigrokI2CRecorder(SigrokRecorderBase):
         """
         self._start_sigrok(self.SIGROK_I2C_COMMAND, record_time)
 
+    def monitor(self, record_time: float):
+        """
+        Starts recording I2C data from the logic analyzer for use with stream_events().  The recording starts
+        right away rather than on the first clock edge, so that it can be filtered with a software trigger instead.
+        :param record_time: Time to record data for after this function returns
+        """
+        self._start_sigrok_monitor([*self.SIGROK_I2C_DECODER, SR_SAMPLENUM_OPTION], record_time)
+
+    def _parse_line(self, line: str) -> Optional[I2CBusData]:
+        """
+        Parse one line of Sigrok I2C decoder output.  Returns None if the line does not contain any bus data.
+        """
+        # Note: Must check repeated start first because repeated start is a substring of start,
+        # so the start regex will match it as well.
+        if SR_I2C_REPEATED_START.match(line):
+            return I2CRepeatedStart()
+        elif SR_I2C_START.match(line):
+            return I2CStart()
+        elif SR_I2C_WRITE_TO_ADDR.match(line):
+            return I2CWriteToAddr(int(SR_I2C_WRITE_TO_ADDR.match(line).group(1), 16))
+        elif SR_I2C_READ_FROM_ADDR.match(line):
+            return I2CReadFromAddr(int(SR_I2C_READ_FROM_ADDR.match(line).group(1), 16))
+        elif SR_I2C_DATA_BYTE.match(line):
+            return I2CDataByte(int(SR_I2C_DATA_BYTE.match(line).group(1), 16))
+        elif SR_I2C_ACK.match(line):
+            return I2CAck()
+        elif SR_I2C_NACK.match(line):
+            return I2CNack()
+        elif SR_I2C_STOP.match(line):
+            return I2CStop()
+        elif line == "i2c-1: Read" or line == "i2c-1: Write" or len(line) == 0:
+            # we can ignore these ones
+            return None
+        else:
+            self.logger.prn_wrn(f"Unparsed Sigrok output: '{line}'")
+            return None
+
+    def stream_events(self) -> Iterator[CaptureEvent]:
+        """
+        Get the I2C data from a recording started with monitor(), as it's decoded.
+        """
+        for line in self._stream_sigrok_output():
+            sample_idx, line = split_samplenum(line)
+            bus_data = self._parse_line(line)
+            if bus_data is not None:
+                yield sample_idx, bus_data
+
     def get_result(self) -> List[I2CBusData]:
         """
         Get the data that was recorded.
@@ -350,33 +471,10 @@ class SigrokI2CRecorder(SigrokRecorderBase):
         i2c_transaction: List[I2CBusData] = []
 
         # Parse output
-        for line in self._sigrok_process.communicate()[0].split("\n"):
-            # Note: Must check repeated start first because repeated start is a substring of start,
-            # so the start regex will match it as well.
-            if SR_I2C_REPEATED_START.match(line):
-                i2c_transaction.append(I2CRepeatedStart())
-            elif SR_I2C_START.match(line):
-                i2c_transaction.append(I2CStart())
-            elif SR_I2C_WRITE_TO_ADDR.match(line):
-                write_address = int(SR_I2C_WRITE_TO_ADDR.match(line).group(1), 16)
-                i2c_transaction.append(I2CWriteToAddr(write_address))
-            elif SR_I2C_READ_FROM_ADDR.match(line):
-                read_address = int(SR_I2C_READ_FROM_ADDR.match(line).group(1), 16)
-                i2c_transaction.append(I2CReadFromAddr(read_address))
-            elif SR_I2C_DATA_BYTE.match(line):
-                data = int(SR_I2C_DATA_BYTE.match(line).group(1), 16)
-                i2c_transaction.append(I2CDataByte(data))
-            elif SR_I2C_ACK.match(line):
-                i2c_transaction.append(I2CAck())
-            elif SR_I2C_NACK.match(line):
-                i2c_transaction.append(I2CNack())
-            elif SR_I2C_STOP.match(line):
-                i2c_transaction.append(I2CStop())
-            elif line == "i2c-1: Read" or line == "i2c-1: Write" or len(line) == 0:
-                # we can ignore these ones
-                pass
-            else:
-                self.logger.prn_wrn(f"Unparsed Sigrok output: '{line}'")
+        for line in sigrok_output:
+            bus_data = self._parse_line(line)
+            if bus_data is not None:
+                i2c_transaction.append(bus_data)
 
         return i2c_transaction
 
@@ -442,14 +540,7 @@ class SigrokSPIRecorder(SigrokRecorderBase):
         self._has_cs_pin = cs_pin is not None
 
         # spi sigrok command
-        cpol = spi_mode // 2
-        cpha = spi_mode % 2
-        sigrok_spi_command = [
-              # Set up SPI decoder.
-              # Note that for now we always use a word size of 8, but that can be changed later.
-              "--protocol-decoders",
-              f"spi:clk=D3:mosi=D2:miso=D1{':cs=' + cs_pin if self._has_cs_pin else ''}:cpol={cpol}:cpha={cpha}:wordsize=8",
-              ]
+        sigrok_spi_command = self._decoder_args(cs_pin, spi_mode)
 
         if self._has_cs_pin:
             # Trigger on falling edge of CS
@@ -471,6 +562,63 @@ class SigrokSPIRecorder(SigrokRecorderBase):
 
         self._start_sigrok(sigrok_spi_command, record_time)
 
+    @staticmethod
+    def _decoder_args(cs_pin: Optional[str], spi_mode: int) -> List[str]:
+        """
+        Get the Sigrok arguments to set up the SPI decoder.
+        """
+        cpol = spi_mode // 2
+        cpha = spi_mode % 2
+        return [
+              # Set up SPI decoder.
+              # Note that for now we always use a word size of 8, but that can be changed later.
+              "--protocol-decoders",
+              f"spi:clk=D3:mosi=D2:miso=D1{':cs=' + cs_pin if cs_pin is not None else ''}:cpol={cpol}:cpha={cpha}:wordsize=8",
+              ]
+
+    def monitor(self, cs_pin: Optional[str], record_time: float, spi_mode: int = 0):
+        """
+        Starts recording SPI data from the logic analyzer for use with stream_events().  The recording starts
+        right away rather than on a CS or clock edge, so that it can be filtered with a software trigger instead.
+        :param cs_pin: Logic analyzer pin to use for chip select, or None to record all traffic
+        :param record_time: Time to record data for after this function returns
+        :param spi_mode: SPI mode from 0-3
+        """
+        self._has_cs_pin = cs_pin is not None
+        self._start_sigrok_monitor([*self._decoder_args(cs_pin, spi_mode),
+                                    "--protocol-decoder-annotations", "spi=mosi-data:miso-data",
+                                    SR_SAMPLENUM_OPTION],
+                                   record_time)
+
+    def stream_events(self) -> Iterator[CaptureEvent]:
+        """
+        Get the bytes from a recording started with monitor(), as they're decoded.
+        """
+
+        # Sample index and value of the MISO byte, which sigrok prints before the MOSI byte of the same word.
+        # The two are paired by their start sample, so that a line which is lost or unparsed only loses its own word.
+        miso_byte: Optional[Tuple[int, int]] = None
+
+        for line in self._stream_sigrok_output():
+            sample_idx, line = split_samplenum(line)
+            if line == "":
+                continue
+
+            match_info = SR_SPI_DATA_BYTE.match(line)
+            if not match_info:
+                self.logger.prn_wrn(f"Unparsed Sigrok output: '{line}'")
+                continue
+
+            byte_value = int(match_info.group(1), 16)
+            if miso_byte is None:
+                miso_byte = (sample_idx, byte_value)
+            elif miso_byte[0] != sample_idx:
+                self.logger.prn_wrn(f"Dropping unpaired SPI byte 0x{miso_byte[1]:02x} at sample {miso_byte[0]}")
+                miso_byte = (sample_idx, byte_value)
+            else:
+                yield miso_byte[0], SPIDataByte(mosi=byte_value, miso=miso_byte[1])
+                miso_byte = None
+
     def get_result(self) -> List[SPITransaction]:
         """
         Get the SPI data recorded by the logic analyzer.
@@ -648,3 +796,149 @@ class SigrokSignalAnalyzer(SigrokRecorderBase):
         frequency = num_rising_edges / self.RECORD_TIME
 
         return (frequency, duty_cycle)
+
+
+# Logic analyzer channel which the marker output (PIN_TEST_MARKER, which is GPOUT_1) is connected to.
+# Unlike channels 0-3, this does not depend on the FUNC_SEL setting.
+MARKER_CHANNEL = 6
+
+# Regex for one line of raw samples in Sigrok's CSV output, e.g. "0,1,1"
+SR_CSV_SAMPLE_LINE = re.compile(r'^[01](,[01])*$')
+
+
+@dataclass
+class MarkerCapture:
+    """
+    Edges recorded on the marker channel and on a set of bus channels.
+    Edges are stored as the index of the first sample at the new level, so times can be computed with the precision
+    of the logic analyzer's sample clock.
+    """
+
+    # Time between samples, in seconds
+    sample_period: float
+
+    # Sample indices of each marker edge, in order.  Rising and falling edges are both markers.
+    marker_edges: List[int]
+
+    # Sample indices of just the rising marker edges, for tests which pulse the marker
+    marker_rising_edges: List[int]
+
+    # For each bus channel number, list of (sample index, new level) for each edge on that channel
+    channel_edges: Dict[int, List[Tuple[int, bool]]]
+
+    def first_edge_after(self, channel: int, sample_idx: int, level: Optional[bool] = None) -> Optional[int]:
+        """
+        Get the sample index of the first edge on the given channel at or after sample_idx.
+        :param level: If set, only count edges to this level (True for rising edges, False for falling edges)
+        """
+        for edge_idx, edge_level in self.channel_edges[channel]:
+            if edge_idx >= sample_idx and (level is None or edge_level == level):
+                return edge_idx
+        return None
+
+    def last_edge_before(self, channel: int, sample_idx: int, level: Optional[bool] = None) -> Optional[int]:
+        """
+        Get the sample index of the last edge on the given channel at or before sample_idx.
+        :param level: If set, only count edges to this level (True for rising edges, False for falling edges)
+        """
+        last_edge = None
+        for edge_idx, edge_level in self.channel_edges[channel]:
+            if edge_idx > sample_idx:
+                break
+            if level is None or edge_level == level:
+                last_edge = edge_idx
+        return last_edge
+
+    def samples_to_seconds(self, num_samples: int) -> float:
+        return num_samples * self.sample_period
+
+
+class SigrokMarkerRecorder(SigrokRecorderBase):
+    """
+    Class which records raw samples of the marker channel along with some bus channels, so that the time from
+    a marker (see TestMarker in ci_test_common.h) to activity on the bus can be measured.
+    The recording triggers on the first marker edge.
+    """
+
+    def __init__(self):
+        super().__init__()
+        self.logger = HtrunLogger('SigrokMarkerRecorder')
+        self._channels: List[int] = []
+
+    def record(self, bus_channels: List[int], record_time: float):
+        """
+        Starts recording the marker channel and the given bus channels.
+        :param bus_channels: Logic analyzer channel numbers (0-7) of the bus signals to record
+        :param record_time: Time after the first marker edge to record data for
+        """
+
+        # Sigrok outputs the columns in channel order, so sort them to match
+        self._channels = sorted(set(bus_channels) | {MARKER_CHANNEL})
+
+        sigrok_args = [
+            "--channels", ",".join(f"D{channel}" for channel in self._channels),
+            "--output-format", "csv",
+            "--triggers", f"D{MARKER_CHANNEL}=e"
+        ]
+        self._start_sigrok(sigrok_args, record_time)
+
+    def monitor(self, bus_channels: List[int], record_time: float):
+        """
+        Starts recording the marker channel and the given bus channels for use with stream_events().  The recording
+        starts right away rather than on the first marker edge, so that it can be filtered with a software trigger
+        instead.
+        :param bus_channels: Logic analyzer channel numbers (0-7) of the bus signals to record
+        :param record_time: Time to record data for after this function returns
+        """
+        self._channels = sorted(set(bus_channels) | {MARKER_CHANNEL})
+
+        sigrok_args = [
+            "--channels", ",".join(f"D{channel}" for channel in self._channels),
+            "--output-format", "csv",
+        ]
+        self._start_sigrok_monitor(sigrok_args, record_time)
+
+    def stream_events(self) -> Iterator[CaptureEvent]:
+        """
+        Get the edges on each channel from a recording started with monitor(), as they're seen.
+        """
+        sample_idx = 0
+        previous_line: Optional[str] = None
+        for line in self._stream_sigrok_output():
+            if not SR_CSV_SAMPLE_LINE.match(line):
+                continue
+
+            # Most samples have no edges, so only split lines which changed
+            if previous_line is not None and line != previous_line:
+                for channel, previous_value, value in zip(self._channels, previous_line.split(","), line.split(",")):
+                    if value != previous_value:
+                        yield sample_idx, ChannelEdge(channel, value == "1")
+            previous_line = line
+            sample_idx += 1
+
+    def get_result(self) -> MarkerCapture:
+        """
+        Get the edges that were recorded.
+        """
+
+        # Lines other than samples are the CSV header and comments
+        sample_lines = [line for line in self._get_sigrok_output() if SR_CSV_SAMPLE_LINE.match(line)]
+
+        edges: Dict[int, List[Tuple[int, bool]]] = {channel: [] for channel in self._channels}
+        previous_levels: Optional[List[bool]] = None
+        for sample_idx, line in enumerate(sample_lines):
+            levels = [value == "1" for value in line.split(",")]
+            if len(levels) != len(self._channels):
+                raise RuntimeError(f"Expected {len(self._channels)} channels in Sigrok output, got '{line}'")
+
+            if previous_levels is not None:
+                for channel, previous_level, level in zip(self._channels, previous_levels, levels):
+                    if level != previous_level:
+                        edges[channel].append((sample_idx, level))
+            previous_levels = levels
+
+        marker_edge_levels = edges.pop(MARKER_CHANNEL)
+        return MarkerCapture(sample_period=1 / (LOGIC_ANALYZER_FREQUENCY * 1e6),
+                             marker_edges=[edge_idx for edge_idx, _ in marker_edge_levels],
+                             marker_rising_edges=[edge_idx for edge_idx, level in marker_edge_levels if level],
+                             channel_edges=edges)
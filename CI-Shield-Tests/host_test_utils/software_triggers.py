@@ -0,0 +1,185 @@
+## Module implementing protocol-level "software" triggers for logic analyzer captures.
+## The logic analyzer's own triggers can only match simple edges on the raw channels.  Software triggers instead
+## run on the decoded events as they stream out of Sigrok, and keep only a window of events around each match.
+## This allows monitoring a bus for a long time without storing (or printing) everything seen on it.
+
+import abc
+import collections
+from dataclasses import dataclass, field
+from typing import Any, Deque, Iterable, List, Optional
+
+from .sigrok_interface import I2CBusData, I2CWriteToAddr, I2CReadFromAddr, SPIDataByte, ChannelEdge, CaptureEvent, \
+    LOGIC_ANALYZER_FREQUENCY, MARKER_CHANNEL
+
+
+class SoftwareTrigger(abc.ABC):
+    """
+    Base class for software triggers.  A trigger is fed every decoded event in order, and says whether the
+    trigger condition was met at that event.
+    """
+
+    @abc.abstractmethod
+    def feed(self, sample_idx: int, event: Any) -> bool:
+        """
+        Process the next event of the capture.
+        :return: True if the trigger condition was met at this event
+        """
+
+    def reset(self):
+        """
+        Forget any partial match, e.g. when starting a new capture.
+        """
+
+
+class I2CAddressTrigger(SoftwareTrigger):
+    """
+    Triggers when the given (8-bit) address is addressed on the I2C bus, for writing or (if read is True) reading.
+    """
+
+    def __init__(self, address: int, read: bool = False):
+        self._expected = I2CReadFromAddr(address | 1) if read else I2CWriteToAddr(address & ~1)
+
+    def feed(self, sample_idx: int, event: Any) -> bool:
+        return isinstance(event, I2CBusData) and event == self._expected
+
+
+class SPIMOSISequenceTrigger(SoftwareTrigger):
+    """
+    Triggers when the given sequence of consecutive bytes is sent on MOSI.
+    """
+
+    def __init__(self, sequence: bytes):
+        if len(sequence) == 0:
+            raise ValueError("Sequence must not be empty")
+        self._sequence = bytes(sequence)
+        self._recent_bytes: Deque[int] = collections.deque(maxlen=len(sequence))
+
+    def feed(self, sample_idx: int, event: Any) -> bool:
+        if not isinstance(event, SPIDataByte):
+            return False
+        self._recent_bytes.append(event.mosi)
+        return bytes(self._recent_bytes) == self._sequence
+
+    def reset(self):
+        self._recent_bytes.clear()
+
+
+class MarkerPulseTrigger(SoftwareTrigger):
+    """
+    Triggers at the end of a high pulse on a channel (by default the marker channel) whose width is within the
+    given range.  This matches the pulses made by calling TestMarker::mark() twice.
+    """
+
+    def __init__(self, channel: int = MARKER_CHANNEL, min_width: float = 0, max_width: Optional[float] = None):
+        """
+        :param min_width: Minimum pulse width in seconds
+        :param max_width: Maximum pulse width in seconds, or None for no maximum
+        """
+        self._channel = channel
+        self._min_samples = min_width * LOGIC_ANALYZER_FREQUENCY * 1e6
+        self._max_samples = None if max_width is None else max_width * LOGIC_ANALYZER_FREQUENCY * 1e6
+        self._rise_sample: Optional[int] = None
+
+    def feed(self, sample_idx: int, event: Any) -> bool:
+        if not isinstance(event, ChannelEdge) or event.channel != self._channel:
+            return False
+
+        if event.level:
+            self._rise_sample = sample_idx
+            return False
+
+        if self._rise_sample is None:
+            return False
+        width = sample_idx - self._rise_sample
+        self._rise_sample = None
+        return width >= self._min_samples and (self._max_samples is None or width <= self._max_samples)
+
+    def reset(self):
+        self._rise_sample = None
+
+
+@dataclass
+class CaptureWindow:
+    """
+    Events seen around one match of a software trigger.
+    """
+
+    # Sample index of the event which matched the trigger
+    trigger_sample: int
+
+    # Events in the window, in order
+    events: List[CaptureEvent] = field(default_factory=list)
+
+    def __str__(self):
+        return "\n".join(f"{sample_idx - self.trigger_sample:+d}: {event}" for sample_idx, event in self.events)
+
+
+class TriggerWindowFilter:
+    """
+    Filters a stream of capture events down to windows around the matches of a software trigger.
+    Only the events within pre_trigger_time of the latest event are buffered while waiting for a match, so memory
+    use does not depend on the length of the capture.
+    Matches that happen inside an open window extend it instead of starting a new one.
+    """
+
+    def __init__(self, trigger: SoftwareTrigger, pre_trigger_time: float, post_trigger_time: float,
+                 max_windows: Optional[int] = None):
+        """
+        :param pre_trigger_time: Time before each match to keep events for, in seconds
+        :param post_trigger_time: Time after each match to keep events for, in seconds
+        :param max_windows: Stop keeping windows after this many, or None for no limit
+        """
+        self._trigger = trigger
+        self._pre_samples = round(pre_trigger_time * LOGIC_ANALYZER_FREQUENCY * 1e6)
+        self._post_samples = round(post_trigger_time * LOGIC_ANALYZER_FREQUENCY * 1e6)
+        self._max_windows = max_windows
+
+        self._history: Deque[CaptureEvent] = collections.deque()
+        self._open_window: Optional[CaptureWindow] = None
+        self._window_end = 0
+        self.windows: List[CaptureWindow] = []
+
+        # Number of events processed, and number of matches of the trigger
+        self.events_seen = 0
+        self.matches = 0
+
+        trigger.reset()
+
+    def process(self, events: Iterable[CaptureEvent]) -> List[CaptureWindow]:
+        """
+        Process all the events of a capture, e.g. from a recorder's stream_events().
+        :return: Windows around the matches of the trigger
+        """
+        for sample_idx, event in events:
+            self.feed(sample_idx, event)
+        return self.windows
+
+    def feed(self, sample_idx: int, event: Any):
+        """
+        Process the next event of the capture.
+        """
+        self.events_seen += 1
+        triggered = self._trigger.feed(sample_idx, event)
+        if triggered:
+            self.matches += 1
+
+        if self._open_window is not None:
+            if sample_idx > self._window_end:
+                self._open_window = None
+            else:
+                self._open_window.events.append((sample_idx, event))
+                if triggered:
+                    self._window_end = sample_idx + self._post_samples
+                return
+
+        if triggered and (self._max_windows is None or len(self.windows) < self._max_windows):
+            self._open_window = CaptureWindow(trigger_sample=sample_idx, events=list(self._history))
+            self._open_window.events.append((sample_idx, event))
+            self._window_end = sample_idx + self._post_samples
+            self.windows.append(self._open_window)
+            self._history.clear()
+            return
+
+        self._history.append((sample_idx, event))
+        while len(self._history) > 0 and self._history[0][0] < sample_idx - self._pre_samples:
+            self._history.popleft()
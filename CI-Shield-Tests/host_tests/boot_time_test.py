@@ -0,0 +1,93 @@
+import sys
+import os
+import pathlib
+import subprocess
+import time
+
+# Unfortunately there's no easy way to make the test runner add a directory to its module path...
+this_script_dir = pathlib.Path(os.path.dirname(__file__))
+sys.path.append(str(this_script_dir / ".."))
+
+from host_test_utils import pipelined_host_test
+from host_test_utils.sigrok_interface import SigrokMarkerRecorder
+
+
+class BootTimeHostTest(pipelined_host_test.PipelinedHostTest):
+
+    """
+    Host test for the boot time test.  Records the marker pin while the device resets itself, then measures the
+    time from the reset to each boot stage.
+    """
+
+    # Time after the reset to record the marker for.  Should be longer than any target takes to get to main().
+    RECORD_TIME = 1.0 # s
+
+    # Number of marker pulses expected: the reset, the start and end of static init, and main()
+    EXPECTED_PULSES = 4
+
+    def __init__(self):
+        super(BootTimeHostTest, self).__init__()
+
+        self.recorder = SigrokMarkerRecorder()
+
+        # Whether the device has been reset by the test yet
+        self.device_reset = False
+
+    def _callback_get_start_case(self, key: str, value: str, timestamp):
+        """
+        Tell the device which case to start at: the reset case at first, then the measurement case after the reset.
+        """
+        self.send_kv('start_case', '1' if self.device_reset else '0')
+
+    def _callback_start_boot_capture(self, key: str, value: str, timestamp):
+        """
+        Start recording the marker, then resync with the device after it resets itself.
+        """
+
+        self.recorder.record([], self.RECORD_TIME)
+        self.device_reset = True
+        self.send_kv('start_boot_capture', 'complete')
+
+        # After it resets, the device waits for the sync message again, like when it was first started
+        cycle_s = self.get_config_item('program_cycle_s')
+        time.sleep(cycle_s if cycle_s is not None else 2.0)
+        self.send_kv('__sync', '00000000-0000-000000000-000000000000')
+
+    def _callback_report_boot_times(self, key: str, value: str, timestamp):
+        """
+        Report the time of each boot stage from the recorded marker pulses.  The value is the time in us from
+        the RTOS kernel starting to the start of static init, as measured by the device.
+        """
+
+        try:
+            capture = self.recorder.get_result()
+        except subprocess.TimeoutExpired:
+            self.logger.prn_err("Logic analyzer did not see the marker")
+            self.send_kv('report_boot_times', 'fail')
+            return
+
+        if len(capture.marker_rising_edges) != self.EXPECTED_PULSES:
+            self.logger.prn_err(f"Expected {self.EXPECTED_PULSES} marker pulses but saw {len(capture.marker_rising_edges)}")
+            self.send_kv('report_boot_times', 'fail')
+            return
+
+        _, static_init_start, static_init_end, main_start = \
+            [capture.samples_to_seconds(edge - capture.marker_rising_edges[0]) * 1e6 for edge in capture.marker_rising_edges]
+
+        self.report_metric("Reset to RTOS kernel start", static_init_start - float(value), "us")
+        self.report_metric("Reset to static init start", static_init_start, "us")
+        self.report_metric("Static init time (measured by host)", static_init_end - static_init_start, "us")
+        self.report_metric("Reset to main", main_start, "us")
+
+        self.send_kv('report_boot_times', 'complete')
+
+    def setup(self):
+
+        self.register_callback('get_start_case', self._callback_get_start_case)
+        self.register_callback('start_boot_capture', self._callback_start_boot_capture)
+        self.register_callback('report_boot_times', self._callback_report_boot_times)
+
+        self.logger.prn_inf("Boot Time Test host test setup complete.")
+
+    def teardown(self):
+        self.recorder.teardown()
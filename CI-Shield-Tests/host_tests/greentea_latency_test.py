@@ -0,0 +1,38 @@
+from mbed_host_tests import BaseHostTest
+from mbed_host_tests.host_tests_logger import HtrunLogger
+
+import sys
+import os
+import pathlib
+
+# Unfortunately there's no easy way to make the test runner add a directory to its module path...
+this_script_dir = pathlib.Path(os.path.dirname(__file__))
+sys.path.append(str(this_script_dir / ".."))
+
+from host_test_utils.interface_chip import get_interface_chip_name
+
+class GreenteaLatencyHostTest(BaseHostTest):
+
+    """
+    Host test for the greentea latency benchmark.  Echoes every message straight back to the device,
+    and reports which interface chip the device is connected through.
+    """
+
+    def __init__(self):
+        super(GreenteaLatencyHostTest, self).__init__()
+
+        self.logger = HtrunLogger('TEST')
+
+    def _callback_echo(self, key: str, value: str, timestamp):
+        """
+        Send the message straight back
+        """
+        self.send_kv(key, value)
+
+    def setup(self):
+
+        self.register_callback('echo', self._callback_echo)
+
+        self.logger.prn_inf("Interface chip: " + get_interface_chip_name(self.get_config_item('port')))
+
+        self.logger.prn_inf("Greentea Latency Test host test setup complete.")
@@ -1,6 +1,3 @@
-from mbed_host_tests import BaseHostTest
-from mbed_host_tests.host_tests_logger import HtrunLogger
-
 import traceback
 import binascii
 import sys
@@ -12,10 +9,11 @@ import subprocess
 this_script_dir = pathlib.Path(os.path.dirname(__file__))
 sys.path.append(str(this_script_dir / ".."))
 
-from host_test_utils.sigrok_interface import I2CStart, I2CRepeatedStart, I2CWriteToAddr, I2CReadFromAddr, I2CDataByte, I2CAck, I2CNack, I2CStop, SigrokI2CRecorder, pretty_print_i2c_data, pretty_diff_i2c_data
+from host_test_utils import pipelined_host_test
+from host_test_utils.sigrok_interface import I2CStart, I2CRepeatedStart, I2CWriteToAddr, I2CReadFromAddr, I2CDataByte, I2CAck, I2CNack, I2CStop, SigrokI2CRecorder, SigrokMarkerRecorder, pretty_print_i2c_data, pretty_diff_i2c_data
 
 
-class I2CBasicTestHostTest(BaseHostTest):
+class I2CBasicTestHostTest(pipelined_host_test.PipelinedHostTest):
 
     """
     Host test for the I2C Basic Test testsuite.
@@ -51,35 +49,70 @@ class I2CBasicTestHostTest(BaseHostTest):
                             I2CRepeatedStart(), I2CReadFromAddr(0xA1), I2CAck(), I2CDataByte(0x3), I2CNack(), I2CStop()],
     }
 
+    # Logic analyzer channel which SDA is on
+    SDA_CHANNEL = 2
+
     def __init__(self):
         super(I2CBasicTestHostTest, self).__init__()
 
-        self.logger = HtrunLogger('TEST')
         self.recorder = SigrokI2CRecorder()
+        self.marker_recorder = SigrokMarkerRecorder()
 
-    def _callback_start_recording_i2c(self, key: str, value: str, timestamp):
+    def _start_recording_i2c(self, payload: str):
         """
         Called at the start of every test case.  Should start a recording of I2C data.
         """
 
         self.recorder.record(0.05) # Everything we do in this test should complete in under 0.05s
 
-        self.send_kv('start_recording_i2c', 'complete')
-
-    def _callback_verify_sequence(self, key: str, value: str, timestamp):
+    def _verify_sequence(self, sequence_name: str) -> bool:
         """
         Verify that the current recorded I2C data matches the given sequence
         """
         recorded_data = self.recorder.get_result()
 
-        self.send_kv('verify_sequence', 'complete' if pretty_diff_i2c_data(self.logger, self.SEQUENCES[value], recorded_data) else 'failed')
+        return pretty_diff_i2c_data(self.logger, self.SEQUENCES[sequence_name], recorded_data)
+
+    def _start_marker_capture(self, payload: str):
+        """
+        Start recording the marker and SDA.
+        """
+
+        self.marker_recorder.record([self.SDA_CHANNEL], 0.05)
+
+    def _report_start_latency(self, api_name: str) -> bool:
+        """
+        Report the latency from the marker to the start condition, i.e. the first falling edge on SDA.
+        The payload is the name of the API call which was measured.
+        """
+
+        try:
+            capture = self.marker_recorder.get_result()
+        except subprocess.TimeoutExpired:
+            self.logger.prn_err("Logic analyzer did not see the marker")
+            return False
+
+        if len(capture.marker_edges) != 1:
+            self.logger.prn_err(f"Expected 1 marker but saw {len(capture.marker_edges)}")
+            return False
+
+        start_condition = capture.first_edge_after(self.SDA_CHANNEL, capture.marker_edges[0], level=False)
+        if start_condition is None:
+            self.logger.prn_err("No start condition after the marker")
+            return False
+
+        self.report_metric(f"Latency from {api_name} to start condition", capture.samples_to_seconds(start_condition - capture.marker_edges[0]) * 1e6, "us")
+        return True
 
     def setup(self):
 
-        self.register_callback('start_recording_i2c', self._callback_start_recording_i2c)
-        self.register_callback('verify_sequence', self._callback_verify_sequence)
+        self.register_capture_callback('start_recording_i2c', self._start_recording_i2c)
+        self.register_verdict_callback('verify_sequence', self._verify_sequence)
+        self.register_capture_callback('start_marker_capture', self._start_marker_capture)
+        self.register_verdict_callback('report_start_latency', self._report_start_latency)
 
         self.logger.prn_inf("I2C Basic Test host test setup complete.")
 
     def teardown(self):
         self.recorder.teardown()
+        self.marker_recorder.teardown()
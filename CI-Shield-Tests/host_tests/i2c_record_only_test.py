@@ -11,6 +11,7 @@ this_script_dir = pathlib.Path(os.path.dirname(__file__))
 sys.path.append(str(this_script_dir / ".."))
 
 from host_test_utils.sigrok_interface import SigrokI2CRecorder, pretty_print_i2c_data
+from host_test_utils.software_triggers import I2CAddressTrigger, TriggerWindowFilter
 
 
 class I2CRecordOnlyTestHostTest(BaseHostTest):
@@ -19,6 +20,9 @@ class I2CRecordOnlyTestHostTest(BaseHostTest):
     Host test which just logs and prints I2C data during a specific period.
     """
 
+    # Time to record for if the device does not give one
+    DEFAULT_RECORD_TIME = 0.1 # Everything we do in most test cases should complete in under 0.1s
+
     def __init__(self):
         super(I2CRecordOnlyTestHostTest, self).__init__()
 
@@ -28,12 +32,28 @@ class I2CRecordOnlyTestHostTest(BaseHostTest):
     def _callback_start_recording_i2c(self, key: str, value: str, timestamp):
         """
         Called at the start of every test case.  Should start a recording of I2C data.
+        The value may give the time to record for in seconds, for test cases which do long transfers.
         """
 
-        self.recorder.record(0.1) # Everything we do in this test should complete in under 0.1s
+        try:
+            record_time = float(value)
+        except ValueError:
+            record_time = self.DEFAULT_RECORD_TIME
+
+        self.recorder.record(record_time)
 
         self.send_kv('start_recording_i2c', 'complete')
 
+    def _callback_start_monitoring_i2c(self, key: str, value: str, timestamp):
+        """
+        Start a recording of I2C data which is decoded as it's streamed, for count_i2c_address_phases.
+        The value gives the time to record for in seconds, counted from when the device is told that monitoring started.
+        """
+
+        self.recorder.monitor(float(value))
+
+        self.send_kv('start_monitoring_i2c', 'complete')
+
     def _callback_display_i2c_data(self, key: str, value: str, timestamp):
         """
         Verify that the current recorded I2C data matches the given sequence
@@ -51,10 +71,35 @@ class I2CRecordOnlyTestHostTest(BaseHostTest):
 
         self.send_kv('display_i2c_data', 'complete')
 
+    def _callback_count_i2c_address_phases(self, key: str, value: str, timestamp):
+        """
+        Count the address phases in the I2C data recorded with start_monitoring_i2c, i.e. the times that a memory
+        address was written to the device at the given (8-bit) address, and the times that data was read from it.
+        Replies with "<address writes>,<reads>".
+        """
+
+        address = int(value, 0)
+
+        # Only the matches are needed, so the filters don't keep any windows
+        write_filter = TriggerWindowFilter(I2CAddressTrigger(address), pre_trigger_time=0, post_trigger_time=0,
+                                           max_windows=0)
+        read_filter = TriggerWindowFilter(I2CAddressTrigger(address, read=True), pre_trigger_time=0,
+                                          post_trigger_time=0, max_windows=0)
+        for sample_idx, event in self.recorder.stream_events():
+            write_filter.feed(sample_idx, event)
+            read_filter.feed(sample_idx, event)
+
+        self.logger.prn_inf(f"Saw {write_filter.matches} address writes and {read_filter.matches} reads to 0x{address:02x} "
+                            f"on the I2C bus ({write_filter.events_seen} items)")
+
+        self.send_kv('count_i2c_address_phases', f'{write_filter.matches},{read_filter.matches}')
+
     def setup(self):
 
         self.register_callback('start_recording_i2c', self._callback_start_recording_i2c)
+        self.register_callback('start_monitoring_i2c', self._callback_start_monitoring_i2c)
         self.register_callback('display_i2c_data', self._callback_display_i2c_data)
+        self.register_callback('count_i2c_address_phases', self._callback_count_i2c_address_phases)
 
         self.logger.prn_inf("I2C Record-Only Test host test setup complete.")
 
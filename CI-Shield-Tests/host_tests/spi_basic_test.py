@@ -1,6 +1,3 @@
-from mbed_host_tests import BaseHostTest
-from mbed_host_tests.host_tests_logger import HtrunLogger
-
 import subprocess
 import binascii
 import sys
@@ -12,9 +9,10 @@ from typing import Dict, List
 this_script_dir = pathlib.Path(os.path.dirname(__file__))
 sys.path.append(str(this_script_dir / ".."))
 
-from host_test_utils.sigrok_interface import SPITransaction, SigrokSPIRecorder, pretty_diff_spi_data
+from host_test_utils import pipelined_host_test
+from host_test_utils.sigrok_interface import SPITransaction, SigrokSPIRecorder, SigrokMarkerRecorder, pretty_diff_spi_data
 
-class SpiBasicTestHostTest(BaseHostTest):
+class SpiBasicTestHostTest(pipelined_host_test.PipelinedHostTest):
 
     """
     Host test for the SPI Basic Test testsuite.
@@ -30,36 +28,36 @@ class SpiBasicTestHostTest(BaseHostTest):
         )]
     }
 
+    # Logic analyzer channel which SCLK is on
+    SCLK_CHANNEL = 3
+
     def __init__(self):
         super(SpiBasicTestHostTest, self).__init__()
 
-        self.logger = HtrunLogger('TEST')
         self.recorder = SigrokSPIRecorder()
+        self.marker_recorder = SigrokMarkerRecorder()
 
-    def _callback_start_recording_spi(self, key: str, value: str, timestamp):
+    def _start_recording_spi(self, payload: str):
         """
         Called at the start of every test case.  Should start a recording of SPI data.
+        The payload is the time to record for, in seconds.
         """
 
-        self.recorder.record(None, .05) # .05 seconds should be enough for every test in this suite
+        self.recorder.record(None, float(payload))
 
-        self.send_kv('start_recording_spi', 'complete')
-
-    def _callback_verify_sequence(self, key: str, value: str, timestamp):
+    def _verify_sequence(self, sequence_name: str) -> bool:
         """
         Verify that the current recorded SPI data matches the given sequence
         """
 
         try:
             spi_transactions = self.recorder.get_result()
-            success = pretty_diff_spi_data(self.logger, self.SEQUENCES[value], spi_transactions)
+            return pretty_diff_spi_data(self.logger, self.SEQUENCES[sequence_name], spi_transactions)
         except subprocess.TimeoutExpired:
             self.logger.prn_err("Logic analyzer did not trigger")
-            success = False
-
-        self.send_kv('verify_sequence', 'complete' if success else 'failed')
+            return False
 
-    def _callback_verify_queue_and_abort_test(self, key: str, value: str, timestamp):
+    def _verify_queue_and_abort_test(self, payload: str) -> bool:
         """
         Verify that the current recorded SPI data matches the queueing and abort test
         """
@@ -81,29 +79,97 @@ class SpiBasicTestHostTest(BaseHostTest):
                     print("Second message looks OK")
                     data_valid = True
 
-        if data_valid:
-            self.send_kv('verify_queue_and_abort_test', 'pass')
-        else:
+        if not data_valid:
             self.logger.prn_err("Incorrect MOSI data for queue and abort test")
-            self.send_kv('verify_queue_and_abort_test', 'fail')
+        return data_valid
+
+    def _verify_tx_then_fill(self, payload: str) -> bool:
+        """
+        Verify that the recorded MOSI data is some Tx data followed by a run of fill bytes.
+        The payload is "<tx data in hex, or - if none> <fill length> <fill value in hex>".
+        """
+
+        tx_hex, fill_length, fill_value = payload.split(" ")
+        expected_mosi = (b"" if tx_hex == "-" else bytes.fromhex(tx_hex)) + bytes([int(fill_value, 16)]) * int(fill_length)
+
+        try:
+            spi_transactions = self.recorder.get_result()
+        except subprocess.TimeoutExpired:
+            self.logger.prn_err("Logic analyzer did not trigger")
+            return False
+
+        mosi = b"".join(transaction.mosi_bytes for transaction in spi_transactions)
+        if mosi == expected_mosi:
+            return True
+
+        if len(mosi) != len(expected_mosi):
+            self.logger.prn_err(f"Expected {len(expected_mosi)} bytes on MOSI but saw {len(mosi)}")
+        for byte_idx, (actual, expected) in enumerate(zip(mosi, expected_mosi)):
+            if actual != expected:
+                self.logger.prn_err(f"First wrong MOSI byte is at index {byte_idx}: expected 0x{expected:02x}, saw 0x{actual:02x}")
+                break
+        return False
 
-    def _callback_print_spi_data(self, key: str, value: str, timestamp):
+    def _start_marker_capture(self, payload: str):
+        """
+        Start recording the marker and SCLK.  The payload is the time to record for, in seconds.
+        """
+
+        self.marker_recorder.record([self.SCLK_CHANNEL], float(payload))
+
+    def _report_marker_latency(self, payload: str) -> bool:
+        """
+        Report the latency from the first marker to the first SCLK edge.  If the payload (the number of markers)
+        is 2, the second marker is in the transfer callback, and the latency from the last SCLK edge to it is
+        reported too.
+        """
+
+        num_markers = int(payload)
+        try:
+            capture = self.marker_recorder.get_result()
+        except subprocess.TimeoutExpired:
+            self.logger.prn_err("Logic analyzer did not see the marker")
+            return False
+
+        if len(capture.marker_edges) != num_markers:
+            self.logger.prn_err(f"Expected {num_markers} markers but saw {len(capture.marker_edges)}")
+            return False
+
+        first_sclk = capture.first_edge_after(self.SCLK_CHANNEL, capture.marker_edges[0])
+        if first_sclk is None:
+            self.logger.prn_err("No SCLK edges after the marker")
+            return False
+        self.report_metric("Latency from transfer() to first SCLK", capture.samples_to_seconds(first_sclk - capture.marker_edges[0]) * 1e6, "us")
+
+        if num_markers == 2:
+            last_sclk = capture.last_edge_before(self.SCLK_CHANNEL, capture.marker_edges[1])
+            if last_sclk is None or last_sclk < first_sclk:
+                self.logger.prn_err("Callback marker came before the transfer started")
+                return False
+            self.report_metric("Latency from last SCLK to callback", capture.samples_to_seconds(capture.marker_edges[1] - last_sclk) * 1e6, "us")
+
+        return True
+
+    def _print_spi_data(self, payload: str) -> bool:
         """
         Called at the end of test cases which do not do verification and just want to print the recorded data.
         """
 
         self.logger.prn_inf("Saw on the SPI bus: " + str(self.recorder.get_result()[0]))
-
-        self.send_kv('print_spi_data', 'complete')
+        return True
 
     def setup(self):
 
-        self.register_callback('start_recording_spi', self._callback_start_recording_spi)
-        self.register_callback('verify_sequence', self._callback_verify_sequence)
-        self.register_callback('verify_queue_and_abort_test', self._callback_verify_queue_and_abort_test)
-        self.register_callback('print_spi_data', self._callback_print_spi_data)
+        self.register_capture_callback('start_recording_spi', self._start_recording_spi)
+        self.register_verdict_callback('verify_sequence', self._verify_sequence)
+        self.register_verdict_callback('verify_queue_and_abort_test', self._verify_queue_and_abort_test)
+        self.register_verdict_callback('verify_tx_then_fill', self._verify_tx_then_fill)
+        self.register_verdict_callback('print_spi_data', self._print_spi_data)
+        self.register_capture_callback('start_marker_capture', self._start_marker_capture)
+        self.register_verdict_callback('report_marker_latency', self._report_marker_latency)
 
         self.logger.prn_inf("SPI Basic Test host test setup complete.")
 
     def teardown(self):
-        self.recorder.teardown()
\ No newline at end of file
+        self.recorder.teardown()
+        self.marker_recorder.teardown()
\ No newline at end of file
@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2024 Jamie Smith
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mbed.h"
+#include "native_test.h"
+
+#include <fstream>
+
+// Tests loading the per-target latency profiles generated by test_result_evaluator.generate_sim_profiles,
+// and that the simulated Mbed APIs take the profile's latencies into account.
+
+// Where to put the profile file.  Can be overridden by the first command line argument.
+std::string profilePath = "latency_profiles.ini";
+
+// Profile file in the same format as the generator writes
+char const * const PROFILE_FILE_CONTENTS =
+    "# Comment\n"
+    "\n"
+    "[TARGET_A]\n"
+    "gpio_propagation_time_ns = 1500\n"
+    "spi_inter_byte_time_ns = 20000\n"
+    "spi_object_switch_time_ns = 4000\n"
+    "\n"
+    "[TARGET_B]\n"
+    "gpio_propagation_time_ns = 3250\n"
+    "some_future_parameter_ns = 5\n";
+
+/*
+ * A target's parameters must be loaded, without picking up the other targets'
+ */
+void load_profile()
+{
+    native_sim::LatencyProfile const profileA = native_sim::load_latency_profile(profilePath, "TARGET_A");
+    TEST_ASSERT_EQUAL(1500, profileA.gpioPropagationTime.count());
+    TEST_ASSERT_EQUAL(20000, profileA.spiInterByteTime.count());
+    TEST_ASSERT_EQUAL(4000, profileA.spiObjectSwitchTime.count());
+
+    native_sim::LatencyProfile const profileB = native_sim::load_latency_profile(profilePath, "TARGET_B");
+    TEST_ASSERT_EQUAL(3250, profileB.gpioPropagationTime.count());
+    TEST_ASSERT_EQUAL(0, profileB.spiInterByteTime.count());
+}
+
+/*
+ * Loading a target which has no profile must fail rather than silently using the defaults
+ */
+void missing_target_throws()
+{
+    bool threw = false;
+    try {
+        native_sim::load_latency_profile(profilePath, "TARGET_C");
+    }
+    catch(std::runtime_error const &) {
+        threw = true;
+    }
+    TEST_ASSERT_MESSAGE(threw, "Loading a missing target did not throw");
+}
+
+/*
+ * SPI transfers and GPIO writes must take the profile's overhead on top of the bus time
+ */
+void profile_applies_to_simulation()
+{
+    constexpr size_t numBytes = 100;
+    constexpr uint32_t spiFrequency = 1000000;
+
+    native_sim::set_latency_profile(native_sim::load_latency_profile(profilePath, "TARGET_A"));
+
+    SPI spi(0, 1, 2);
+    spi.frequency(spiFrequency);
+    DigitalOut gpio(3);
+
+    Timer spiTimer;
+    spiTimer.start();
+    for(size_t byteIdx = 0; byteIdx < numBytes; ++byteIdx) {
+        spi.write(0xFF);
+    }
+    spiTimer.stop();
+
+    Timer gpioTimer;
+    gpioTimer.start();
+    for(size_t writeIdx = 0; writeIdx < 1000; ++writeIdx) {
+        gpio = writeIdx % 2;
+    }
+    gpioTimer.stop();
+
+    native_sim::set_latency_profile(native_sim::LatencyProfile());
+
+    // 8us per byte on the bus, plus 20us of overhead
+    TEST_ASSERT_EQUAL(numBytes * 28, spiTimer.elapsed_time().count());
+    TEST_ASSERT_EQUAL(1500, gpioTimer.elapsed_time().count());
+}
+
+/*
+ * Switching between SPI objects must take the profile's switch time, but using the same object again must not
+ */
+void spi_object_switch_applies_to_simulation()
+{
+    constexpr size_t numSwitches = 10;
+    constexpr uint32_t spiFrequency = 1000000;
+
+    native_sim::set_latency_profile(native_sim::load_latency_profile(profilePath, "TARGET_A"));
+
+    SPI spiA(0, 1, 2);
+    SPI spiB(0, 1, 2);
+    spiA.frequency(spiFrequency);
+    spiB.frequency(spiFrequency);
+
+    Timer sameObjectTimer;
+    sameObjectTimer.start();
+    for(size_t writeIdx = 0; writeIdx < numSwitches; ++writeIdx) {
+        spiB.write(0xFF);
+    }
+    sameObjectTimer.stop();
+
+    Timer alternatingTimer;
+    alternatingTimer.start();
+    for(size_t writeIdx = 0; writeIdx < numSwitches; ++writeIdx) {
+        (writeIdx % 2 == 0 ? spiA : spiB).write(0xFF);
+    }
+    alternatingTimer.stop();
+
+    native_sim::set_latency_profile(native_sim::LatencyProfile());
+
+    // 8us per byte on the bus and 20us of overhead, plus 4us per switch
+    TEST_ASSERT_EQUAL(numSwitches * 28, sameObjectTimer.elapsed_time().count());
+    TEST_ASSERT_EQUAL(numSwitches * 32, alternatingTimer.elapsed_time().count());
+}
+
+// Test cases
+NativeTestCase cases[] = {
+    {"Latency Profile - Load Target Profile", load_profile},
+    {"Latency Profile - Missing Target Throws", missing_target_throws},
+    {"Latency Profile - Profile Applies to Simulation", profile_applies_to_simulation},
+    {"Latency Profile - SPI Object Switch Time", spi_object_switch_applies_to_simulation},
+};
+
+int main(int argc, char ** argv)
+{
+    if(argc > 1) {
+        profilePath = argv[1];
+    }
+
+    std::ofstream(profilePath) << PROFILE_FILE_CONTENTS;
+
+    return run_native_tests(cases) == 0 ? 0 : 1;
+}
@@ -0,0 +1,616 @@
+/*
+ * Copyright (c) 2024 Jamie Smith
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SDCardEmulator.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// SD commands implemented by the emulator
+enum Command : uint8_t {
+    CMD0_GO_IDLE_STATE = 0,
+    CMD6_SWITCH_FUNC = 6,
+    CMD8_SEND_IF_COND = 8,
+    CMD9_SEND_CSD = 9,
+    CMD12_STOP_TRANSMISSION = 12,
+    CMD13_SEND_STATUS = 13,
+    CMD16_SET_BLOCKLEN = 16,
+    CMD17_READ_SINGLE_BLOCK = 17,
+    CMD18_READ_MULTIPLE_BLOCK = 18,
+    CMD24_WRITE_BLOCK = 24,
+    CMD25_WRITE_MULTIPLE_BLOCK = 25,
+    CMD32_ERASE_WR_BLK_START = 32,
+    CMD33_ERASE_WR_BLK_END = 33,
+    CMD38_ERASE = 38,
+    CMD55_APP_CMD = 55,
+    CMD58_READ_OCR = 58,
+    CMD59_CRC_ON_OFF = 59,
+    ACMD23_SET_WR_BLK_ERASE_COUNT = 23,
+    ACMD41_SD_SEND_OP_COND = 41,
+};
+
+// OCR bits
+constexpr uint32_t OCR_POWER_UP_DONE = 1UL << 31;
+constexpr uint32_t OCR_CCS = 1UL << 30;
+constexpr uint32_t OCR_VOLTAGE_WINDOW = 0x00FF8000; // 2.7-3.6V
+
+// HCS bit in the ACMD41 argument
+constexpr uint32_t ACMD41_HCS = 1UL << 30;
+
+// Mode bit in the CMD6 argument: set to switch, clear to only check
+constexpr uint32_t CMD6_MODE_SWITCH = 1UL << 31;
+
+// Function group 1 (bus speed) functions
+constexpr uint8_t FUNCTION_DEFAULT_SPEED = 0;
+constexpr uint8_t FUNCTION_HIGH_SPEED = 1;
+constexpr uint8_t FUNCTION_NO_CHANGE = 0xF;
+
+// TRAN_SPEED values in the CSD for default speed (25MHz) and high speed (50MHz)
+constexpr uint8_t TRAN_SPEED_DEFAULT = 0x32;
+constexpr uint8_t TRAN_SPEED_HIGH_SPEED = 0x5A;
+
+// Length of the switch function status
+constexpr size_t SWITCH_STATUS_LENGTH = 64;
+
+// SDHC cards are sized in units of 512kiB
+constexpr uint64_t CSD_V2_SIZE_UNIT = 512 * 1024;
+
+[[noreturn]] void throw_errno(std::string const & what)
+{
+    throw std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+}
+
+SDCardEmulator::SDCardEmulator(std::string const & imagePath, uint64_t capacity, SDLatencyModel const & latencyModel):
+_capacity(capacity),
+_latencyModel(latencyModel)
+{
+    if(capacity == 0 || capacity % CSD_V2_SIZE_UNIT != 0) {
+        throw std::runtime_error("SD card capacity must be a nonzero multiple of 512kiB");
+    }
+
+    _imageFd = open(imagePath.c_str(), O_RDWR | O_CREAT, 0644);
+    if(_imageFd < 0) {
+        throw_errno("Failed to open SD card image " + imagePath);
+    }
+
+    struct stat imageStat;
+    if(fstat(_imageFd, &imageStat) != 0) {
+        close(_imageFd);
+        throw_errno("Failed to stat SD card image " + imagePath);
+    }
+    if(static_cast<uint64_t>(imageStat.st_size) < capacity && ftruncate(_imageFd, capacity) != 0) {
+        close(_imageFd);
+        throw_errno("Failed to extend SD card image " + imagePath);
+    }
+
+    void * mapping = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, _imageFd, 0);
+    if(mapping == MAP_FAILED) {
+        close(_imageFd);
+        throw_errno("Failed to map SD card image " + imagePath);
+    }
+    _image = static_cast<uint8_t *>(mapping);
+
+    // Build the CSD (version 2.0).  Only C_SIZE depends on the card.
+    uint32_t const cSize = capacity / CSD_V2_SIZE_UNIT - 1;
+    _registerData = {
+        0x40,                           // CSD_STRUCTURE = 1
+        0x0E,                           // TAAC
+        0x00,                           // NSAC
+        TRAN_SPEED_DEFAULT,             // TRAN_SPEED = 25MHz
+        0x5B, 0x59,                     // CCC (including class 10, switch function), READ_BL_LEN = 9
+        0x00,
+        static_cast<uint8_t>((cSize >> 16) & 0x3F),
+        static_cast<uint8_t>(cSize >> 8),
+        static_cast<uint8_t>(cSize),
+        0x7F, 0x80,                     // ERASE_BLK_EN = 1, SECTOR_SIZE = 0x7F
+        0x0A, 0x40,                     // R2W_FACTOR = 2, WRITE_BL_LEN = 9
+        0x00,
+        0x00
+    };
+    _registerData[15] = static_cast<uint8_t>((crc7(_registerData.data(), 15) << 1) | 1);
+
+    _programmed.resize(capacity / BLOCK_SIZE);
+}
+
+SDCardEmulator::~SDCardEmulator()
+{
+    munmap(_image, _capacity);
+    close(_imageFd);
+}
+
+void SDCardEmulator::power_cycle()
+{
+    _spiMode = false;
+    _idle = true;
+    _crcOn = false;
+    _appCommand = false;
+    _initStarted = false;
+    _state = State::Idle;
+    _multiBlock = false;
+    _eraseStartSet = false;
+    _eraseEndSet = false;
+    _preEraseCount = 0;
+    _response.clear();
+    set_high_speed(false);
+}
+
+void SDCardEmulator::set_selected(bool selected)
+{
+    _selected = selected;
+    if(!selected) {
+        // Anything the card was about to send is lost, but programming carries on
+        _response.clear();
+        if(_state != State::Busy) {
+            _state = State::Idle;
+            _multiBlock = false;
+        }
+    }
+}
+
+uint8_t SDCardEmulator::transfer(uint8_t mosi, uint32_t clockFrequency)
+{
+    if(!_selected) {
+        return 0xFF;
+    }
+    if(clockFrequency > (_highSpeed ? _latencyModel.highSpeedMaxClockFrequency : _latencyModel.maxClockFrequency)) {
+        ++_stats.overclockedBytes;
+        return 0xFF;
+    }
+
+    // Work out what the card drives on MISO during this byte, based on its state before the byte
+    uint8_t miso = 0xFF;
+    if(!_response.empty()) {
+        miso = _response.front();
+        _response.pop_front();
+    }
+    else if(_state == State::Reading) {
+        if(_blockQueued) {
+            // The previous block of a multiple block read has just been sent
+            _blockQueued = false;
+            _readyTime = now() + _latencyModel.multiBlockReadGap;
+        }
+        else if(now() >= _readyTime) {
+            if(_registerBeingRead != nullptr) {
+                queue_data_block(_registerBeingRead->data(), _registerBeingRead->size());
+                _state = State::Idle;
+            }
+            else if(_currentBlock * BLOCK_SIZE >= _capacity) {
+                // Ran off the end of the card.  Real cards set OUT_OF_RANGE in the status.
+                _state = State::Idle;
+            }
+            else {
+                queue_data_block(_image + _currentBlock * BLOCK_SIZE, BLOCK_SIZE);
+                ++_stats.blocksRead;
+                if(_multiBlock) {
+                    ++_currentBlock;
+                    _blockQueued = true;
+                }
+                else {
+                    _state = State::Idle;
+                }
+            }
+
+            if(!_response.empty()) {
+                miso = _response.front();
+                _response.pop_front();
+            }
+        }
+    }
+    else if(_state == State::Busy) {
+        if(now() < _readyTime) {
+            miso = 0x00;
+            ++_stats.busyBytes;
+        }
+        else {
+            _state = _multiBlock ? State::WaitingForToken : State::Idle;
+        }
+    }
+
+    // Now handle what the host sent
+    switch(_state) {
+        case State::Idle:
+        case State::Reading:
+            // Commands can be sent while idle, or to stop a multiple block read.  A new command cancels
+            // anything the card still had to send.
+            if((mosi & 0xC0) == 0x40) {
+                _response.clear();
+                _commandFrame[0] = mosi;
+                _commandBytes = 1;
+                _state = State::ReceivingCommand;
+            }
+            break;
+
+        case State::ReceivingCommand:
+            _commandFrame[_commandBytes++] = mosi;
+            if(_commandBytes == sizeof(_commandFrame)) {
+                _state = State::Idle;
+                execute_command();
+            }
+            break;
+
+        case State::WaitingForToken:
+            if(mosi == (_multiBlock ? TOKEN_START_MULTI_WRITE : TOKEN_START_BLOCK)) {
+                _dataBuffer.clear();
+                _state = State::ReceivingData;
+            }
+            else if(_multiBlock && mosi == TOKEN_STOP_TRAN) {
+                _multiBlock = false;
+                _state = State::Busy;
+                _readyTime = now() + _latencyModel.stopTransmissionBusyTime;
+            }
+            break;
+
+        case State::ReceivingData:
+            _dataBuffer.push_back(mosi);
+            if(_dataBuffer.size() == BLOCK_SIZE + 2) {
+                finish_write_block();
+            }
+            break;
+
+        case State::Busy:
+            break;
+    }
+
+    return miso;
+}
+
+void SDCardEmulator::execute_command()
+{
+    uint8_t const cmd = _commandFrame[0] & 0x3F;
+    uint32_t const arg = (static_cast<uint32_t>(_commandFrame[1]) << 24) | (static_cast<uint32_t>(_commandFrame[2]) << 16) |
+                         (static_cast<uint32_t>(_commandFrame[3]) << 8) | _commandFrame[4];
+    bool const crcValid = crc7(_commandFrame, 5) == (_commandFrame[5] >> 1);
+
+    bool const isAppCommand = _appCommand;
+    _appCommand = false;
+
+    ++_stats.commands;
+
+    // Until it gets a valid CMD0 with CS low, the card is in SD mode and ignores everything
+    if(!_spiMode) {
+        if(cmd != CMD0_GO_IDLE_STATE || !crcValid) {
+            return;
+        }
+        _spiMode = true;
+    }
+
+    if(!crcValid && (_crcOn || cmd == CMD0_GO_IDLE_STATE || cmd == CMD8_SEND_IF_COND)) {
+        ++_stats.crcErrors;
+        respond(r1_state() | R1_COM_CRC_ERROR);
+        return;
+    }
+
+    // Data transfer commands are only accepted once the card has initialized
+    bool const needsReady = !isAppCommand && (cmd == CMD6_SWITCH_FUNC || cmd == CMD9_SEND_CSD || cmd == CMD16_SET_BLOCKLEN ||
+        cmd == CMD17_READ_SINGLE_BLOCK || cmd == CMD18_READ_MULTIPLE_BLOCK ||
+        cmd == CMD24_WRITE_BLOCK || cmd == CMD25_WRITE_MULTIPLE_BLOCK ||
+        cmd == CMD32_ERASE_WR_BLK_START || cmd == CMD33_ERASE_WR_BLK_END || cmd == CMD38_ERASE);
+    if(needsReady && _idle) {
+        respond(R1_IDLE_STATE | R1_ILLEGAL_COMMAND);
+        return;
+    }
+
+    if(isAppCommand) {
+        switch(cmd) {
+            case ACMD41_SD_SEND_OP_COND:
+                if(!_initStarted) {
+                    _initStarted = true;
+                    _initStartTime = now();
+                }
+
+                // This card is high capacity, so it never finishes initializing for a host that doesn't support that
+                if((arg & ACMD41_HCS) && now() - _initStartTime >= _latencyModel.initTime) {
+                    _idle = false;
+                }
+                respond(r1_state());
+                return;
+
+            case ACMD23_SET_WR_BLK_ERASE_COUNT:
+                // Applies to the next multiple block write only
+                _preEraseCount = arg & 0x7FFFFF;
+                respond(r1_state());
+                return;
+
+            default:
+                respond(r1_state() | R1_ILLEGAL_COMMAND);
+                return;
+        }
+    }
+
+    switch(cmd) {
+        case CMD0_GO_IDLE_STATE:
+            _idle = true;
+            _crcOn = false;
+            _initStarted = false;
+            _multiBlock = false;
+            set_high_speed(false);
+            respond(R1_IDLE_STATE);
+            break;
+
+        case CMD6_SWITCH_FUNC:
+            // The status is sent like a register, and in switch mode the new function takes effect right away
+            build_switch_status(arg);
+            respond(r1_state());
+            _registerBeingRead = &_switchStatus;
+            _multiBlock = false;
+            _state = State::Reading;
+            _readyTime = now();
+            break;
+
+        case CMD8_SEND_IF_COND:
+            if(((arg >> 8) & 0xF) != 0x1) {
+                respond(r1_state() | R1_ILLEGAL_COMMAND);
+                break;
+            }
+            respond(r1_state());
+            _response.insert(_response.end(), {0x00, 0x00, 0x01, static_cast<uint8_t>(arg)});
+            break;
+
+        case CMD9_SEND_CSD:
+            respond(r1_state());
+            _registerBeingRead = &_registerData;
+            _multiBlock = false;
+            _state = State::Reading;
+            _readyTime = now();
+            break;
+
+        case CMD12_STOP_TRANSMISSION:
+            // The byte after CMD12 is a stuff byte, which comes before the normal response delay
+            _multiBlock = false;
+            _response.push_back(0xFF);
+            respond(r1_state());
+            break;
+
+        case CMD13_SEND_STATUS:
+            respond(r1_state());
+            _response.push_back(0x00);
+            break;
+
+        case CMD16_SET_BLOCKLEN:
+            // High capacity cards only support 512 byte blocks
+            respond(arg == BLOCK_SIZE ? r1_state() : r1_state() | R1_PARAMETER_ERROR);
+            break;
+
+        case CMD17_READ_SINGLE_BLOCK:
+        case CMD18_READ_MULTIPLE_BLOCK:
+            if(static_cast<uint64_t>(arg) * BLOCK_SIZE >= _capacity) {
+                respond(r1_state() | R1_PARAMETER_ERROR);
+                break;
+            }
+            respond(r1_state());
+            _currentBlock = arg;
+            _registerBeingRead = nullptr;
+            _multiBlock = cmd == CMD18_READ_MULTIPLE_BLOCK;
+            _blockQueued = false;
+            _state = State::Reading;
+            _readyTime = now() + _latencyModel.readAccessTime;
+            break;
+
+        case CMD24_WRITE_BLOCK:
+        case CMD25_WRITE_MULTIPLE_BLOCK:
+            if(static_cast<uint64_t>(arg) * BLOCK_SIZE >= _capacity) {
+                respond(r1_state() | R1_PARAMETER_ERROR);
+                break;
+            }
+            respond(r1_state());
+            _currentBlock = arg;
+            _multiBlock = cmd == CMD25_WRITE_MULTIPLE_BLOCK;
+            _state = State::WaitingForToken;
+
+            // Pre-erase the blocks about to be written, if ACMD23 asked for it.  Real cards do this in the background
+            // while the first block is being sent, so it's added to the busy time of the first block.
+            _readyTime = now();
+            if(_multiBlock && _preEraseCount > 0) {
+                _readyTime += erase_blocks(arg, std::min<uint64_t>(_preEraseCount, _capacity / BLOCK_SIZE - arg));
+            }
+            _preEraseCount = 0;
+            break;
+
+        case CMD32_ERASE_WR_BLK_START:
+        case CMD33_ERASE_WR_BLK_END:
+            if(static_cast<uint64_t>(arg) * BLOCK_SIZE >= _capacity) {
+                respond(r1_state() | R1_ADDRESS_ERROR);
+                break;
+            }
+            if(cmd == CMD32_ERASE_WR_BLK_START) {
+                _eraseStart = arg;
+                _eraseStartSet = true;
+                _eraseEndSet = false;
+            }
+            else {
+                _eraseEnd = arg;
+                _eraseEndSet = _eraseStartSet;
+            }
+            respond(_eraseEndSet || cmd == CMD32_ERASE_WR_BLK_START ? r1_state() : r1_state() | R1_ERASE_SEQUENCE_ERROR);
+            break;
+
+        case CMD38_ERASE:
+            if(!_eraseEndSet || _eraseEnd < _eraseStart) {
+                _eraseStartSet = false;
+                _eraseEndSet = false;
+                respond(r1_state() | R1_ERASE_SEQUENCE_ERROR);
+                break;
+            }
+
+            // R1b response: busy until the erase finishes
+            respond(r1_state());
+            _multiBlock = false;
+            _state = State::Busy;
+            _readyTime = now() + erase_blocks(_eraseStart, _eraseEnd - _eraseStart + 1);
+            _eraseStartSet = false;
+            _eraseEndSet = false;
+            break;
+
+        case CMD55_APP_CMD:
+            _appCommand = true;
+            respond(r1_state());
+            break;
+
+        case CMD58_READ_OCR:
+        {
+            uint32_t const ocr = OCR_VOLTAGE_WINDOW | (_idle ? 0 : OCR_POWER_UP_DONE | OCR_CCS);
+            respond(r1_state());
+            _response.insert(_response.end(), {static_cast<uint8_t>(ocr >> 24), static_cast<uint8_t>(ocr >> 16),
+                                               static_cast<uint8_t>(ocr >> 8), static_cast<uint8_t>(ocr)});
+            break;
+        }
+
+        case CMD59_CRC_ON_OFF:
+            _crcOn = arg & 1;
+            respond(r1_state());
+            break;
+
+        default:
+            respond(r1_state() | R1_ILLEGAL_COMMAND);
+            break;
+    }
+}
+
+void SDCardEmulator::respond(uint8_t r1)
+{
+    _response.push_back(0xFF);
+    _response.push_back(r1);
+}
+
+void SDCardEmulator::queue_data_block(uint8_t const * data, size_t length)
+{
+    uint16_t const crc = crc16(data, length);
+    _response.push_back(TOKEN_START_BLOCK);
+    _response.insert(_response.end(), data, data + length);
+    _response.push_back(static_cast<uint8_t>(crc >> 8));
+    _response.push_back(static_cast<uint8_t>(crc));
+}
+
+void SDCardEmulator::finish_write_block()
+{
+    uint16_t const receivedCrc = (static_cast<uint16_t>(_dataBuffer[BLOCK_SIZE]) << 8) | _dataBuffer[BLOCK_SIZE + 1];
+    if(_crcOn && crc16(_dataBuffer.data(), BLOCK_SIZE) != receivedCrc) {
+        // The card rejects the block and, for a multiple block write, waits for the host to stop the transfer
+        ++_stats.crcErrors;
+        _response.push_back(DATA_RESPONSE_CRC_ERROR);
+        _state = _multiBlock ? State::WaitingForToken : State::Idle;
+        return;
+    }
+
+    if(_currentBlock * BLOCK_SIZE >= _capacity) {
+        // Ran off the end of the card.  Report a write error.
+        _response.push_back(0x0D);
+        _state = _multiBlock ? State::WaitingForToken : State::Idle;
+        return;
+    }
+
+    std::memcpy(_image + _currentBlock * BLOCK_SIZE, _dataBuffer.data(), BLOCK_SIZE);
+    ++_stats.blocksWritten;
+
+    std::chrono::microseconds programTime = _multiBlock ? _latencyModel.multiBlockProgramTime : _latencyModel.singleBlockProgramTime;
+    if(_programmed[_currentBlock]) {
+        ++_stats.blocksOverwritten;
+        programTime += _latencyModel.overwritePenalty;
+    }
+    _programmed[_currentBlock] = true;
+    ++_currentBlock;
+
+    // Any pre-erase started by the write command has to finish before the first block can be programmed
+    _response.push_back(DATA_RESPONSE_ACCEPTED);
+    _state = State::Busy;
+    _readyTime = std::max(_readyTime, now()) + programTime;
+}
+
+std::chrono::microseconds SDCardEmulator::erase_blocks(uint64_t firstBlock, uint64_t blockCount)
+{
+    std::memset(_image + firstBlock * BLOCK_SIZE, 0, blockCount * BLOCK_SIZE);
+    std::fill(_programmed.begin() + firstBlock, _programmed.begin() + firstBlock + blockCount, false);
+    _stats.blocksErased += blockCount;
+    return _latencyModel.eraseTime + _latencyModel.eraseTimePerBlock * blockCount;
+}
+
+void SDCardEmulator::set_high_speed(bool highSpeed)
+{
+    _highSpeed = highSpeed;
+    _registerData[3] = highSpeed ? TRAN_SPEED_HIGH_SPEED : TRAN_SPEED_DEFAULT;
+    _registerData[15] = static_cast<uint8_t>((crc7(_registerData.data(), 15) << 1) | 1);
+}
+
+void SDCardEmulator::build_switch_status(uint32_t arg)
+{
+    // Only group 1 (bus speed) is implemented.  The other groups only support their default function,
+    // which is what 0xF (no change) selects.
+    uint8_t const requested = arg & 0xF;
+    uint8_t selected = _highSpeed ? FUNCTION_HIGH_SPEED : FUNCTION_DEFAULT_SPEED;
+    if(requested == FUNCTION_DEFAULT_SPEED || (requested == FUNCTION_HIGH_SPEED && _latencyModel.supportsHighSpeed)) {
+        selected = requested;
+    }
+    else if(requested != FUNCTION_NO_CHANGE) {
+        selected = 0xF; // Means the requested function is not available
+    }
+
+    _switchStatus.assign(SWITCH_STATUS_LENGTH, 0);
+    _switchStatus[1] = 100; // Max current in mA
+
+    // Supported functions of groups 6 to 1, as a bitmask of function numbers.  Function 15 is always set.
+    for(size_t groupIdx = 0; groupIdx < 6; ++groupIdx) {
+        _switchStatus[2 + groupIdx * 2] = 0x80;
+        _switchStatus[3 + groupIdx * 2] = 0x01;
+    }
+    if(_latencyModel.supportsHighSpeed) {
+        _switchStatus[13] |= 0x02;
+    }
+    _switchStatus[16] = selected;
+    _switchStatus[17] = 0x00; // Data structure version 0: no busy status
+
+    if((arg & CMD6_MODE_SWITCH) && selected != 0xF) {
+        set_high_speed(selected == FUNCTION_HIGH_SPEED);
+    }
+}
+
+uint16_t SDCardEmulator::crc16(uint8_t const * data, size_t length)
+{
+    uint16_t crc = 0;
+    for(size_t byteIdx = 0; byteIdx < length; ++byteIdx) {
+        crc ^= static_cast<uint16_t>(data[byteIdx]) << 8;
+        for(int bitIdx = 0; bitIdx < 8; ++bitIdx) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+uint8_t SDCardEmulator::crc7(uint8_t const * data, size_t length)
+{
+    uint8_t crc = 0;
+    for(size_t byteIdx = 0; byteIdx < length; ++byteIdx) {
+        uint8_t byte = data[byteIdx];
+        for(int bitIdx = 0; bitIdx < 8; ++bitIdx) {
+            crc <<= 1;
+            if((byte ^ crc) & 0x80) {
+                crc ^= 0x09;
+            }
+            byte <<= 1;
+        }
+    }
+    return crc & 0x7F;
+}
@@ -0,0 +1,261 @@
+/*
+ * Copyright (c) 2024 Jamie Smith
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef SD_CARD_EMULATOR_H
+#define SD_CARD_EMULATOR_H
+
+#include "native_sim.h"
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+/*
+ * Timing model for an emulated SD card.  The defaults are typical of a class 10 microSDHC card.
+ * Latencies are measured from the end of the command (or data block) to when the card is ready,
+ * so, like on a real card, the host sees them as time spent polling.
+ */
+struct SDLatencyModel {
+    // Time from the first ACMD41 after power up until the card leaves the idle state
+    std::chrono::microseconds initTime = std::chrono::milliseconds(20);
+
+    // Time from a read command to the first data token
+    std::chrono::microseconds readAccessTime = std::chrono::microseconds(300);
+
+    // Time between blocks of a multiple block read
+    std::chrono::microseconds multiBlockReadGap = std::chrono::microseconds(20);
+
+    // Busy time after the data block of a single block write
+    std::chrono::microseconds singleBlockProgramTime = std::chrono::microseconds(1500);
+
+    // Busy time after each data block of a multiple block write
+    std::chrono::microseconds multiBlockProgramTime = std::chrono::microseconds(250);
+
+    // Busy time after the stop token of a multiple block write
+    std::chrono::microseconds stopTransmissionBusyTime = std::chrono::milliseconds(1);
+
+    // Extra busy time when writing a block which has been written before and not erased since, since the card
+    // then has to erase (or move data around) before it can program
+    std::chrono::microseconds overwritePenalty = std::chrono::microseconds(1000);
+
+    // Busy time for an erase (CMD38, or the pre-erase requested by ACMD23), plus the time per block erased
+    std::chrono::microseconds eraseTime = std::chrono::microseconds(1000);
+    std::chrono::microseconds eraseTimePerBlock = std::chrono::microseconds(5);
+
+    // Highest SPI clock rate that the card works at.  Above this, the card does not respond.
+    uint32_t maxClockFrequency = 25000000;
+
+    // Whether the card supports high speed mode (switched to with CMD6), and the highest clock rate in that mode
+    bool supportsHighSpeed = true;
+    uint32_t highSpeedMaxClockFrequency = 50000000;
+};
+
+/*
+ * Emulates an SD card in SPI mode, backed by a memory-mapped image file.
+ *
+ * Implements the commands used by SDBlockDevice and RawSDCard: CMD0, CMD6, CMD8, CMD9, CMD12, CMD13, CMD16, CMD17, CMD18,
+ * CMD24, CMD25, CMD32, CMD33, CMD38, CMD55, CMD58, CMD59, ACMD23, and ACMD41.  The card is always high capacity (SDHC/SDXC).
+ * Command CRCs (and data CRCs on writes) are checked once CRC checking is turned on with CMD59, and CMD0
+ * and CMD8 are always checked, as on a real card.
+ */
+class SDCardEmulator : public native_sim::EmulatedSPIDevice {
+public:
+    static constexpr size_t BLOCK_SIZE = 512;
+
+    // Counters for what the emulated card has done
+    struct Stats {
+        size_t commands = 0;
+        size_t crcErrors = 0;
+        size_t blocksRead = 0;
+        size_t blocksWritten = 0;
+        size_t blocksErased = 0;     // By CMD38, or by ACMD23 before a multiple block write
+        size_t blocksOverwritten = 0; // Blocks written which had not been erased since they were last written
+        size_t busyBytes = 0;        // Bytes clocked while the card was programming
+        size_t overclockedBytes = 0; // Bytes ignored because the clock was faster than the card supports
+    };
+
+    /*
+     * Create an emulated card backed by the image at imagePath.  If the image does not exist, it is created,
+     * and if it is smaller than capacity, it is extended.
+     * Throws std::runtime_error if the image cannot be mapped.
+     */
+    SDCardEmulator(std::string const & imagePath, uint64_t capacity, SDLatencyModel const & latencyModel = SDLatencyModel());
+
+    ~SDCardEmulator() override;
+
+    SDCardEmulator(SDCardEmulator const &) = delete;
+    SDCardEmulator & operator=(SDCardEmulator const &) = delete;
+
+    /*
+     * Simulate removing and restoring power to the card
+     */
+    void power_cycle();
+
+    /*
+     * Access the card's contents directly
+     */
+    uint8_t * image()
+    {
+        return _image;
+    }
+
+    uint64_t capacity() const
+    {
+        return _capacity;
+    }
+
+    Stats const & stats() const
+    {
+        return _stats;
+    }
+
+    /*
+     * Whether the card has been switched to high speed mode
+     */
+    bool is_high_speed() const
+    {
+        return _highSpeed;
+    }
+
+    SDLatencyModel & latency_model()
+    {
+        return _latencyModel;
+    }
+
+    void set_selected(bool selected) override;
+
+    uint8_t transfer(uint8_t mosi, uint32_t clockFrequency) override;
+
+    /*
+     * Calculate the CRC16 used for SD data blocks
+     */
+    static uint16_t crc16(uint8_t const * data, size_t length);
+
+    /*
+     * Calculate the CRC7 used for SD command frames
+     */
+    static uint8_t crc7(uint8_t const * data, size_t length);
+
+private:
+    // R1 response bits
+    static constexpr uint8_t R1_IDLE_STATE = 0x01;
+    static constexpr uint8_t R1_ILLEGAL_COMMAND = 0x04;
+    static constexpr uint8_t R1_COM_CRC_ERROR = 0x08;
+    static constexpr uint8_t R1_ERASE_SEQUENCE_ERROR = 0x10;
+    static constexpr uint8_t R1_ADDRESS_ERROR = 0x20;
+    static constexpr uint8_t R1_PARAMETER_ERROR = 0x40;
+
+    // Data tokens
+    static constexpr uint8_t TOKEN_START_BLOCK = 0xFE;
+    static constexpr uint8_t TOKEN_START_MULTI_WRITE = 0xFC;
+    static constexpr uint8_t TOKEN_STOP_TRAN = 0xFD;
+
+    // Data response tokens
+    static constexpr uint8_t DATA_RESPONSE_ACCEPTED = 0x05;
+    static constexpr uint8_t DATA_RESPONSE_CRC_ERROR = 0x0B;
+
+    enum class State {
+        Idle,             // Waiting for a command
+        ReceivingCommand, // Receiving the rest of a command frame
+        Reading,          // Sending data for a read command
+        WaitingForToken,  // Waiting for the data token of a write
+        ReceivingData,    // Receiving the data block of a write
+        Busy              // Programming
+    };
+
+    void execute_command();
+
+    /*
+     * Queue an R1 response, preceded by the one byte response delay (N_CR)
+     */
+    void respond(uint8_t r1);
+
+    /*
+     * Queue a data block: the start token, the data, and its CRC
+     */
+    void queue_data_block(uint8_t const * data, size_t length);
+
+    void finish_write_block();
+
+    /*
+     * Erase blocks, filling them with zeros, and return how long the card is busy for
+     */
+    std::chrono::microseconds erase_blocks(uint64_t firstBlock, uint64_t blockCount);
+
+    /*
+     * Switch in or out of high speed mode, and update TRAN_SPEED in the CSD to match
+     */
+    void set_high_speed(bool highSpeed);
+
+    /*
+     * Build the switch function status for a CMD6 with the given argument
+     */
+    void build_switch_status(uint32_t arg);
+
+    std::chrono::nanoseconds now() const
+    {
+        return native_sim::SimulatedClock::now();
+    }
+
+    uint8_t r1_state() const
+    {
+        return _idle ? R1_IDLE_STATE : 0;
+    }
+
+    uint64_t _capacity;
+    SDLatencyModel _latencyModel;
+    int _imageFd = -1;
+    uint8_t * _image = nullptr;
+
+    Stats _stats;
+
+    bool _selected = false;
+    bool _spiMode = false;
+    bool _idle = true;
+    bool _crcOn = false;
+    bool _appCommand = false;
+    bool _initStarted = false;
+    bool _highSpeed = false;
+    std::chrono::nanoseconds _initStartTime{};
+
+    State _state = State::Idle;
+    std::deque<uint8_t> _response;
+    uint8_t _commandFrame[6] = {};
+    size_t _commandBytes = 0;
+
+    // Current read or write operation
+    bool _multiBlock = false;
+    std::vector<uint8_t> const * _registerBeingRead = nullptr; // CSD or switch status, if not reading blocks
+    uint64_t _currentBlock = 0;
+    bool _blockQueued = false;
+    std::chrono::nanoseconds _readyTime{};
+    std::vector<uint8_t> _dataBuffer;
+
+    // Erase state: range set by CMD32 and CMD33, and number of blocks to pre-erase from ACMD23
+    bool _eraseStartSet = false;
+    bool _eraseEndSet = false;
+    uint64_t _eraseStart = 0;
+    uint64_t _eraseEnd = 0;
+    uint32_t _preEraseCount = 0;
+
+    // Which blocks have been written since they were last erased.  A new card starts out fully erased.
+    std::vector<bool> _programmed;
+    std::vector<uint8_t> _registerData;
+    std::vector<uint8_t> _switchStatus;
+};
+
+#endif
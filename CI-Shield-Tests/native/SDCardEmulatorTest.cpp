@@ -0,0 +1,363 @@
+/*
+ * Copyright (c) 2024 Jamie Smith
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mbed.h"
+#include "native_test.h"
+#include "SDCardEmulator.h"
+
+#include "ci_test_bench_sizes.h"
+#include "ci_test_sd_card.h"
+#include "ci_test_sd_benchmarks.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// Runs the raw SD card test cases from SPIMicroSDTest against an emulated card, plus block read/write
+// benchmarks.  All times reported are in simulated time, so they show what the latency model predicts
+// for real hardware.
+
+// Pins in the simulation
+constexpr PinName SD_MOSI = 0;
+constexpr PinName SD_MISO = 1;
+constexpr PinName SD_SCLK = 2;
+constexpr PinName SD_CS = 3;
+
+// Size of the emulated card
+constexpr uint64_t SD_CARD_CAPACITY = 16 * 1024 * 1024;
+
+// Number of blocks moved by each benchmark
+constexpr size_t BENCH_BLOCK_COUNT = BENCH_WORKING_SET_SIZE / RawSDCard::BLOCK_SIZE;
+
+// Where to put the card image.  Can be overridden by the first command line argument.
+std::string sdCardImagePath = "sd_card_image.bin";
+
+SDCardEmulator * sdCard;
+std::unique_ptr<RawSDCard> rawSDCard;
+
+/*
+ * Check that the card works after initialization by reading the first block, which has the MBR signature
+ * written into the image at startup.
+ */
+void assert_raw_card_readable()
+{
+    uint8_t block[RawSDCard::BLOCK_SIZE];
+    TEST_ASSERT_MESSAGE(rawSDCard->read_block(0, block), "Failed to read block 0");
+    TEST_ASSERT_EQUAL_HEX8(0x55, block[510]);
+    TEST_ASSERT_EQUAL_HEX8(0xAA, block[511]);
+}
+
+/*
+ * Fill a buffer with a pattern that differs for each block and each run
+ */
+void fill_pattern(uint8_t * buffer, size_t length, uint8_t seed)
+{
+    for(size_t byteIdx = 0; byteIdx < length; ++byteIdx) {
+        buffer[byteIdx] = static_cast<uint8_t>(byteIdx * 7 + byteIdx / RawSDCard::BLOCK_SIZE + seed);
+    }
+}
+
+template<uint32_t initFreq, uint32_t dataFreq>
+void time_full_init()
+{
+    sdCard->power_cycle();
+
+    RawSDCard::InitPhaseTimes times;
+    TEST_ASSERT_MESSAGE(rawSDCard->full_init(initFreq, dataFreq, times), "Failed to initialize SD card");
+    report_init_phase_times(times);
+
+    TEST_ASSERT_MESSAGE(rawSDCard->is_high_capacity(), "Emulated card should be high capacity");
+    assert_raw_card_readable();
+}
+
+template<uint32_t dataFreq, bool powerCycle>
+void time_fast_reinit()
+{
+    if(powerCycle) {
+        sdCard->power_cycle();
+    }
+
+    size_t const commandsBefore = sdCard->stats().commands;
+
+    RawSDCard::InitPhaseTimes times;
+    TEST_ASSERT_MESSAGE(rawSDCard->fast_reinit(dataFreq, times), "Failed to re-initialize SD card");
+    report_init_phase_times(times);
+
+    // A card which is still powered only needs the status check
+    if(!powerCycle) {
+        TEST_ASSERT_EQUAL(1, sdCard->stats().commands - commandsBefore);
+    }
+
+    assert_raw_card_readable();
+}
+
+/*
+ * With CRC checking on, the card must reject a command with a bad CRC
+ */
+void bad_command_crc_rejected()
+{
+    size_t const crcErrorsBefore = sdCard->stats().crcErrors;
+
+    DigitalOut cs(SD_CS, 1);
+    SPI spi(SD_MOSI, SD_MISO, SD_SCLK);
+    spi.frequency(1000000);
+
+    cs = 0;
+    uint8_t const badFrame[6] = {0x40 | RawSDCard::CMD13_SEND_STATUS, 0, 0, 0, 0, 0x01};
+    for(uint8_t frameByte : badFrame) {
+        spi.write(frameByte);
+    }
+    uint8_t r1 = RawSDCard::R1_NO_RESPONSE;
+    for(size_t byteIdx = 0; byteIdx < 8 && (r1 & 0x80); ++byteIdx) {
+        r1 = spi.write(0xFF);
+    }
+    spi.write(0xFF);
+    cs = 1;
+    spi.write(0xFF);
+
+    TEST_ASSERT_MESSAGE(r1 & 0x08, "Card did not report a CRC error");
+    TEST_ASSERT_EQUAL(crcErrorsBefore + 1, sdCard->stats().crcErrors);
+}
+
+/*
+ * Write and read back one block, and check it ended up in the image
+ */
+void single_block_write_read()
+{
+    constexpr uint32_t blockAddress = 10;
+    uint8_t writeData[RawSDCard::BLOCK_SIZE];
+    uint8_t readData[RawSDCard::BLOCK_SIZE];
+    fill_pattern(writeData, sizeof(writeData), 1);
+
+    TEST_ASSERT_MESSAGE(rawSDCard->write_block(blockAddress, writeData), "Failed to write block");
+    TEST_ASSERT_MESSAGE(rawSDCard->read_block(blockAddress, readData), "Failed to read block");
+    TEST_ASSERT_MESSAGE(memcmp(writeData, readData, sizeof(writeData)) == 0, "Data read does not match data written");
+    TEST_ASSERT_MESSAGE(memcmp(writeData, sdCard->image() + blockAddress * RawSDCard::BLOCK_SIZE, sizeof(writeData)) == 0,
+                        "Data written is not in the card image");
+}
+
+/*
+ * Time writing then reading a working set of blocks with multiple block commands, and check the data
+ */
+template<uint32_t dataFreq>
+void benchmark_multi_block_write_read()
+{
+    constexpr uint32_t blockAddress = 100;
+
+    RawSDCard::InitPhaseTimes times;
+    TEST_ASSERT_MESSAGE(rawSDCard->fast_reinit(dataFreq, times), "Failed to re-initialize SD card");
+
+    std::vector<uint8_t> writeData(BENCH_WORKING_SET_SIZE);
+    std::vector<uint8_t> readData(BENCH_WORKING_SET_SIZE);
+    fill_pattern(writeData.data(), writeData.size(), static_cast<uint8_t>(dataFreq / 1000));
+
+    Timer writeTimer;
+    writeTimer.start();
+    TEST_ASSERT_MESSAGE(rawSDCard->write_blocks(blockAddress, writeData.data(), BENCH_BLOCK_COUNT), "Failed to write blocks");
+    writeTimer.stop();
+
+    Timer readTimer;
+    readTimer.start();
+    TEST_ASSERT_MESSAGE(rawSDCard->read_blocks(blockAddress, readData.data(), BENCH_BLOCK_COUNT), "Failed to read blocks");
+    readTimer.stop();
+
+    TEST_ASSERT_MESSAGE(writeData == readData, "Data read does not match data written");
+
+    auto const writeTime = writeTimer.elapsed_time();
+    auto const readTime = readTimer.elapsed_time();
+    printf("Wrote %zu bytes in %" PRIi64 "us and read them back in %" PRIi64 "us (simulated)\n",
+           static_cast<size_t>(BENCH_WORKING_SET_SIZE), static_cast<int64_t>(writeTime.count()), static_cast<int64_t>(readTime.count()));
+    report_metric("Multi block write throughput", BENCH_WORKING_SET_SIZE / (writeTime.count() / 1e6), "B/s");
+    report_metric("Multi block read throughput", BENCH_WORKING_SET_SIZE / (readTime.count() / 1e6), "B/s");
+}
+
+/*
+ * Time sustained writing over a region of the card which has already been filled (see benchmark_overwrite_region()),
+ * and check how many blocks the card had to overwrite.
+ */
+template<OverwriteMode mode>
+void benchmark_sustained_overwrite()
+{
+    RawSDCard::InitPhaseTimes times;
+    TEST_ASSERT_MESSAGE(rawSDCard->fast_reinit(RawSDCard::MAX_DEFAULT_SPEED_FREQUENCY, times), "Failed to re-initialize SD card");
+
+    // Fill the region first
+    std::vector<uint8_t> writeData(BENCH_WORKING_SET_SIZE);
+    fill_pattern(writeData.data(), writeData.size(), 3);
+    fill_overwrite_region(*rawSDCard, writeData.data());
+
+    size_t const overwrittenBefore = sdCard->stats().blocksOverwritten;
+    fill_pattern(writeData.data(), writeData.size(), 4);
+    benchmark_overwrite_region(*rawSDCard, mode, writeData);
+
+    // Only plain overwriting should make the card deal with old data
+    size_t const blocksOverwritten = sdCard->stats().blocksOverwritten - overwrittenBefore;
+    TEST_ASSERT_EQUAL(mode == OverwriteMode::Overwrite ? OVERWRITE_REGION_CHUNKS * OVERWRITE_CHUNK_BLOCKS : 0, blocksOverwritten);
+}
+
+/*
+ * Erasing blocks must clear them, and leave the blocks around them alone
+ */
+void erase_clears_blocks()
+{
+    constexpr uint32_t blockAddress = 20;
+    std::vector<uint8_t> writeData(3 * RawSDCard::BLOCK_SIZE);
+    fill_pattern(writeData.data(), writeData.size(), 5);
+
+    RawSDCard::InitPhaseTimes times;
+    TEST_ASSERT_MESSAGE(rawSDCard->fast_reinit(1000000, times), "Failed to re-initialize SD card");
+    TEST_ASSERT_MESSAGE(rawSDCard->write_blocks(blockAddress, writeData.data(), 3), "Failed to write blocks");
+    TEST_ASSERT_MESSAGE(rawSDCard->erase_blocks(blockAddress + 1, 1), "Failed to erase block");
+
+    std::vector<uint8_t> readData(3 * RawSDCard::BLOCK_SIZE);
+    TEST_ASSERT_MESSAGE(rawSDCard->read_blocks(blockAddress, readData.data(), 3), "Failed to read blocks");
+    TEST_ASSERT_MESSAGE(memcmp(writeData.data(), readData.data(), RawSDCard::BLOCK_SIZE) == 0, "Block before the erase was changed");
+    TEST_ASSERT_MESSAGE(std::all_of(readData.begin() + RawSDCard::BLOCK_SIZE, readData.begin() + 2 * RawSDCard::BLOCK_SIZE,
+                                    [](uint8_t byte) { return byte == 0; }), "Erased block was not cleared");
+    TEST_ASSERT_MESSAGE(memcmp(writeData.data() + 2 * RawSDCard::BLOCK_SIZE, readData.data() + 2 * RawSDCard::BLOCK_SIZE, RawSDCard::BLOCK_SIZE) == 0,
+                        "Block after the erase was changed");
+}
+
+/*
+ * Above 25MHz, full init must switch the card to high speed mode, and the card must work at the higher clock
+ */
+void full_init_switches_to_high_speed()
+{
+    sdCard->power_cycle();
+
+    RawSDCard::InitPhaseTimes times;
+    TEST_ASSERT_MESSAGE(rawSDCard->full_init(400000, RawSDCard::MAX_HIGH_SPEED_FREQUENCY, times), "Failed to initialize SD card");
+    report_init_phase_times(times);
+
+    TEST_ASSERT_MESSAGE(rawSDCard->is_high_speed(), "Card was not switched to high speed mode");
+    TEST_ASSERT_MESSAGE(sdCard->is_high_speed(), "Emulated card is not in high speed mode");
+    TEST_ASSERT_EQUAL(RawSDCard::MAX_HIGH_SPEED_FREQUENCY, rawSDCard->data_frequency());
+    assert_raw_card_readable();
+}
+
+/*
+ * A card without high speed mode must be left at 25MHz rather than overclocked
+ */
+void no_high_speed_limits_clock()
+{
+    sdCard->latency_model().supportsHighSpeed = false;
+    sdCard->power_cycle();
+
+    RawSDCard::InitPhaseTimes times;
+    bool const initOK = rawSDCard->full_init(400000, RawSDCard::MAX_HIGH_SPEED_FREQUENCY, times);
+    sdCard->latency_model().supportsHighSpeed = true;
+
+    TEST_ASSERT_MESSAGE(initOK, "Failed to initialize SD card");
+    TEST_ASSERT_FALSE(rawSDCard->is_high_speed());
+    TEST_ASSERT_EQUAL(RawSDCard::MAX_DEFAULT_SPEED_FREQUENCY, rawSDCard->data_frequency());
+    assert_raw_card_readable();
+}
+
+/*
+ * The card must not work if clocked faster than it supports.  RawSDCard never clocks a card above what its speed
+ * mode allows, so this slows down the emulated card instead.
+ */
+void overclocked_card_fails()
+{
+    uint32_t const originalMaxFrequency = sdCard->latency_model().maxClockFrequency;
+    sdCard->latency_model().maxClockFrequency = RawSDCard::MAX_DEFAULT_SPEED_FREQUENCY / 2;
+
+    RawSDCard::InitPhaseTimes times;
+    bool const worked = rawSDCard->fast_reinit(RawSDCard::MAX_DEFAULT_SPEED_FREQUENCY, times) &&
+        rawSDCard->read_block(0, std::vector<uint8_t>(RawSDCard::BLOCK_SIZE).data());
+    sdCard->latency_model().maxClockFrequency = originalMaxFrequency;
+
+    TEST_ASSERT_FALSE(worked);
+    TEST_ASSERT(sdCard->stats().overclockedBytes > 0);
+}
+
+/*
+ * Data written to the card must end up in the image file
+ */
+void image_file_has_written_data()
+{
+    constexpr uint32_t blockAddress = 11;
+    uint8_t writeData[RawSDCard::BLOCK_SIZE];
+    fill_pattern(writeData, sizeof(writeData), 2);
+
+    RawSDCard::InitPhaseTimes times;
+    TEST_ASSERT_MESSAGE(rawSDCard->fast_reinit(1000000, times), "Failed to re-initialize SD card");
+    TEST_ASSERT_MESSAGE(rawSDCard->write_block(blockAddress, writeData), "Failed to write block");
+
+    int imageFd = open(sdCardImagePath.c_str(), O_RDONLY);
+    TEST_ASSERT_MESSAGE(imageFd >= 0, "Failed to open image file");
+    uint8_t fileData[RawSDCard::BLOCK_SIZE];
+    ssize_t const bytesRead = pread(imageFd, fileData, sizeof(fileData), blockAddress * RawSDCard::BLOCK_SIZE);
+    close(imageFd);
+
+    TEST_ASSERT_EQUAL(static_cast<ssize_t>(sizeof(fileData)), bytesRead);
+    TEST_ASSERT_MESSAGE(memcmp(writeData, fileData, sizeof(writeData)) == 0, "Image file does not contain the data written");
+}
+
+// Test cases
+NativeTestCase cases[] = {
+    {"SD Init Timing - Full Init (100kHz, then 1MHz)", time_full_init<100000, 1000000>},
+    {"SD Init Timing - Fast Re-init after Power Cycle (1MHz)", time_fast_reinit<1000000, true>},
+    {"SD Init Timing - Fast Re-init of Powered Card (1MHz)", time_fast_reinit<1000000, false>},
+    {"SD Emulator - Bad Command CRC Rejected", bad_command_crc_rejected},
+    {"SD Emulator - Single Block Write and Read", single_block_write_read},
+    {"SD Benchmark - Multi Block Write and Read (1MHz)", benchmark_multi_block_write_read<1000000>},
+    {"SD Benchmark - Multi Block Write and Read (25MHz)", benchmark_multi_block_write_read<25000000>},
+    {"SD High Speed - Full Init Switches to High Speed (50MHz)", full_init_switches_to_high_speed},
+    {"SD Benchmark - Multi Block Write and Read (50MHz)", benchmark_multi_block_write_read<50000000>},
+    {"SD High Speed - Card Without High Speed Limited to 25MHz", no_high_speed_limits_clock},
+    {"SD Emulator - Overclocked Card Fails", overclocked_card_fails},
+    {"SD Emulator - Image File Has Written Data", image_file_has_written_data},
+    {"SD Emulator - Erase Clears Blocks", erase_clears_blocks},
+    {"SD Benchmark - Sustained Overwrite of Filled Region (25MHz)", benchmark_sustained_overwrite<OverwriteMode::Overwrite>},
+    {"SD Benchmark - Sustained Overwrite with ACMD23 Pre-Erase (25MHz)", benchmark_sustained_overwrite<OverwriteMode::PreErase>},
+    {"SD Benchmark - Sustained Overwrite after Erase (25MHz)", benchmark_sustained_overwrite<OverwriteMode::EraseFirst>},
+};
+
+int main(int argc, char ** argv)
+{
+    if(argc > 1) {
+        sdCardImagePath = argv[1];
+    }
+
+    // Start from a fresh image, with the MBR signature that the readability check looks for
+    unlink(sdCardImagePath.c_str());
+    SDCardEmulator emulatedCard(sdCardImagePath, SD_CARD_CAPACITY);
+    emulatedCard.image()[510] = 0x55;
+    emulatedCard.image()[511] = 0xAA;
+
+    // Optionally simulate a specific target's HAL overhead
+    std::string const profileTarget = native_sim::use_latency_profile_from_environment();
+    if(!profileTarget.empty()) {
+        printf("Using the latency profile of %s\n", profileTarget.c_str());
+    }
+
+    sdCard = &emulatedCard;
+    native_sim::SPIBus::attach(SD_CS, sdCard);
+
+    // CRC checking is on, like the device tests (sd.CRC_ENABLED in mbed_app.json5)
+    rawSDCard = std::make_unique<RawSDCard>(SD_MOSI, SD_MISO, SD_SCLK, SD_CS, true);
+
+    int const failures = run_native_tests(cases);
+
+    rawSDCard.reset();
+    native_sim::SPIBus::detach(SD_CS);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) 2024 Jamie Smith
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef SPI_TRANSACTION_QUEUE_H
+#define SPI_TRANSACTION_QUEUE_H
+
+#include "mbed.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// Native build of the async transaction queue logic from Mbed's drivers/SPI.cpp (transfer(), queue_transfer(),
+// dequeue_transaction(), irq_handler_asynch(), abort_transfer(), and abort_all_transfers()), running against a stub HAL.
+// The logic is kept the same as the driver's, so that changes to the queue can be benchmarked here first.
+
+// Event flags, as in hal/spi_api.h
+constexpr int SPI_EVENT_ERROR = 1 << 1;
+constexpr int SPI_EVENT_COMPLETE = 1 << 2;
+constexpr int SPI_EVENT_RX_OVERFLOW = 1 << 3;
+constexpr int SPI_EVENT_ALL = SPI_EVENT_ERROR | SPI_EVENT_COMPLETE | SPI_EVENT_RX_OVERFLOW;
+constexpr int SPI_EVENT_INTERNAL_TRANSFER_COMPLETE = 1 << 30;
+
+/*
+ * Stub of the async parts of the SPI HAL.  A transfer stays active until the test "finishes" it by calling
+ * the driver's IRQ handler.
+ */
+struct StubSPIHAL {
+    bool active = false;
+    void const * txBuffer = nullptr;
+    size_t txLength = 0;
+    size_t transfersStarted = 0;
+    size_t transfersAborted = 0;
+
+    void spi_master_transfer(void const * tx, size_t tx_length, void * /*rx*/, size_t /*rx_length*/)
+    {
+        active = true;
+        txBuffer = tx;
+        txLength = tx_length;
+        ++transfersStarted;
+    }
+
+    uint32_t spi_irq_handler_asynch()
+    {
+        active = false;
+        return SPI_EVENT_COMPLETE | SPI_EVENT_INTERNAL_TRANSFER_COMPLETE;
+    }
+
+    void spi_abort_asynch()
+    {
+        active = false;
+        ++transfersAborted;
+    }
+
+    bool spi_active() const
+    {
+        return active;
+    }
+};
+
+/*
+ * Completion callback.  Like mbed::Callback, it's a function and a context pointer, so it never allocates.
+ */
+struct SPIEventCallback {
+    void (*function)(void * context, int event) = nullptr;
+    void * context = nullptr;
+
+    void call(int event) const
+    {
+        function(context, event);
+    }
+
+    explicit operator bool() const
+    {
+        return function != nullptr;
+    }
+};
+
+/*
+ * One queued transaction, as in drivers/Transaction.h and hal/dma_api.h's transaction_t.
+ */
+struct SPITransaction {
+    void const * tx_buffer = nullptr;
+    size_t tx_length = 0;
+    void * rx_buffer = nullptr;
+    size_t rx_length = 0;
+    uint32_t event = 0;
+    SPIEventCallback callback;
+
+    // Number of SPITransaction copies ever made.  The queue copies transactions by value, so this is used
+    // to check that each queue operation does a constant amount of work, whatever the queue length.
+    static inline size_t copies = 0;
+
+    SPITransaction() = default;
+
+    SPITransaction(SPITransaction const & other)
+    {
+        *this = other;
+    }
+
+    SPITransaction & operator=(SPITransaction const & other)
+    {
+        tx_buffer = other.tx_buffer;
+        tx_length = other.tx_length;
+        rx_buffer = other.rx_buffer;
+        rx_length = other.rx_length;
+        event = other.event;
+        callback = other.callback;
+        ++copies;
+        return *this;
+    }
+};
+
+/*
+ * The driver's async transfer logic, with a queue of QueueLength transactions
+ * (drivers.spi_transaction_queue_len in the device build).
+ * Critical sections are left out, since the native tests call everything from one thread.
+ */
+template<uint32_t QueueLength>
+class QueuedSPI {
+public:
+    StubSPIHAL hal;
+
+    /*
+     * Start a transfer, or queue it if a transfer is in progress.  Returns 0 on success, or -1 if the queue is full.
+     */
+    int transfer(void const * tx_buffer, size_t tx_length, void * rx_buffer, size_t rx_length,
+                 SPIEventCallback const & callback, int event = SPI_EVENT_COMPLETE)
+    {
+        if(hal.spi_active()) {
+            return queue_transfer(tx_buffer, tx_length, rx_buffer, rx_length, callback, event);
+        }
+        start_transfer(tx_buffer, tx_length, rx_buffer, rx_length, callback, event);
+        return 0;
+    }
+
+    /*
+     * Abort the current transfer, then start the next queued one, if there is one.
+     */
+    void abort_transfer()
+    {
+        hal.spi_abort_asynch();
+        dequeue_transaction();
+    }
+
+    /*
+     * Abort the current transfer, and drop all queued ones.
+     */
+    void abort_all_transfers()
+    {
+        _transactionBuffer.reset();
+        abort_transfer();
+    }
+
+    /*
+     * Called from the SPI IRQ when the current transfer finishes.  Calls its callback, and starts the next
+     * queued transfer, if there is one.
+     */
+    void irq_handler_asynch()
+    {
+        uint32_t const event = hal.spi_irq_handler_asynch();
+        if(_callback && (event & SPI_EVENT_ALL)) {
+            _callback.call(event & SPI_EVENT_ALL);
+        }
+        if(event & (SPI_EVENT_ALL | SPI_EVENT_INTERNAL_TRANSFER_COMPLETE)) {
+            // SPI peripheral is free (event happened), dequeue transaction
+            dequeue_transaction();
+        }
+    }
+
+    size_t queued_transactions() const
+    {
+        return _transactionBuffer.size();
+    }
+
+private:
+    int queue_transfer(void const * tx_buffer, size_t tx_length, void * rx_buffer, size_t rx_length,
+                       SPIEventCallback const & callback, int event)
+    {
+        SPITransaction transaction;
+        transaction.tx_buffer = tx_buffer;
+        transaction.tx_length = tx_length;
+        transaction.rx_buffer = rx_buffer;
+        transaction.rx_length = rx_length;
+        transaction.event = event;
+        transaction.callback = callback;
+
+        if(_transactionBuffer.full()) {
+            return -1;
+        }
+        _transactionBuffer.push(transaction);
+        if(!hal.spi_active()) {
+            dequeue_transaction();
+        }
+        return 0;
+    }
+
+    void start_transfer(void const * tx_buffer, size_t tx_length, void * rx_buffer, size_t rx_length,
+                        SPIEventCallback const & callback, int /*event*/)
+    {
+        _callback = callback;
+        hal.spi_master_transfer(tx_buffer, tx_length, rx_buffer, rx_length);
+    }
+
+    void dequeue_transaction()
+    {
+        SPITransaction transaction;
+        if(_transactionBuffer.pop(transaction)) {
+            start_transfer(transaction.tx_buffer, transaction.tx_length, transaction.rx_buffer, transaction.rx_length,
+                           transaction.callback, transaction.event);
+        }
+    }
+
+    SPIEventCallback _callback;
+    CircularBuffer<SPITransaction, QueueLength> _transactionBuffer;
+};
+
+#endif
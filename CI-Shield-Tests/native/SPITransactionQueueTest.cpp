@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2024 Jamie Smith
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mbed.h"
+#include "native_test.h"
+#include "SPITransactionQueue.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Tests and benchmarks of the SPI driver's async transaction queue logic.  Unlike the other native tests, the
+// benchmarks measure CPU time, so they use the host's clock.  The results show how the costs scale with the
+// queue length, rather than what they would be on an MCU.
+
+// Number of times each operation is repeated in the benchmarks
+constexpr size_t BENCH_ROUNDS = 20000;
+
+uint8_t const txData[4] = {0x01, 0x02, 0x03, 0x04};
+
+// Records the order that callbacks are called in
+struct CallbackLog {
+    std::vector<int> ids;
+    std::vector<int> events;
+};
+
+struct CallbackContext {
+    CallbackLog * log;
+    int id;
+};
+
+void log_callback(void * context, int event)
+{
+    auto * callbackContext = static_cast<CallbackContext *>(context);
+    callbackContext->log->ids.push_back(callbackContext->id);
+    callbackContext->log->events.push_back(event);
+}
+
+void count_callback(void * context, int /*event*/)
+{
+    ++*static_cast<size_t *>(context);
+}
+
+void transfers_complete_in_order()
+{
+    QueuedSPI<4> spi;
+    CallbackLog log;
+    CallbackContext contexts[4] = {{&log, 0}, {&log, 1}, {&log, 2}, {&log, 3}};
+
+    for(size_t transferIdx = 0; transferIdx < 4; ++transferIdx) {
+        TEST_ASSERT_EQUAL(0, spi.transfer(&txData[transferIdx], 1, nullptr, 0, {log_callback, &contexts[transferIdx]}));
+    }
+
+    // First transfer starts right away, and the rest are queued
+    TEST_ASSERT_EQUAL(1, spi.hal.transfersStarted);
+    TEST_ASSERT_EQUAL(3, spi.queued_transactions());
+
+    for(size_t transferIdx = 0; transferIdx < 4; ++transferIdx) {
+        TEST_ASSERT_MESSAGE(spi.hal.active, "Next transfer was not started");
+        TEST_ASSERT_MESSAGE(spi.hal.txBuffer == &txData[transferIdx], "Transfers started out of order");
+        spi.irq_handler_asynch();
+    }
+
+    TEST_ASSERT_FALSE(spi.hal.active);
+    TEST_ASSERT_EQUAL(4, log.ids.size());
+    for(size_t transferIdx = 0; transferIdx < 4; ++transferIdx) {
+        TEST_ASSERT_EQUAL(static_cast<int>(transferIdx), log.ids[transferIdx]);
+        TEST_ASSERT_EQUAL(SPI_EVENT_COMPLETE, log.events[transferIdx]);
+    }
+}
+
+void full_queue_rejects_transfer()
+{
+    QueuedSPI<2> spi;
+    size_t callbacks = 0;
+
+    // One active and two queued
+    for(size_t transferIdx = 0; transferIdx < 3; ++transferIdx) {
+        TEST_ASSERT_EQUAL(0, spi.transfer(txData, sizeof(txData), nullptr, 0, {count_callback, &callbacks}));
+    }
+    TEST_ASSERT_EQUAL(-1, spi.transfer(txData, sizeof(txData), nullptr, 0, {count_callback, &callbacks}));
+
+    // Once one finishes, there's room again
+    spi.irq_handler_asynch();
+    TEST_ASSERT_EQUAL(0, spi.transfer(txData, sizeof(txData), nullptr, 0, {count_callback, &callbacks}));
+    TEST_ASSERT_EQUAL(1, callbacks);
+}
+
+// Same sequence as async_queue_and_abort in SPIBasicTest: aborting the active transfer starts the queued one,
+// which then completes normally
+void abort_starts_queued_transfer()
+{
+    QueuedSPI<2> spi;
+    CallbackLog log;
+    CallbackContext contexts[2] = {{&log, 1}, {&log, 2}};
+
+    TEST_ASSERT_EQUAL(0, spi.transfer(txData, sizeof(txData), nullptr, 0, {log_callback, &contexts[0]}, SPI_EVENT_ALL));
+    TEST_ASSERT_EQUAL(0, spi.transfer(txData, sizeof(txData), nullptr, 0, {log_callback, &contexts[1]}, SPI_EVENT_ALL));
+
+    spi.abort_transfer();
+    TEST_ASSERT_EQUAL(1, spi.hal.transfersAborted);
+    TEST_ASSERT_TRUE(spi.hal.active);
+    TEST_ASSERT_EQUAL(2, spi.hal.transfersStarted);
+    TEST_ASSERT_EQUAL(0, spi.queued_transactions());
+
+    // Only the second transfer's callback is called, with a completion event
+    spi.irq_handler_asynch();
+    TEST_ASSERT_FALSE(spi.hal.active);
+    TEST_ASSERT_EQUAL(1, log.ids.size());
+    TEST_ASSERT_EQUAL(2, log.ids[0]);
+    TEST_ASSERT_EQUAL(SPI_EVENT_COMPLETE, log.events[0]);
+}
+
+// Aborting all transfers stops the active one and drops the queued ones
+void abort_all_drops_queued_transfers()
+{
+    QueuedSPI<2> spi;
+    CallbackLog log;
+    CallbackContext contexts[2] = {{&log, 1}, {&log, 2}};
+
+    TEST_ASSERT_EQUAL(0, spi.transfer(txData, sizeof(txData), nullptr, 0, {log_callback, &contexts[0]}, SPI_EVENT_ALL));
+    TEST_ASSERT_EQUAL(0, spi.transfer(txData, sizeof(txData), nullptr, 0, {log_callback, &contexts[1]}, SPI_EVENT_ALL));
+
+    spi.abort_all_transfers();
+    TEST_ASSERT_FALSE(spi.hal.active);
+    TEST_ASSERT_EQUAL(1, spi.hal.transfersAborted);
+    TEST_ASSERT_EQUAL(0, spi.queued_transactions());
+
+    // A new transfer starts right away, and only its callback is called
+    TEST_ASSERT_EQUAL(0, spi.transfer(txData, sizeof(txData), nullptr, 0, {log_callback, &contexts[1]}, SPI_EVENT_ALL));
+    spi.irq_handler_asynch();
+    TEST_ASSERT_EQUAL(1, log.ids.size());
+    TEST_ASSERT_EQUAL(2, log.ids[0]);
+    TEST_ASSERT_EQUAL(2, spi.hal.transfersStarted);
+}
+
+/*
+ * Check that enqueueing, dispatching from the IRQ, and aborting copy the same number of transactions whatever
+ * the queue length, i.e. that they don't do work proportional to the number of queued transactions.
+ */
+template<uint32_t QueueLength>
+void check_constant_work()
+{
+    QueuedSPI<QueueLength> spi;
+    size_t callbacks = 0;
+    spi.transfer(txData, sizeof(txData), nullptr, 0, {count_callback, &callbacks});
+
+    for(size_t transferIdx = 0; transferIdx < QueueLength; ++transferIdx) {
+        size_t const copiesBefore = SPITransaction::copies;
+        TEST_ASSERT_EQUAL(0, spi.transfer(txData, sizeof(txData), nullptr, 0, {count_callback, &callbacks}));
+        TEST_ASSERT_MESSAGE(SPITransaction::copies - copiesBefore == 1,
+                            "Enqueue with " + std::to_string(transferIdx) + " queued made " + std::to_string(SPITransaction::copies - copiesBefore) + " copies");
+    }
+
+    for(size_t transferIdx = 0; transferIdx < QueueLength; ++transferIdx) {
+        size_t const copiesBefore = SPITransaction::copies;
+        spi.irq_handler_asynch();
+        TEST_ASSERT_MESSAGE(SPITransaction::copies - copiesBefore == 1,
+                            "Dispatch with " + std::to_string(QueueLength - transferIdx) + " queued made " + std::to_string(SPITransaction::copies - copiesBefore) + " copies");
+    }
+    spi.irq_handler_asynch();
+
+    for(size_t transferIdx = 0; transferIdx <= QueueLength; ++transferIdx) {
+        spi.transfer(txData, sizeof(txData), nullptr, 0, {count_callback, &callbacks});
+    }
+    size_t const copiesBefore = SPITransaction::copies;
+    spi.abort_all_transfers();
+    TEST_ASSERT_EQUAL(0, SPITransaction::copies - copiesBefore);
+}
+
+void queue_operations_do_constant_work()
+{
+    check_constant_work<1>();
+    check_constant_work<4>();
+    check_constant_work<16>();
+    check_constant_work<64>();
+}
+
+/*
+ * Measure the time to enqueue a transfer, to dispatch the next one from the IRQ handler, and to abort
+ * with a full queue, with the given queue length.
+ */
+template<uint32_t QueueLength>
+void benchmark_queue()
+{
+    using Clock = std::chrono::steady_clock;
+
+    QueuedSPI<QueueLength> spi;
+    size_t callbacks = 0;
+    SPIEventCallback const callback{count_callback, &callbacks};
+
+    Clock::duration enqueueTime{};
+    Clock::duration dispatchTime{};
+    Clock::duration abortTime{};
+    for(size_t round = 0; round < BENCH_ROUNDS; ++round) {
+        // Start one transfer, then fill the queue
+        spi.transfer(txData, sizeof(txData), nullptr, 0, callback);
+        auto const enqueueStart = Clock::now();
+        for(size_t transferIdx = 0; transferIdx < QueueLength; ++transferIdx) {
+            spi.transfer(txData, sizeof(txData), nullptr, 0, callback);
+        }
+        enqueueTime += Clock::now() - enqueueStart;
+
+        // Finish all the queued transfers from the "IRQ"
+        auto const dispatchStart = Clock::now();
+        for(size_t transferIdx = 0; transferIdx < QueueLength; ++transferIdx) {
+            spi.irq_handler_asynch();
+        }
+        dispatchTime += Clock::now() - dispatchStart;
+        spi.irq_handler_asynch();
+
+        // Fill it again and abort
+        for(size_t transferIdx = 0; transferIdx <= QueueLength; ++transferIdx) {
+            spi.transfer(txData, sizeof(txData), nullptr, 0, callback);
+        }
+        auto const abortStart = Clock::now();
+        spi.abort_all_transfers();
+        abortTime += Clock::now() - abortStart;
+    }
+
+    TEST_ASSERT_EQUAL(BENCH_ROUNDS * (QueueLength + 1), callbacks);
+
+    auto const toNanoseconds = [](Clock::duration time) {
+        return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(time).count());
+    };
+    report_metric("Mean enqueue time", toNanoseconds(enqueueTime) / (BENCH_ROUNDS * QueueLength), "ns");
+    report_metric("Mean dispatch from IRQ time", toNanoseconds(dispatchTime) / (BENCH_ROUNDS * QueueLength), "ns");
+    report_metric("Mean abort time with full queue", toNanoseconds(abortTime) / BENCH_ROUNDS, "ns");
+}
+
+NativeTestCase cases[] = {
+    {"SPI Queue - Transfers Complete in Order", transfers_complete_in_order},
+    {"SPI Queue - Full Queue Rejects Transfer", full_queue_rejects_transfer},
+    {"SPI Queue - Abort Starts Queued Transfer", abort_starts_queued_transfer},
+    {"SPI Queue - Abort All Drops Queued Transfers", abort_all_drops_queued_transfers},
+    {"SPI Queue - Operations Do Constant Work", queue_operations_do_constant_work},
+    {"SPI Queue Benchmark - Queue Length 1", benchmark_queue<1>},
+    {"SPI Queue Benchmark - Queue Length 4", benchmark_queue<4>},
+    {"SPI Queue Benchmark - Queue Length 16", benchmark_queue<16>},
+    {"SPI Queue Benchmark - Queue Length 64", benchmark_queue<64>},
+};
+
+int main()
+{
+    return run_native_tests(cases);
+}
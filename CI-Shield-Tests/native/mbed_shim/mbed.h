@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2024 Jamie Smith
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef NATIVE_MBED_SHIM_H
+#define NATIVE_MBED_SHIM_H
+
+// Stand-in for mbed.h when building the shared test code natively.  Only provides the parts of the Mbed API
+// which that code uses, implemented on top of the simulated clock and SPI bus.
+
+#include "native_sim.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+using namespace std::chrono_literals;
+
+namespace mbed {
+
+class Timer {
+public:
+    void start()
+    {
+        if(!_running) {
+            _startTime = native_sim::SimulatedClock::now();
+            _running = true;
+        }
+    }
+
+    void stop()
+    {
+        if(_running) {
+            _accumulated += native_sim::SimulatedClock::now() - _startTime;
+            _running = false;
+        }
+    }
+
+    void reset()
+    {
+        _accumulated = std::chrono::nanoseconds::zero();
+        _startTime = native_sim::SimulatedClock::now();
+    }
+
+    std::chrono::microseconds elapsed_time() const
+    {
+        auto elapsed = _accumulated;
+        if(_running) {
+            elapsed += native_sim::SimulatedClock::now() - _startTime;
+        }
+        return std::chrono::duration_cast<std::chrono::microseconds>(elapsed);
+    }
+
+private:
+    bool _running = false;
+    std::chrono::nanoseconds _startTime{};
+    std::chrono::nanoseconds _accumulated{};
+};
+
+class DigitalOut {
+public:
+    DigitalOut(PinName pin, int value = 0):
+    _pin(pin)
+    {
+        write(value);
+    }
+
+    void write(int value)
+    {
+        _value = value;
+        native_sim::SPIBus::write_pin(_pin, value);
+    }
+
+    int read() const
+    {
+        return _value;
+    }
+
+    DigitalOut & operator=(int value)
+    {
+        write(value);
+        return *this;
+    }
+
+    operator int() const
+    {
+        return read();
+    }
+
+private:
+    PinName _pin;
+    int _value = 0;
+};
+
+/*
+ * Same semantics as Mbed's CircularBuffer: a fixed size ring buffer, where pushing onto a full buffer
+ * overwrites the oldest element.
+ */
+template<typename T, uint32_t BufferSize, typename CounterType = uint32_t>
+class CircularBuffer {
+public:
+    void push(const T & data)
+    {
+        _pool[_head] = data;
+        _head = incrementCounter(_head);
+        if(_full) {
+            _tail = _head;
+        } else if(_head == _tail) {
+            _full = true;
+        }
+    }
+
+    bool pop(T & data)
+    {
+        if(empty()) {
+            return false;
+        }
+        data = _pool[_tail];
+        _tail = incrementCounter(_tail);
+        _full = false;
+        return true;
+    }
+
+    bool empty() const
+    {
+        return _head == _tail && !_full;
+    }
+
+    bool full() const
+    {
+        return _full;
+    }
+
+    void reset()
+    {
+        _head = 0;
+        _tail = 0;
+        _full = false;
+    }
+
+    CounterType size() const
+    {
+        if(_full) {
+            return BufferSize;
+        }
+        return _head >= _tail ? _head - _tail : BufferSize + _head - _tail;
+    }
+
+private:
+    static CounterType incrementCounter(CounterType value)
+    {
+        return ++value == BufferSize ? 0 : value;
+    }
+
+    T _pool[BufferSize];
+    CounterType _head = 0;
+    CounterType _tail = 0;
+    bool _full = false;
+};
+
+class SPI {
+public:
+    SPI(PinName /*mosi*/, PinName /*miso*/, PinName /*sclk*/)
+    {}
+
+    ~SPI()
+    {
+        if(owner() == this) {
+            owner() = nullptr;
+        }
+    }
+
+    void format(int /*bits*/, int /*mode*/ = 0)
+    {
+        acquire();
+    }
+
+    void frequency(int hz = 1000000)
+    {
+        _frequency = hz;
+        acquire();
+    }
+
+    void set_default_write_value(char data)
+    {
+        _defaultWriteValue = static_cast<uint8_t>(data);
+    }
+
+    int write(int value)
+    {
+        acquire();
+        return native_sim::SPIBus::transfer(static_cast<uint8_t>(value), _frequency);
+    }
+
+    int write(const char * tx_buffer, int tx_length, char * rx_buffer, int rx_length)
+    {
+        acquire();
+        int const totalLength = tx_length > rx_length ? tx_length : rx_length;
+        for(int byteIdx = 0; byteIdx < totalLength; ++byteIdx) {
+            uint8_t const txByte = byteIdx < tx_length ? static_cast<uint8_t>(tx_buffer[byteIdx]) : _defaultWriteValue;
+            uint8_t const rxByte = native_sim::SPIBus::transfer(txByte, _frequency);
+            if(byteIdx < rx_length) {
+                rx_buffer[byteIdx] = static_cast<char>(rxByte);
+            }
+        }
+        return totalLength;
+    }
+
+private:
+    // Like the real SPI class, every object on the bus shares one peripheral, and the object which used it
+    // last owns it.  Another object has to reapply its configuration before using the peripheral.
+    static SPI * & owner()
+    {
+        static SPI * currentOwner = nullptr;
+        return currentOwner;
+    }
+
+    void acquire()
+    {
+        if(owner() != this) {
+            native_sim::SimulatedClock::advance(native_sim::latency_profile().spiObjectSwitchTime);
+            owner() = this;
+        }
+    }
+
+    uint32_t _frequency = 1000000;
+    uint8_t _defaultWriteValue = 0xFF;
+};
+
+}
+
+namespace rtos::ThisThread {
+
+inline void sleep_for(std::chrono::milliseconds time)
+{
+    native_sim::SimulatedClock::advance(time);
+}
+
+}
+
+using namespace mbed;
+
+#endif
@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2024 Jamie Smith
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "native_sim.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+
+namespace native_sim {
+
+namespace {
+std::chrono::nanoseconds currentTime{};
+std::chrono::nanoseconds interByteTime{};
+std::map<PinName, EmulatedSPIDevice *> spiDevices;
+LatencyProfile currentProfile;
+
+/*
+ * Remove leading and trailing whitespace
+ */
+std::string trim(std::string const & str)
+{
+    size_t const start = str.find_first_not_of(" \t\r");
+    if(start == std::string::npos) {
+        return "";
+    }
+    return str.substr(start, str.find_last_not_of(" \t\r") - start + 1);
+}
+}
+
+std::chrono::nanoseconds SimulatedClock::now()
+{
+    return currentTime;
+}
+
+void SimulatedClock::advance(std::chrono::nanoseconds time)
+{
+    currentTime += time;
+}
+
+void SPIBus::attach(PinName csPin, EmulatedSPIDevice * device)
+{
+    spiDevices[csPin] = device;
+}
+
+void SPIBus::detach(PinName csPin)
+{
+    spiDevices.erase(csPin);
+}
+
+void SPIBus::set_inter_byte_time(std::chrono::nanoseconds time)
+{
+    interByteTime = time;
+}
+
+uint8_t SPIBus::transfer(uint8_t mosi, uint32_t clockFrequency)
+{
+    uint8_t miso = 0xFF;
+    for(auto & [csPin, device] : spiDevices) {
+        miso &= device->transfer(mosi, clockFrequency);
+    }
+
+    SimulatedClock::advance(std::chrono::nanoseconds(8 * 1000000000ULL / clockFrequency) + interByteTime);
+    return miso;
+}
+
+void SPIBus::write_pin(PinName pin, int value)
+{
+    SimulatedClock::advance(currentProfile.gpioPropagationTime);
+
+    auto deviceIt = spiDevices.find(pin);
+    if(deviceIt != spiDevices.end()) {
+        deviceIt->second->set_selected(value == 0);
+    }
+}
+
+LatencyProfile load_latency_profile(std::string const & path, std::string const & targetName)
+{
+    std::ifstream profileFile(path);
+    if(!profileFile) {
+        throw std::runtime_error("Failed to open latency profile file " + path);
+    }
+
+    // Each target's profile is an INI section of "<parameter>_ns = <value>" lines
+    std::map<std::string, std::chrono::nanoseconds LatencyProfile::*> const parameters = {
+        {"gpio_propagation_time_ns", &LatencyProfile::gpioPropagationTime},
+        {"spi_inter_byte_time_ns", &LatencyProfile::spiInterByteTime},
+        {"spi_object_switch_time_ns", &LatencyProfile::spiObjectSwitchTime},
+    };
+
+    LatencyProfile profile;
+    bool foundTarget = false;
+    bool inTarget = false;
+    std::string line;
+    while(std::getline(profileFile, line)) {
+        line = trim(line);
+        if(line.empty() || line[0] == '#' || line[0] == ';') {
+            continue;
+        }
+        if(line.front() == '[' && line.back() == ']') {
+            inTarget = line.substr(1, line.size() - 2) == targetName;
+            foundTarget = foundTarget || inTarget;
+            continue;
+        }
+        if(!inTarget) {
+            continue;
+        }
+
+        size_t const equalsIdx = line.find('=');
+        if(equalsIdx == std::string::npos) {
+            throw std::runtime_error("Invalid line in latency profile file " + path + ": " + line);
+        }
+
+        // Parameters this version of the simulation doesn't know about are ignored
+        auto const parameterIt = parameters.find(trim(line.substr(0, equalsIdx)));
+        if(parameterIt != parameters.end()) {
+            profile.*(parameterIt->second) = std::chrono::nanoseconds(std::stoll(line.substr(equalsIdx + 1)));
+        }
+    }
+
+    if(!foundTarget) {
+        throw std::runtime_error("No latency profile for " + targetName + " in " + path);
+    }
+    return profile;
+}
+
+void set_latency_profile(LatencyProfile const & profile)
+{
+    currentProfile = profile;
+    SPIBus::set_inter_byte_time(profile.spiInterByteTime);
+}
+
+LatencyProfile const & latency_profile()
+{
+    return currentProfile;
+}
+
+std::string use_latency_profile_from_environment()
+{
+    char const * const profilePath = std::getenv("NATIVE_SIM_PROFILES");
+    char const * const targetName = std::getenv("NATIVE_SIM_TARGET");
+    if(profilePath == nullptr || targetName == nullptr) {
+        return "";
+    }
+
+    set_latency_profile(load_latency_profile(profilePath, targetName));
+    return targetName;
+}
+
+}
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2024 Jamie Smith
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef NATIVE_SIM_H
+#define NATIVE_SIM_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Pin names are just numbers in the simulation.  The only thing they are used for is connecting
+// chip select pins to emulated devices.
+typedef int PinName;
+constexpr PinName NC = -1;
+
+namespace native_sim {
+
+/*
+ * Simulated time.  Everything in the simulation (SPI transfers, sleeps, and emulated device latencies) is
+ * measured against this clock instead of the host's clock, so that timings are repeatable and reflect the
+ * modeled hardware rather than how fast the host PC is.
+ */
+class SimulatedClock {
+public:
+    static std::chrono::nanoseconds now();
+
+    static void advance(std::chrono::nanoseconds time);
+};
+
+/*
+ * Interface for an emulated device on the SPI bus
+ */
+class EmulatedSPIDevice {
+public:
+    virtual ~EmulatedSPIDevice() = default;
+
+    /*
+     * Called when the device's chip select pin changes.
+     */
+    virtual void set_selected(bool selected) = 0;
+
+    /*
+     * Exchange one byte with the device.  Called for every byte on the bus, even if the device is not selected.
+     * clockFrequency is the SPI clock rate that the byte was sent at.
+     * Returns the byte the device drives on MISO, or 0xFF if it is not driving MISO.
+     */
+    virtual uint8_t transfer(uint8_t mosi, uint32_t clockFrequency) = 0;
+};
+
+/*
+ * The simulated SPI bus.  Only one bus exists, and devices are attached to it by their chip select pin.
+ */
+class SPIBus {
+public:
+    /*
+     * Attach a device to the bus.  Writes to a DigitalOut on csPin will select and deselect it.
+     */
+    static void attach(PinName csPin, EmulatedSPIDevice * device);
+
+    static void detach(PinName csPin);
+
+    /*
+     * Set the time that the MCU spends between bytes (e.g. in driver overhead), on top of the time
+     * it takes to clock the byte out.  Defaults to zero.
+     */
+    static void set_inter_byte_time(std::chrono::nanoseconds time);
+
+    /*
+     * Exchange a byte with all devices on the bus and advance the clock by the time it takes.
+     * Since MISO is open drain in the simulation, the result is the AND of what all devices drive.
+     */
+    static uint8_t transfer(uint8_t mosi, uint32_t clockFrequency);
+
+    /*
+     * Set the state of a GPIO pin.  Selects or deselects the device with that CS pin, if there is one.
+     */
+    static void write_pin(PinName pin, int value);
+};
+
+/*
+ * Latencies of a real target's HAL, so that the simulation predicts how that target would perform.
+ * Profiles are generated from each target's benchmark results by test_result_evaluator.generate_sim_profiles.
+ * The defaults are zero, i.e. an infinitely fast MCU, where only the bus and the emulated devices take time.
+ */
+struct LatencyProfile {
+    // Time from writing a DigitalOut until the change can be seen on another pin
+    std::chrono::nanoseconds gpioPropagationTime{};
+
+    // Time that the MCU spends between SPI bytes (driver overhead), on top of clocking them out
+    std::chrono::nanoseconds spiInterByteTime{};
+
+    // Time to reapply an SPI object's configuration when it takes over the peripheral from another object
+    std::chrono::nanoseconds spiObjectSwitchTime{};
+};
+
+/*
+ * Load the profile of the given target from a profile file.  Parameters not in the file keep their defaults.
+ * Throws std::runtime_error if the file can't be read or has no profile for the target.
+ */
+LatencyProfile load_latency_profile(std::string const & path, std::string const & targetName);
+
+/*
+ * Set the profile used by the simulation
+ */
+void set_latency_profile(LatencyProfile const & profile);
+
+LatencyProfile const & latency_profile();
+
+/*
+ * If the NATIVE_SIM_PROFILES and NATIVE_SIM_TARGET environment variables are set, load the named target's profile
+ * from that file and use it.  Returns the target name, or an empty string if no profile was loaded.
+ */
+std::string use_latency_profile_from_environment();
+
+}
+
+#endif
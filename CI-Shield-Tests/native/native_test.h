@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2024 Jamie Smith
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef NATIVE_TEST_H
+#define NATIVE_TEST_H
+
+// Minimal test harness for the native tests.  Provides the subset of the Unity assertions and the
+// ci_test_common.h helpers that the tests use, so that test code reads the same as on the device.
+
+#include <cinttypes>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+struct NativeTestFailure : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+#define NATIVE_TEST_STRINGIFY(x) #x
+#define NATIVE_TEST_FAIL(message, line) throw NativeTestFailure(std::string(__FILE__ ":") + NATIVE_TEST_STRINGIFY(line) + "::FAIL: " + (message))
+
+#define TEST_ASSERT_MESSAGE(condition, message) do { if(!(condition)) { NATIVE_TEST_FAIL(message, __LINE__); } } while(0)
+#define TEST_ASSERT(condition) TEST_ASSERT_MESSAGE(condition, "Expression Evaluated To FALSE")
+#define TEST_ASSERT_TRUE(condition) TEST_ASSERT(condition)
+#define TEST_ASSERT_FALSE(condition) TEST_ASSERT_MESSAGE(!(condition), "Expected FALSE Was TRUE")
+#define TEST_ASSERT_EQUAL(expected, actual) TEST_ASSERT_MESSAGE((expected) == (actual), \
+    "Expected " + std::to_string(expected) + " Was " + std::to_string(actual))
+#define TEST_ASSERT_EQUAL_HEX8(expected, actual) TEST_ASSERT_EQUAL(static_cast<unsigned>(expected), static_cast<unsigned>(actual))
+
+struct NativeTestCase {
+    char const * name;
+    void (*handler)();
+};
+
+/*
+ * Print a benchmark result, in the same format as report_metric() in ci_test_common.h
+ */
+inline void report_metric(char const * name, double value, char const * unit)
+{
+    printf("Metric: %s = %.3f %s\n", name, value, unit);
+}
+
+/*
+ * Run a list of test cases and print the results like utest does.  Returns the number of failed cases.
+ */
+template<size_t numCases>
+int run_native_tests(NativeTestCase const (&cases)[numCases])
+{
+    size_t failures = 0;
+    for(size_t caseIdx = 0; caseIdx < numCases; ++caseIdx) {
+        printf("\n>>> Running case #%zu: '%s'...\n", caseIdx + 1, cases[caseIdx].name);
+        bool passed = true;
+        try {
+            cases[caseIdx].handler();
+        }
+        catch(NativeTestFailure const & failure) {
+            printf("%s\n", failure.what());
+            passed = false;
+        }
+        catch(std::exception const & exception) {
+            printf("Exception: %s\n", exception.what());
+            passed = false;
+        }
+
+        if(!passed) {
+            ++failures;
+        }
+        printf(">>> '%s': %d passed, %d failed\n", cases[caseIdx].name, passed ? 1 : 0, passed ? 0 : 1);
+    }
+
+    printf("\n>>> Test cases: %zu passed, %zu failed\n", numCases - failures, failures);
+    return static_cast<int>(failures);
+}
+
+#endif
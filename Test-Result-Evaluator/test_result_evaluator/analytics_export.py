@@ -0,0 +1,210 @@
+"""
+Module to export the test database into partitioned Parquet datasets for analysis across many runs, and to
+query those datasets.
+
+Each export is a snapshot of the database on one run date.  Exporting every night into the same directory builds
+up the history, which the database itself does not keep.  The layout is one dataset per table:
+    <export dir>/<table>/vendorName=<vendor>/targetName=<target>/runDate=<YYYY-MM-DD>/part-0.parquet
+so queries which filter on vendor, target, or date only need to read the matching files.
+"""
+
+import dataclasses
+import datetime
+import pathlib
+import statistics
+from typing import Any, Dict, List, Optional
+
+from test_result_evaluator.mbed_test_database import MbedTestDatabase, TestResult, DEFAULT_BUILD_PROFILE
+
+# Names of the exported datasets
+TESTS_DATASET = "tests"
+TEST_CASES_DATASET = "test_cases"
+METRICS_DATASET = "metrics"
+
+# Columns each dataset is partitioned by, in directory order
+PARTITION_COLUMNS = ["vendorName", "targetName", "runDate"]
+
+# Columns that results can be grouped by in queries
+GROUP_BY_COLUMNS = {
+    "vendor": "vendorName",
+    "family": "mcuFamilyTarget",
+    "target": "targetName",
+    "date": "runDate",
+}
+
+# Group shown for rows where the group by column is null, e.g. targets with no MCU family
+NO_GROUP = "(none)"
+
+
+def _partitioning():
+    import pyarrow as pa
+    import pyarrow.dataset as ds
+    return ds.partitioning(pa.schema([(column, pa.string()) for column in PARTITION_COLUMNS]), flavor="hive")
+
+
+def _schemas() -> Dict[str, Any]:
+    import pyarrow as pa
+    return {
+        TESTS_DATASET: pa.schema([
+            ("testName", pa.string()),
+            ("targetName", pa.string()),
+            ("vendorName", pa.string()),
+            ("mcuFamilyTarget", pa.string()),
+            ("executionTime", pa.float64()),
+            ("result", pa.string()),
+            ("interfaceChip", pa.string()),
+            ("runDate", pa.string()),
+        ]),
+        TEST_CASES_DATASET: pa.schema([
+            ("testName", pa.string()),
+            ("testCaseName", pa.string()),
+            ("testCaseIndex", pa.int32()),
+            ("targetName", pa.string()),
+            ("vendorName", pa.string()),
+            ("mcuFamilyTarget", pa.string()),
+            ("result", pa.string()),
+            ("runDate", pa.string()),
+        ]),
+        METRICS_DATASET: pa.schema([
+            ("testName", pa.string()),
+            ("testCaseName", pa.string()),
+            ("targetName", pa.string()),
+            ("vendorName", pa.string()),
+            ("mcuFamilyTarget", pa.string()),
+            ("buildProfile", pa.string()),
+            ("metricName", pa.string()),
+            ("value", pa.float64()),
+            ("unit", pa.string()),
+            ("runDate", pa.string()),
+        ]),
+    }
+
+
+def _write_dataset(rows: List[Dict[str, Any]], schema, dataset_path: pathlib.Path):
+    """
+    Write rows into a dataset, replacing any partitions which were exported before with the same keys
+    (i.e. re-exporting on the same date replaces that date's data).
+    """
+    import pyarrow as pa
+    import pyarrow.dataset as ds
+
+    ds.write_dataset(pa.Table.from_pylist(rows, schema=schema), dataset_path, format="parquet",
+                     partitioning=_partitioning(), basename_template="part-{i}.parquet",
+                     existing_data_behavior="delete_matching")
+
+
+def export_database(database: MbedTestDatabase, export_dir: pathlib.Path, run_date: datetime.date):
+    """
+    Export the current contents of the database as the results of the given run date.
+    """
+
+    run_date_str = run_date.isoformat()
+    schemas = _schemas()
+
+    cursor = database.get_tests_for_export()
+    tests_rows = [dict(row, result=TestResult(row["result"]).name, runDate=run_date_str) for row in cursor]
+    cursor.close()
+
+    cursor = database.get_test_cases_for_export()
+    test_cases_rows = [dict(row, result=TestResult(row["result"]).name, runDate=run_date_str) for row in cursor]
+    cursor.close()
+
+    cursor = database.get_metrics_for_export()
+    metrics_rows = [dict(row, runDate=run_date_str) for row in cursor]
+    cursor.close()
+
+    for dataset_name, rows in ((TESTS_DATASET, tests_rows), (TEST_CASES_DATASET, test_cases_rows),
+                               (METRICS_DATASET, metrics_rows)):
+        print(f">> Exporting {len(rows)} rows to {dataset_name}")
+        _write_dataset(rows, schemas[dataset_name], export_dir / dataset_name)
+
+
+def _load_dataset(export_dir: pathlib.Path, dataset_name: str, filters: Dict[str, Any], since: Optional[datetime.date]):
+    """
+    Load the rows of a dataset which match the given column values, and were exported on or after since.
+    """
+    import pyarrow.dataset as ds
+
+    expression = None
+    for column, value in filters.items():
+        if value is None:
+            continue
+        term = ds.field(column) == value
+        expression = term if expression is None else expression & term
+    if since is not None:
+        term = ds.field("runDate") >= since.isoformat()
+        expression = term if expression is None else expression & term
+
+    dataset = ds.dataset(export_dir / dataset_name, format="parquet", partitioning=_partitioning())
+    return dataset.to_table(filter=expression)
+
+
+@dataclasses.dataclass
+class MetricSummary:
+    group: str
+    unit: str
+    count: int
+    median: float
+    mean: float
+    minimum: float
+    maximum: float
+
+
+def query_metric(export_dir: pathlib.Path, metric_name: str, group_by: str = "vendor",
+                 test_name: Optional[str] = None, test_case_name: Optional[str] = None,
+                 target_name: Optional[str] = None, vendor_name: Optional[str] = None,
+                 build_profile: str = DEFAULT_BUILD_PROFILE, since: Optional[datetime.date] = None) -> List[MetricSummary]:
+    """
+    Summarize the values of a metric across all the exported runs which match the filters, grouped by one of
+    the GROUP_BY_COLUMNS.
+    """
+    table = _load_dataset(export_dir, METRICS_DATASET,
+                          {"metricName": metric_name, "testName": test_name, "testCaseName": test_case_name,
+                           "targetName": target_name, "vendorName": vendor_name, "buildProfile": build_profile},
+                          since)
+
+    # Maps group to its values, and the unit they're in
+    grouped_values: Dict[str, List[float]] = {}
+    units: Dict[str, str] = {}
+    for group, value, unit in zip(table.column(GROUP_BY_COLUMNS[group_by]).to_pylist(),
+                                  table.column("value").to_pylist(),
+                                  table.column("unit").to_pylist()):
+        group = NO_GROUP if group is None else group
+        grouped_values.setdefault(group, []).append(value)
+        units[group] = unit
+
+    return [MetricSummary(group, units[group], len(values), statistics.median(values), statistics.fmean(values),
+                          min(values), max(values))
+            for group, values in sorted(grouped_values.items())]
+
+
+@dataclasses.dataclass
+class PassRateSummary:
+    group: str
+    runs: int
+    passed: int
+
+
+def query_pass_rate(export_dir: pathlib.Path, group_by: str = "vendor", test_name: Optional[str] = None,
+                    target_name: Optional[str] = None, vendor_name: Optional[str] = None,
+                    since: Optional[datetime.date] = None) -> List[PassRateSummary]:
+    """
+    Count the test runs which passed across all the exported runs which match the filters, grouped by one of
+    the GROUP_BY_COLUMNS.  Skipped tests are not counted.
+    """
+    table = _load_dataset(export_dir, TESTS_DATASET,
+                          {"testName": test_name, "targetName": target_name, "vendorName": vendor_name},
+                          since)
+
+    summaries: Dict[str, PassRateSummary] = {}
+    for group, result in zip(table.column(GROUP_BY_COLUMNS[group_by]).to_pylist(),
+                             table.column("result").to_pylist()):
+        if result == TestResult.SKIPPED.name:
+            continue
+        group = NO_GROUP if group is None else group
+        summary = summaries.setdefault(group, PassRateSummary(group, 0, 0))
+        summary.runs += 1
+        if result == TestResult.PASSED.name:
+            summary.passed += 1
+
+    return [summaries[group] for group in sorted(summaries.keys())]
@@ -0,0 +1,123 @@
+"""
+Module to generate the per-target benchmark sizing header used by the CI shield tests.
+
+Benchmarks should move enough data to measure steady-state throughput, but their buffers also have to fit in the
+RAM of the smallest targets.  So, instead of hard-coding buffer sizes in the tests, we size each target's
+benchmark working set from its RAM banks in the CMSIS MCU data, and write the results out as a header that
+the tests include.  The CI shield tests' CMake build generates this header for the target being built when it
+is configured.
+
+Note: This module is run by the CMake build using Mbed OS's Python environment, so it must only use packages
+from Mbed OS's requirements.
+"""
+
+import pathlib
+from typing import Any, Dict, Iterable, Optional
+
+import pyjson5
+
+from mbed_tools.targets._internal.target_attributes import get_target_attributes
+
+# The working set is this fraction of the target's main RAM bank.  It needs to leave room for the
+# OS, the stacks, and the other buffers that the tests allocate.
+WORKING_SET_RAM_DIVISOR = 16
+
+# Limits on the working set size.  Below the minimum, per-transfer overhead dominates the measurements.
+# Above the maximum, the benchmarks just take longer without telling us anything new.
+MIN_WORKING_SET_SIZE = 1024
+MAX_WORKING_SET_SIZE = 64 * 1024
+
+# Working set used for targets which have no RAM data.  Must match the default in ci_test_bench_sizes.h.
+DEFAULT_WORKING_SET_SIZE = 4096
+
+HEADER_PREFIX = """/*
+ * Copyright (c) 2024 Jamie Smith
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This file is generated by test_result_evaluator.generate_bench_sizes from the target memory data in
+// Mbed OS when the CI shield tests are configured.  It's included by ci_test_bench_sizes.h.
+
+#ifndef CI_TEST_TARGET_BENCH_SIZES_H
+#define CI_TEST_TARGET_BENCH_SIZES_H
+
+"""
+
+HEADER_SUFFIX = """
+#endif
+"""
+
+
+def get_main_ram_size(memory_banks: Iterable[Dict[str, Any]]) -> Optional[int]:
+    """
+    Get the size of the RAM bank that a target's data goes in by default, given the memory banks of its
+    MCU from the CMSIS MCU data.
+    If the CMSIS data doesn't mark any RAM bank as the default, the largest one is used.
+    Returns None if no RAM banks are known for the target.
+    """
+    ram_banks = [bank for bank in memory_banks if bank["access"]["write"]]
+    if len(ram_banks) == 0:
+        return None
+
+    default_banks = [bank for bank in ram_banks if bank.get("default", False)]
+    if len(default_banks) > 0:
+        return max(bank["size"] for bank in default_banks)
+    return max(bank["size"] for bank in ram_banks)
+
+
+def calc_working_set_size(ram_size: int) -> int:
+    """
+    Calculate the benchmark working set size for a target with the given amount of RAM.
+    The result is rounded down to a power of 2 so that it divides evenly into blocks and pages.
+    """
+    working_set_size = 1 << ((ram_size // WORKING_SET_RAM_DIVISOR).bit_length() - 1) if ram_size > 0 else 0
+    return min(max(working_set_size, MIN_WORKING_SET_SIZE), MAX_WORKING_SET_SIZE)
+
+
+def get_target_ram_size(mbed_os_path: pathlib.Path, target_name: str) -> Optional[int]:
+    """
+    Look up the main RAM size of a target in the target and CMSIS MCU data of the given Mbed OS.
+    Returns None if the target has no CMSIS MCU or the MCU has no RAM data.
+    """
+    targets_data: Dict[str, Any] = pyjson5.decode((mbed_os_path / "targets" / "targets.json5").read_text())
+    cmsis_mcu_description_data: Dict[str, Any] = pyjson5.decode(
+        (mbed_os_path / "targets" / "cmsis_mcu_descriptions.json5").read_text())
+
+    cmsis_mcu_part_number: Optional[str] = get_target_attributes(targets_data, target_name, True).get("device_name", None)
+    if cmsis_mcu_part_number is None or cmsis_mcu_part_number not in cmsis_mcu_description_data:
+        return None
+    return get_main_ram_size(cmsis_mcu_description_data[cmsis_mcu_part_number]["memories"].values())
+
+
+def write_bench_sizes_header(mbed_os_path: pathlib.Path, target_name: str, out_path: pathlib.Path):
+    """
+    Generate the benchmark sizing header for the given target.  If the target has no RAM data, the header
+    defines nothing, and the defaults in ci_test_bench_sizes.h get used.
+    """
+    header = HEADER_PREFIX
+
+    ram_size = get_target_ram_size(mbed_os_path, target_name)
+    if ram_size is None:
+        header += f"// No RAM data for {target_name}, so the defaults are used\n"
+    else:
+        header += f"// Sizes for {target_name}\n"
+        header += f"#define CI_TEST_RAM_SIZE {ram_size}\n"
+        header += f"#define BENCH_WORKING_SET_SIZE {calc_working_set_size(ram_size)}\n"
+
+    header += HEADER_SUFFIX
+
+    # Only write the header if it changed, so that reconfiguring doesn't rebuild every test
+    if not out_path.exists() or out_path.read_text() != header:
+        out_path.parent.mkdir(parents=True, exist_ok=True)
+        out_path.write_text(header)
@@ -0,0 +1,36 @@
+"""
+Module to measure the memory used by a test binary from its ELF file.
+"""
+
+import pathlib
+from typing import Tuple
+
+# Sections which reserve the rest of RAM for the heap and stack.  These are left out of the RAM usage so that it
+# only counts static data.
+RESERVED_RAM_SECTION_PREFIXES = (".heap", ".stack")
+
+
+def get_elf_memory_usage(elf_path: pathlib.Path) -> Tuple[int, int]:
+    """
+    Get the flash and RAM used by an ELF file, in bytes.
+    Flash usage is the size of all the loaded sections with contents (code, constants, and initializers for data).
+    RAM usage is the size of all the writable sections (data and bss), not counting the heap and stack.
+    """
+
+    # Imported here so that pyelftools is only needed when code sizes are being imported
+    from elftools.elf.constants import SH_FLAGS
+    from elftools.elf.elffile import ELFFile
+
+    flash_bytes = 0
+    ram_bytes = 0
+    with open(elf_path, "rb") as elf_file:
+        for section in ELFFile(elf_file).iter_sections():
+            flags = section["sh_flags"]
+            if not flags & SH_FLAGS.SHF_ALLOC:
+                continue
+            if section["sh_type"] != "SHT_NOBITS":
+                flash_bytes += section["sh_size"]
+            if flags & SH_FLAGS.SHF_WRITE and not section.name.startswith(RESERVED_RAM_SECTION_PREFIXES):
+                ram_bytes += section["sh_size"]
+
+    return flash_bytes, ram_bytes
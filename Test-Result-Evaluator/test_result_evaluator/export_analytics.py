@@ -0,0 +1,26 @@
+"""
+Script to export the test database into partitioned Parquet datasets, as the results of one run date.
+Run this after importing each night's test runs to build up a history for analysis with query_analytics.
+"""
+
+import datetime
+import pathlib
+import sys
+
+from test_result_evaluator import mbed_test_database
+from test_result_evaluator.analytics_export import export_database
+
+if len(sys.argv) not in (3, 4):
+    print(f"Usage: {sys.argv[0]} <path to database to use> <path to export directory> [run date as YYYY-MM-DD, default today]")
+    sys.exit(1)
+
+# Load database
+db_path = pathlib.Path(sys.argv[1])
+database = mbed_test_database.MbedTestDatabase(db_path)
+export_dir = pathlib.Path(sys.argv[2])
+run_date = datetime.date.fromisoformat(sys.argv[3]) if len(sys.argv) == 4 else datetime.date.today()
+
+print(f">> Exporting results for {run_date.isoformat()}...")
+export_database(database, export_dir, run_date)
+
+print("Done.")
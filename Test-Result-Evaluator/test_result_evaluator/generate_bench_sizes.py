@@ -0,0 +1,18 @@
+"""
+Script to generate the benchmark sizing header for the CI shield tests for one target, from the target and
+CMSIS MCU data in Mbed OS.  This is run by the CI shield tests' CMake build when it is configured.
+"""
+
+import pathlib
+import sys
+
+from test_result_evaluator.bench_size_generator import write_bench_sizes_header
+
+if len(sys.argv) != 4:
+    print(f"Usage: {sys.argv[0]} <path to Mbed OS> <Mbed target name> <path to header to generate>")
+    sys.exit(1)
+
+print(">> Generating Benchmark Sizes...")
+write_bench_sizes_header(pathlib.Path(sys.argv[1]), sys.argv[2], pathlib.Path(sys.argv[3]))
+
+print("Done.")
@@ -0,0 +1,22 @@
+"""
+Script to generate the per-target latency profiles for the native CI shield simulation from an Mbed test database.
+"""
+
+import pathlib
+import sys
+
+from test_result_evaluator import mbed_test_database
+from test_result_evaluator.sim_profile_generator import write_sim_profiles
+
+if len(sys.argv) != 3:
+    print(f"Usage: {sys.argv[0]} <path to database to use> <path to profile file to generate>")
+    sys.exit(1)
+
+# Load database
+db_path = pathlib.Path(sys.argv[1])
+database = mbed_test_database.MbedTestDatabase(db_path)
+
+print(">> Generating Simulation Latency Profiles...")
+write_sim_profiles(database, pathlib.Path(sys.argv[2]))
+
+print("Done.")
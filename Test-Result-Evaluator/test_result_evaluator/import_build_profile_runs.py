@@ -0,0 +1,46 @@
+"""
+Import the JUnit test reports from a run of the tests built with a non-default build profile (e.g. with -O2 or LTO)
+into the test database, so that their benchmark results and code sizes can be compared with the normal runs.
+Files must be named as <any identifier>-MBED_TARGET_NAME.xml to identify the target in use.
+The build directory must be the one the tests were built in, since it's used for the name of the build profile
+and the code size of each test.
+"""
+
+import sys
+import pathlib
+import re
+
+from . import mbed_test_database, test_run_parser
+
+if len(sys.argv) != 4:
+    print(f"Usage: {sys.argv[0]} <path to database to use> <path to directory containing JUnit XML files.> <path to build directory containing test ELFs>")
+    sys.exit(1)
+
+db_path = pathlib.Path(sys.argv[1])
+junit_dir = pathlib.Path(sys.argv[2])
+elf_dir = pathlib.Path(sys.argv[3])
+
+build_profile = test_run_parser.read_build_profile(elf_dir)
+if build_profile is None:
+    print(f"Error: {elf_dir / test_run_parser.BUILD_PROFILE_FILE_NAME} not found.  Is this a CI shield tests build directory?")
+    sys.exit(1)
+
+if build_profile == mbed_test_database.DEFAULT_BUILD_PROFILE:
+    print(f"Error: This is a build with the default build profile ({build_profile}).  Use import_test_runs instead.")
+    sys.exit(1)
+
+database = mbed_test_database.MbedTestDatabase(db_path)
+
+for file in junit_dir.iterdir():
+    if file.is_file() and file.suffix == ".xml":
+
+        match_result = re.match("^.*-([^-]+).xml$", file.name)
+        if match_result is None:
+            print(f"Warning: {file.name} does not appear to contain the target name.")
+        else:
+            mbed_target = match_result.group(1)
+            print(f">> Parsing {file.name} for target {mbed_target} with build profile {build_profile}")
+            test_run_parser.parse_build_profile_run(database, mbed_target, file, build_profile, elf_dir)
+            print(">> Done.")
+
+database.close()
@@ -1,6 +1,7 @@
 """
 Import the JUnit test reports from Mbed testing in the given directory into the test database.
-Files must be named as <any identifier>-MBED_TARGET_NAME.xml to identify the target in use
+Files must be named as <any identifier>-MBED_TARGET_NAME.xml to identify the target in use.
+If a directory containing the test ELFs is given, it's used to look up the functions in any profiles the tests recorded.
 """
 
 import sys
@@ -9,12 +10,18 @@ import re
 
 from . import mbed_test_database, test_run_parser
 
-if len(sys.argv) != 3:
-    print(f"Usage: {sys.argv[0]} <path to database to use> <path to directory containing JUnit XML files.>")
+if len(sys.argv) not in (3, 4):
+    print(f"Usage: {sys.argv[0]} <path to database to use> <path to directory containing JUnit XML files.> [path to build directory containing test ELFs]")
     sys.exit(1)
 
 db_path = pathlib.Path(sys.argv[1])
 junit_dir = pathlib.Path(sys.argv[2])
+elf_dir = pathlib.Path(sys.argv[3]) if len(sys.argv) == 4 else None
+
+build_profile = test_run_parser.read_build_profile(elf_dir)
+if build_profile is not None and build_profile != mbed_test_database.DEFAULT_BUILD_PROFILE:
+    print(f"Error: This is a build with the {build_profile} build profile.  Use import_build_profile_runs instead.")
+    sys.exit(1)
 
 database = mbed_test_database.MbedTestDatabase(db_path)
 
@@ -27,7 +34,7 @@ for file in junit_dir.iterdir():
         else:
             mbed_target = match_result.group(1)
             print(f">> Parsing {file.name} for target {mbed_target}")
-            test_run_parser.parse_test_run(database, mbed_target, file)
+            test_run_parser.parse_test_run(database, mbed_target, file, elf_dir)
             print(">> Done.")
 
 database.close()
@@ -2,9 +2,11 @@
 Module for creating and accessing an SQLite database of Mbed test results
 """
 import collections
+import hashlib
 import pathlib
 import sqlite3
 import enum
+import zlib
 from typing import Set, List, Optional, Dict, Any, Tuple
 import dataclasses
 
@@ -37,6 +39,9 @@ class DriverType(enum.Enum):
 # String to set for the MCU target family when there is none
 NO_MCU_TARGET_FAMILY = "NO_FAMILY"
 
+# Build profile of the normal test runs.  Results in the Tests, TestCases, and Metrics tables are from this profile.
+DEFAULT_BUILD_PROFILE = "Develop"
+
 
 class MbedTestDatabase:
 
@@ -88,6 +93,16 @@ class MbedTestDatabase:
             ")"
         )
 
+        # -- TestOutputs table
+        # Holds the console output of tests and test cases.  Outputs are stored compressed, and each distinct
+        # output is only stored once (e.g. the empty output of every skipped test case shares one row).
+        self._database.execute(
+            "CREATE TABLE TestOutputs("
+            "outputHash TEXT PRIMARY KEY, "  # SHA-256 hex digest of the uncompressed output
+            "compressedOutput BLOB NOT NULL"  # zlib-compressed UTF-8 text of the output
+            ")"
+        )
+
         # -- Tests table
         # Holds details about tests for each target
         self._database.execute(
@@ -96,7 +111,9 @@ class MbedTestDatabase:
             "targetName TEXT REFERENCES Targets(name), "  # Name of the target it was ran for
             "executionTime REAL, "  # Time in seconds it took to run the test
             "result INTEGER,"  # TestResult of the test
-            "output TEXT,"  # Output that the complete test printed (not divided into test cases)
+            "outputHash TEXT REFERENCES TestOutputs(outputHash),"  # Output that the complete test printed (not divided into test cases)
+            "interfaceChip TEXT NULL, "  # Interface chip (debug probe) the target was connected through, if the
+                                         # host test reported it.
             "UNIQUE(testName, targetName)"  # Combo of test name - target name must be unique
             ")"
         )
@@ -110,12 +127,71 @@ class MbedTestDatabase:
             "testCaseIndex INTEGER NOT NULL, "  # 0-indexed order that this test case ran in
             "targetName TEXT NOT NULL REFERENCES Targets(name), "  # Name of the target it was ran for
             "result INTEGER NOT NULL,"  # TestResult of the test
-            "output TEXT NOT NULL,"  # Output that this test case printed specifically, or empty string for skipped tests
+            "outputHash TEXT NOT NULL REFERENCES TestOutputs(outputHash),"  # Output that this test case printed specifically,
+                                                                            # or empty string for skipped tests
             "FOREIGN KEY(testName, targetName) REFERENCES Tests(testName, targetName), "
             "UNIQUE(testName, testCaseName, targetName)"  # Combo of test name - test case name - target name must be unique
             ")"
         )
 
+        # -- Metrics table
+        # Holds benchmark results reported by test cases
+        self._database.execute(
+            "CREATE TABLE Metrics("
+            "testName TEXT NOT NULL, "  # Name of the test
+            "testCaseName TEXT NOT NULL, "  # Name of the test case which reported the metric
+            "targetName TEXT NOT NULL REFERENCES Targets(name), "  # Name of the target it was ran for
+            "metricName TEXT NOT NULL, "  # Name of the metric, e.g. "Mean round trip time"
+            "value REAL NOT NULL, "  # Value of the metric
+            "unit TEXT NOT NULL, "  # Unit of the value, e.g. "us"
+            "FOREIGN KEY(testName, targetName) REFERENCES Tests(testName, targetName), "
+            "UNIQUE(testName, testCaseName, targetName, metricName)"
+            ")"
+        )
+
+        # -- BuildProfileMetrics table
+        # Holds benchmark results from runs of the tests built with other build profiles, for comparing against
+        # the results in the Metrics table.  These runs only record metrics, not test results.
+        self._database.execute(
+            "CREATE TABLE BuildProfileMetrics("
+            "testName TEXT NOT NULL, "  # Name of the test
+            "testCaseName TEXT NOT NULL, "  # Name of the test case which reported the metric
+            "targetName TEXT NOT NULL REFERENCES Targets(name), "  # Name of the target it was ran for
+            "buildProfile TEXT NOT NULL, "  # Name of the build profile, e.g. "Release -O2 LTO"
+            "metricName TEXT NOT NULL, "  # Name of the metric, e.g. "Mean round trip time"
+            "value REAL NOT NULL, "  # Value of the metric
+            "unit TEXT NOT NULL, "  # Unit of the value, e.g. "us"
+            "UNIQUE(testName, testCaseName, targetName, buildProfile, metricName)"
+            ")"
+        )
+
+        # -- CodeSizes table
+        # Holds the memory used by each test binary in each build profile
+        self._database.execute(
+            "CREATE TABLE CodeSizes("
+            "testName TEXT NOT NULL, "  # Name of the test
+            "targetName TEXT NOT NULL REFERENCES Targets(name), "  # Name of the target it was built for
+            "buildProfile TEXT NOT NULL, "  # Name of the build profile
+            "flashBytes INTEGER NOT NULL, "  # Bytes of flash used by code and constant data
+            "ramBytes INTEGER NOT NULL, "  # Bytes of RAM used by static data, not counting the heap and stack
+            "UNIQUE(testName, targetName, buildProfile)"
+            ")"
+        )
+
+        # -- ProfileSamples table
+        # Holds the PC samples taken by the profiler in benchmark test cases, added up per function
+        self._database.execute(
+            "CREATE TABLE ProfileSamples("
+            "testName TEXT NOT NULL, "  # Name of the test
+            "testCaseName TEXT NOT NULL, "  # Name of the test case which was profiled
+            "targetName TEXT NOT NULL REFERENCES Targets(name), "  # Name of the target it was ran for
+            "functionName TEXT NOT NULL, "  # Name of the function the samples were in
+            "samples INTEGER NOT NULL, "  # Number of samples in the function
+            "FOREIGN KEY(testName, targetName) REFERENCES Tests(testName, targetName), "
+            "UNIQUE(testName, testCaseName, targetName, functionName)"
+            ")"
+        )
+
         # -- Drivers table
         # Lists target features
         self._database.execute(
@@ -158,6 +234,8 @@ class MbedTestDatabase:
             "size INTEGER NOT NULL, "  # Size in bytes
             "isFlash INTEGER NOT NULL, "  # 1 if flash memory, 0 if RAM.  This comes from the "writeable" 
                                           # attribute from the CMSIS JSON.
+            "isDefault INTEGER NOT NULL, "  # 1 if this is the default memory of its type, where the linker puts
+                                            # code or data unless told otherwise.  From the "default" attribute.
             "UNIQUE(targetName, bankName)"  # Combo of target name - bank name must be unique
             ")"
         )
@@ -329,11 +407,12 @@ class MbedTestDatabase:
                 for bank_name, bank_data in cmsis_cpu_data["memories"].items():
 
                     self._database.execute(
-                        "INSERT INTO TargetMemories(targetName, bankName, size, isFlash) VALUES(?, ?, ?, ?)",
+                        "INSERT INTO TargetMemories(targetName, bankName, size, isFlash, isDefault) VALUES(?, ?, ?, ?, ?)",
                         (target_name,
                          bank_name,
                          bank_data["size"],
-                         0 if bank_data["access"]["write"] else 1)
+                         0 if bank_data["access"]["write"] else 1,
+                         1 if bank_data.get("default", False) else 0)
                     )
 
         # Match targets with their MCU family targets.
@@ -554,13 +633,23 @@ ORDER BY childTarget ASC
                                           "mcuFamilyTarget == ?",
                                       (mcu_family_name, ))
 
+    def get_all_public_targets(self) -> sqlite3.Cursor:
+        """
+        Get all public targets (boards).
+        Returns a cursor containing the name, MCU family target, CPU vendor name, and MCU part number
+        """
+        return self._database.execute("SELECT name, mcuFamilyTarget, mcuVendorName, mcuPartNumber "
+                                      "FROM Targets "
+                                      "WHERE isPublic == 1 "
+                                      "ORDER BY name ASC")
+
     def get_target_memories(self, target_name: str) -> sqlite3.Cursor:
         """
         Get all memory banks for a target.
-        Returns a cursor containing the name and the CPU vendor name
+        Returns a cursor containing the bank name, size, whether it's flash, and whether it's the default bank
         """
 
-        return self._database.execute("SELECT bankName, size, isFlash "
+        return self._database.execute("SELECT bankName, size, isFlash, isDefault "
                                       "FROM TargetMemories "
                                       "WHERE "
                                           "targetName == ?"
@@ -594,23 +683,246 @@ ORDER BY childTarget ASC
             """,
                                       (driver_name,))
 
-    def add_test_record(self, test_name: str, target_name: str, execution_time: float, result: TestResult, output: str):
+    def _store_output(self, output: str) -> str:
+        """
+        Store a test output into the TestOutputs table (if an identical output is not already stored)
+        and return its hash.
+        """
+        output_bytes = output.encode("UTF-8")
+        output_hash = hashlib.sha256(output_bytes).hexdigest()
+        self._database.execute("INSERT OR IGNORE INTO TestOutputs(outputHash, compressedOutput) VALUES(?, ?)",
+                               (output_hash, zlib.compress(output_bytes, 9)))
+        return output_hash
+
+    @staticmethod
+    def _decompress_output(compressed_output: bytes) -> str:
+        """
+        Convert a compressedOutput value from the TestOutputs table back into text
+        """
+        return zlib.decompress(compressed_output).decode("UTF-8")
+
+    def add_test_record(self, test_name: str, target_name: str, execution_time: float, result: TestResult, output: str,
+                        interface_chip: Optional[str] = None):
         """
         Add or update a record of a test to the Tests table.
-        Replaces the record if it already exists
+        Replaces the record if it already exists, and removes any metrics and profiles recorded by the previous run.
         """
-        self._database.execute("INSERT OR REPLACE INTO Tests(testName, targetName, executionTime, result, output) "
-                               "VALUES(?, ?, ?, ?, ?)",
-                               (test_name, target_name, execution_time, result.value, output))
+        self._database.execute("INSERT OR REPLACE INTO Tests(testName, targetName, executionTime, result, outputHash, interfaceChip) "
+                               "VALUES(?, ?, ?, ?, ?, ?)",
+                               (test_name, target_name, execution_time, result.value, self._store_output(output),
+                                interface_chip))
+        self._database.execute("DELETE FROM Metrics WHERE testName == ? AND targetName == ?",
+                               (test_name, target_name))
+        self._database.execute("DELETE FROM ProfileSamples WHERE testName == ? AND targetName == ?",
+                               (test_name, target_name))
 
     def add_test_case_record(self, test_name: str, test_case_name: str, test_case_index: int, target_name: str, result: TestResult, output: str):
         """
         Add or update a record of a test to the TestCases table.
         Replaces the record if it already exists
         """
-        self._database.execute("INSERT OR REPLACE INTO TestCases(testName, testCaseName, testCaseIndex, targetName, result, output) "
+        self._database.execute("INSERT OR REPLACE INTO TestCases(testName, testCaseName, testCaseIndex, targetName, result, outputHash) "
                                "VALUES(?, ?, ?, ?, ?, ?)",
-                               (test_name, test_case_name, test_case_index, target_name, result.value, output))
+                               (test_name, test_case_name, test_case_index, target_name, result.value,
+                                self._store_output(output)))
+
+    def delete_unused_outputs(self):
+        """
+        Delete the outputs which no test or test case record refers to any more, e.g. because the runs they came
+        from were replaced by a later import.
+        """
+        self._database.execute("DELETE FROM TestOutputs "
+                               "WHERE outputHash NOT IN (SELECT outputHash FROM Tests WHERE outputHash IS NOT NULL) "
+                               "AND outputHash NOT IN (SELECT outputHash FROM TestCases)")
+
+    def add_metric_record(self, test_name: str, test_case_name: str, target_name: str, metric_name: str, value: float, unit: str):
+        """
+        Add or update a benchmark result in the Metrics table.
+        """
+        self._database.execute("INSERT OR REPLACE INTO Metrics(testName, testCaseName, targetName, metricName, value, unit) "
+                               "VALUES(?, ?, ?, ?, ?, ?)",
+                               (test_name, test_case_name, target_name, metric_name, value, unit))
+
+    def get_test_metrics(self, test_name: str) -> sqlite3.Cursor:
+        """
+        Get a cursor containing all the metrics reported by a test.
+        Returns the test case name, metric name, target name, value, and unit, in test case order.
+        """
+        return self._database.execute("""
+SELECT Metrics.testCaseName, metricName, Metrics.targetName, value, unit
+FROM
+    Metrics
+    LEFT JOIN TestCases ON Metrics.testName == TestCases.testName AND
+                           Metrics.testCaseName == TestCases.testCaseName AND
+                           Metrics.targetName == TestCases.targetName
+WHERE
+    Metrics.testName == ?
+ORDER BY TestCases.testCaseIndex ASC, Metrics.rowid ASC
+""", (test_name, ))
+
+    def clear_build_profile_metrics(self, test_name: str, target_name: str, build_profile: str):
+        """
+        Remove the metrics recorded by a previous run of a test with the given build profile.
+        """
+        self._database.execute("DELETE FROM BuildProfileMetrics WHERE testName == ? AND targetName == ? AND buildProfile == ?",
+                               (test_name, target_name, build_profile))
+
+    def add_build_profile_metric_record(self, test_name: str, test_case_name: str, target_name: str, build_profile: str,
+                                        metric_name: str, value: float, unit: str):
+        """
+        Add or update a benchmark result from a non-default build profile in the BuildProfileMetrics table.
+        """
+        self._database.execute("INSERT OR REPLACE INTO BuildProfileMetrics(testName, testCaseName, targetName, buildProfile, metricName, value, unit) "
+                               "VALUES(?, ?, ?, ?, ?, ?, ?)",
+                               (test_name, test_case_name, target_name, build_profile, metric_name, value, unit))
+
+    def add_code_size_record(self, test_name: str, target_name: str, build_profile: str, flash_bytes: int, ram_bytes: int):
+        """
+        Add or update the memory used by a test binary in the CodeSizes table.
+        """
+        self._database.execute("INSERT OR REPLACE INTO CodeSizes(testName, targetName, buildProfile, flashBytes, ramBytes) "
+                               "VALUES(?, ?, ?, ?, ?)",
+                               (test_name, target_name, build_profile, flash_bytes, ram_bytes))
+
+    def get_build_profiles(self) -> List[str]:
+        """
+        Get the names of all the build profiles which have results, starting with the default one.
+        """
+        cursor = self._database.execute("""
+SELECT buildProfile FROM BuildProfileMetrics
+UNION
+SELECT buildProfile FROM CodeSizes
+ORDER BY buildProfile ASC
+""")
+        profiles = [row["buildProfile"] for row in cursor if row["buildProfile"] != DEFAULT_BUILD_PROFILE]
+        cursor.close()
+        return [DEFAULT_BUILD_PROFILE] + profiles
+
+    def get_build_profile_metrics(self, target_name: str) -> sqlite3.Cursor:
+        """
+        Get a cursor containing the metrics reported by all tests on a target, in every build profile.
+        Results from the normal test runs are returned with the default build profile.
+        Returns the test name, test case name, metric name, build profile, value, and unit, in test case order.
+        """
+        return self._database.execute("""
+SELECT AllMetrics.testName, AllMetrics.testCaseName, metricName, buildProfile, value, unit
+FROM
+    (
+        SELECT testName, testCaseName, metricName, ? AS buildProfile, value, unit
+        FROM Metrics
+        WHERE targetName == ?
+        UNION ALL
+        SELECT testName, testCaseName, metricName, buildProfile, value, unit
+        FROM BuildProfileMetrics
+        WHERE targetName == ?
+    ) AS AllMetrics
+    LEFT JOIN TestCases ON AllMetrics.testName == TestCases.testName AND
+                           AllMetrics.testCaseName == TestCases.testCaseName AND
+                           TestCases.targetName == ?
+ORDER BY AllMetrics.testName ASC, TestCases.testCaseIndex ASC
+""", (DEFAULT_BUILD_PROFILE, target_name, target_name, target_name))
+
+    def get_code_sizes(self, target_name: str) -> sqlite3.Cursor:
+        """
+        Get a cursor containing the memory used by each test binary for a target, in every build profile.
+        Returns the test name, build profile, flash bytes, and RAM bytes.
+        """
+        return self._database.execute("""
+SELECT testName, buildProfile, flashBytes, ramBytes
+FROM CodeSizes
+WHERE targetName == ?
+ORDER BY testName ASC
+""", (target_name, ))
+
+    def get_targets_with_build_profile_results(self) -> List[str]:
+        """
+        Get the names of the targets which have results from a non-default build profile.
+        """
+        cursor = self._database.execute("""
+SELECT targetName FROM BuildProfileMetrics
+UNION
+SELECT targetName FROM CodeSizes WHERE buildProfile != ?
+ORDER BY targetName ASC
+""", (DEFAULT_BUILD_PROFILE, ))
+        targets = [row["targetName"] for row in cursor]
+        cursor.close()
+        return targets
+
+    # Selects the vendor of each target, falling back to the vendor of its MCU family
+    _TARGET_VENDOR_SQL = """
+COALESCE(Targets.mcuVendorName,
+         (SELECT max(FamilyTargets.mcuVendorName) FROM Targets AS FamilyTargets
+          WHERE FamilyTargets.mcuFamilyTarget == Targets.mcuFamilyTarget),
+         'Unknown') AS vendorName
+"""
+
+    def get_tests_for_export(self) -> sqlite3.Cursor:
+        """
+        Get a cursor containing every test run, with the vendor and MCU family of its target.
+        Returns the test name, target name, vendor name, MCU family target, execution time, result, and interface chip.
+        """
+        return self._database.execute(f"""
+SELECT testName, targetName, {self._TARGET_VENDOR_SQL}, Targets.mcuFamilyTarget, executionTime, result, interfaceChip
+FROM
+    Tests
+    INNER JOIN Targets ON Tests.targetName == Targets.name
+""")
+
+    def get_test_cases_for_export(self) -> sqlite3.Cursor:
+        """
+        Get a cursor containing every test case run, with the vendor and MCU family of its target.
+        Returns the test name, test case name, test case index, target name, vendor name, MCU family target, and result.
+        """
+        return self._database.execute(f"""
+SELECT testName, testCaseName, testCaseIndex, targetName, {self._TARGET_VENDOR_SQL}, Targets.mcuFamilyTarget, result
+FROM
+    TestCases
+    INNER JOIN Targets ON TestCases.targetName == Targets.name
+""")
+
+    def get_metrics_for_export(self) -> sqlite3.Cursor:
+        """
+        Get a cursor containing every metric, from the normal runs and from other build profiles, with the vendor
+        and MCU family of its target.
+        Returns the test name, test case name, target name, vendor name, MCU family target, build profile,
+        metric name, value, and unit.
+        """
+        return self._database.execute(f"""
+SELECT testName, testCaseName, targetName, {self._TARGET_VENDOR_SQL}, Targets.mcuFamilyTarget, buildProfile, metricName, value, unit
+FROM
+    (
+        SELECT testName, testCaseName, targetName, ? AS buildProfile, metricName, value, unit FROM Metrics
+        UNION ALL
+        SELECT testName, testCaseName, targetName, buildProfile, metricName, value, unit FROM BuildProfileMetrics
+    ) AS AllMetrics
+    INNER JOIN Targets ON AllMetrics.targetName == Targets.name
+""", (DEFAULT_BUILD_PROFILE, ))
+
+    def add_profile_record(self, test_name: str, test_case_name: str, target_name: str, function_name: str, samples: int):
+        """
+        Add or update the number of profiler samples in one function in the ProfileSamples table.
+        """
+        self._database.execute("INSERT OR REPLACE INTO ProfileSamples(testName, testCaseName, targetName, functionName, samples) "
+                               "VALUES(?, ?, ?, ?, ?)",
+                               (test_name, test_case_name, target_name, function_name, samples))
+
+    def get_test_profiles(self, test_name: str) -> sqlite3.Cursor:
+        """
+        Get a cursor containing the profiles recorded by a test.
+        Returns the test case name, target name, function name, and samples, in test case order and then
+        with the most sampled functions first.
+        """
+        return self._database.execute("""
+SELECT ProfileSamples.testCaseName, ProfileSamples.targetName, functionName, samples
+FROM
+    ProfileSamples
+    LEFT JOIN TestCases ON ProfileSamples.testName == TestCases.testName AND
+                           ProfileSamples.testCaseName == TestCases.testCaseName AND
+                           ProfileSamples.targetName == TestCases.targetName
+WHERE
+    ProfileSamples.testName == ?
+ORDER BY TestCases.testCaseIndex ASC, ProfileSamples.targetName ASC, samples DESC
+""", (test_name, ))
 
     def get_targets_with_tests(self) -> List[Tuple[str, str]]:
         """
@@ -646,11 +958,11 @@ ORDER BY testName ASC
     def get_targets_with_test(self, test_name: str) -> sqlite3.Cursor:
         """
         Get a cursor containing the target names for which we have test records available for a given test.
-        Also returns their target families.
+        Also returns their target families and the interface chip they were tested through (or None if unknown).
         """
 
         return self._database.execute("""
-SELECT DISTINCT targetName, mcuFamilyTarget
+SELECT DISTINCT targetName, mcuFamilyTarget, interfaceChip
 FROM
     Tests
     INNER JOIN Targets ON Tests.targetName == Targets.name
@@ -732,18 +1044,54 @@ ORDER BY max(testCaseIndex) ASC
         cursor.close()
         return all_test_case_results
 
-    def get_test_case_run_output(self, test_name: str, test_case_name: str, target_name: str) -> str:
+    def get_test_run_outputs(self, test_name: str) -> Tuple[List[Tuple[str, str, str]], Dict[str, str]]:
         """
-        Get the output from running a test case on a target.
+        Get the outputs of every test case run (that passed or failed) of the given test.
+        Returns a tuple of ([(test case name, target name, output hash)], {output hash: output}).
+        Identical outputs are only returned once in the dict.
         """
         cursor = self._database.execute("""
-SELECT output
+SELECT testCaseName, targetName, outputHash
 FROM TestCases
 WHERE
     testName = ?
-    AND testCaseName = ?
-    AND targetName = ?
-""", (test_name, test_case_name, target_name))
-        output = next(cursor)["output"]
+    AND result IN (?, ?)
+ORDER BY testCaseIndex ASC, targetName ASC
+""", (test_name, TestResult.PASSED.value, TestResult.FAILED.value))
+        runs = [(row["testCaseName"], row["targetName"], row["outputHash"]) for row in cursor]
+        cursor.close()
+
+        outputs: Dict[str, str] = {}
+        cursor = self._database.execute("""
+SELECT DISTINCT TestOutputs.outputHash AS outputHash, compressedOutput
+FROM
+    TestCases
+    INNER JOIN TestOutputs ON TestCases.outputHash == TestOutputs.outputHash
+WHERE
+    testName = ?
+    AND result IN (?, ?)
+""", (test_name, TestResult.PASSED.value, TestResult.FAILED.value))
+        for row in cursor:
+            outputs[row["outputHash"]] = self._decompress_output(row["compressedOutput"])
+        cursor.close()
+
+        return runs, outputs
+
+    def get_failed_test_case_runs(self) -> List[Tuple[str, str, str, str]]:
+        """
+        Get every test case run which failed.
+        Returns a list of (test name, test case name, target name, output).
+        """
+        cursor = self._database.execute("""
+SELECT testName, testCaseName, targetName, compressedOutput
+FROM
+    TestCases
+    INNER JOIN TestOutputs ON TestCases.outputHash == TestOutputs.outputHash
+WHERE
+    result == ?
+ORDER BY testName ASC, testCaseIndex ASC, targetName ASC
+""", (TestResult.FAILED.value, ))
+        failed_runs = [(row["testName"], row["testCaseName"], row["targetName"],
+                        self._decompress_output(row["compressedOutput"])) for row in cursor]
         cursor.close()
-        return output
\ No newline at end of file
+        return failed_runs
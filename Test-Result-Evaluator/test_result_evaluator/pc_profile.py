@@ -0,0 +1,86 @@
+"""
+Module to turn the PC samples that the CI shield tests' profiler prints (see CI-Shield-Tests/ci_test_profiler.h)
+into a count of samples per function, using the symbol table of the test ELF.
+"""
+
+import bisect
+import pathlib
+import re
+from typing import Dict, Iterable, Optional, Tuple
+
+# Matches the number of samples at one PC, e.g. "Profile: 0x08001234 57".  Allows extracting the PC and count.
+PROFILE_SAMPLE_RE = re.compile(r"Profile: 0x([0-9a-fA-F]+) (\d+)\s*$", re.MULTILINE)
+
+# Matches the line printed when the profiler's table overflowed, e.g. "Profile: dropped 12 samples"
+PROFILE_DROPPED_RE = re.compile(r"Profile: dropped (\d+) samples", re.MULTILINE)
+
+# Name used for samples at PCs which are not inside any known function
+UNKNOWN_FUNCTION = "<unknown>"
+
+# Name used for samples which the profiler had to drop
+DROPPED_SAMPLES = "<dropped>"
+
+
+class SymbolTable:
+    """
+    Maps addresses to the functions containing them.
+    """
+
+    def __init__(self, functions: Iterable[Tuple[int, int, str]]):
+        """
+        Create from (start address, size, name) tuples.  The Thumb bit of the start addresses is ignored.
+        """
+        self._functions = sorted((start & ~1, size, name) for start, size, name in functions)
+        self._starts = [start for start, _, _ in self._functions]
+
+    @classmethod
+    def from_elf(cls, elf_path: pathlib.Path) -> "SymbolTable":
+        """
+        Load the function symbols from an ELF file.
+        """
+
+        # Imported here so that pyelftools is only needed when profiles are being imported
+        from elftools.elf.elffile import ELFFile
+        from elftools.elf.sections import SymbolTableSection
+
+        functions = []
+        with open(elf_path, "rb") as elf_file:
+            elf = ELFFile(elf_file)
+            symtab = elf.get_section_by_name(".symtab")
+            if isinstance(symtab, SymbolTableSection):
+                for symbol in symtab.iter_symbols():
+                    if symbol["st_info"]["type"] == "STT_FUNC" and symbol["st_size"] > 0:
+                        functions.append((symbol["st_value"], symbol["st_size"], symbol.name))
+        return cls(functions)
+
+    def lookup(self, address: int) -> Optional[str]:
+        """
+        Get the name of the function containing an address, or None if it's not in any function.
+        """
+        index = bisect.bisect_right(self._starts, address) - 1
+        if index < 0:
+            return None
+        start, size, name = self._functions[index]
+        return name if address < start + size else None
+
+
+def aggregate_profile(output: str, symbols: Optional[SymbolTable]) -> Dict[str, int]:
+    """
+    Add up the profiler samples in the output of a test case for each function.
+    If there is no symbol table, samples are listed by PC instead.
+    Returns a dict of function name to number of samples, with the most sampled functions first.
+    """
+    samples: Dict[str, int] = {}
+    for pc_hex, count in re.findall(PROFILE_SAMPLE_RE, output):
+        pc = int(pc_hex, 16)
+        if symbols is None:
+            function_name = f"0x{pc:08x}"
+        else:
+            function_name = symbols.lookup(pc) or UNKNOWN_FUNCTION
+        samples[function_name] = samples.get(function_name, 0) + int(count)
+
+    dropped = sum(int(count) for count in re.findall(PROFILE_DROPPED_RE, output))
+    if dropped > 0:
+        samples[DROPPED_SAMPLES] = dropped
+
+    return dict(sorted(samples.items(), key=lambda item: item[1], reverse=True))
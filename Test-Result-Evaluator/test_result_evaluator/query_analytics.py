@@ -0,0 +1,52 @@
+"""
+Script to summarize results across the runs exported by export_analytics, e.g. the median SPI throughput per
+MCU vendor over the last 90 days:
+
+python -m test_result_evaluator.query_analytics <export dir> metric Throughput --test testshield-spi-basic --days 90 --group-by vendor
+"""
+
+import argparse
+import datetime
+import pathlib
+
+from test_result_evaluator.analytics_export import GROUP_BY_COLUMNS, query_metric, query_pass_rate
+from test_result_evaluator.mbed_test_database import DEFAULT_BUILD_PROFILE
+
+parser = argparse.ArgumentParser(prog="python -m test_result_evaluator.query_analytics",
+                                 description="Summarize results across exported test runs")
+parser.add_argument("export_dir", type=pathlib.Path, help="Directory that export_analytics wrote to")
+subparsers = parser.add_subparsers(dest="query", required=True)
+
+metric_parser = subparsers.add_parser("metric", help="Summarize the values of a benchmark metric")
+metric_parser.add_argument("metric_name", help="Name of the metric, e.g. 'Throughput'")
+metric_parser.add_argument("--case", help="Only include this test case")
+metric_parser.add_argument("--profile", default=DEFAULT_BUILD_PROFILE, help="Build profile (default: %(default)s)")
+
+subparsers.add_parser("pass-rate", help="Count how often tests passed")
+
+for subparser in subparsers.choices.values():
+    subparser.add_argument("--test", help="Only include this test")
+    subparser.add_argument("--target", help="Only include this target")
+    subparser.add_argument("--vendor", help="Only include targets from this MCU vendor")
+    subparser.add_argument("--days", type=int, help="Only include runs from the last N days")
+    subparser.add_argument("--group-by", choices=GROUP_BY_COLUMNS.keys(), default="vendor",
+                           help="What to group results by (default: %(default)s)")
+
+args = parser.parse_args()
+since = datetime.date.today() - datetime.timedelta(days=args.days) if args.days is not None else None
+
+if args.query == "metric":
+    summaries = query_metric(args.export_dir, args.metric_name, args.group_by, args.test, args.case, args.target,
+                             args.vendor, args.profile, since)
+    print(f"{args.group_by:<32} {'Runs':>6} {'Median':>12} {'Mean':>12} {'Min':>12} {'Max':>12}  Unit")
+    for summary in summaries:
+        print(f"{summary.group:<32} {summary.count:>6} {summary.median:>12.5g} {summary.mean:>12.5g} "
+              f"{summary.minimum:>12.5g} {summary.maximum:>12.5g}  {summary.unit}")
+else:
+    summaries = query_pass_rate(args.export_dir, args.group_by, args.test, args.target, args.vendor, since)
+    print(f"{args.group_by:<32} {'Runs':>6} {'Passed':>6} {'Pass Rate':>10}")
+    for summary in summaries:
+        print(f"{summary.group:<32} {summary.runs:>6} {summary.passed:>6} {summary.passed * 100 / summary.runs:>9.1f}%")
+
+if len(summaries) == 0:
+    print("No matching results.")
@@ -0,0 +1,38 @@
+"""
+Script to render the event traces recorded by a test's cases on one target (see CI-Shield-Tests/ci_test_trace.h)
+as timelines.
+"""
+
+import pathlib
+import sys
+
+from test_result_evaluator import mbed_test_database
+from test_result_evaluator.trace_timeline import parse_trace, render_timeline
+
+if len(sys.argv) not in (4, 5):
+    print(f"Usage: {sys.argv[0]} <path to database to use> <test name> <target name> [test case name]")
+    sys.exit(1)
+
+# Load database
+db_path = pathlib.Path(sys.argv[1])
+database = mbed_test_database.MbedTestDatabase(db_path)
+test_name = sys.argv[2]
+target_name = sys.argv[3]
+test_case_name = sys.argv[4] if len(sys.argv) == 5 else None
+
+runs, outputs = database.get_test_run_outputs(test_name)
+found_trace = False
+for run_case_name, run_target_name, output_hash in runs:
+    if run_target_name != target_name or (test_case_name is not None and run_case_name != test_case_name):
+        continue
+
+    events, dropped = parse_trace(outputs[output_hash])
+    if len(events) == 0:
+        continue
+
+    found_trace = True
+    print(f">> {run_case_name}")
+    print(render_timeline(events, dropped))
+
+if not found_trace:
+    print("No traces found.  Note that tracing must be enabled (app.trace-enabled in mbed_app.json5) when building the tests.")
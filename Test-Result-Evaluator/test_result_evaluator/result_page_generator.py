@@ -1,12 +1,14 @@
 import collections
+import gzip
+import json
 import pathlib
 from typing import TextIO, List, Dict, Set, Tuple
 import html
-import base64
 
 import prettytable
 
-from .mbed_test_database import MbedTestDatabase, DriverType, TestResult, NO_MCU_TARGET_FAMILY
+from .mbed_test_database import MbedTestDatabase, DriverType, TestResult, NO_MCU_TARGET_FAMILY, DEFAULT_BUILD_PROFILE
+from .search_index import write_search_index
 
 
 def write_global_stylesheet(gen_path: pathlib.Path):
@@ -47,18 +49,213 @@ div.prior-crashed-marker {
 """)
 
 
-def get_test_case_run_path(test_name: str, test_case_name: str, target_name: str) -> pathlib.Path:
+def write_global_script(gen_path: pathlib.Path):
     """
-    Get the (relative) path for a test case run's HTML file within the tests dir
+    Write out the global script, containing functions shared by the pages of the site, to a location
     """
-    # Convert test case name (which could be any string) into a filesystem-safe string by base64 encoding it
-    test_case_name_b64 = base64.urlsafe_b64encode(test_case_name.encode("UTF-8")).decode("ASCII")
-    return pathlib.Path("runs") / target_name / f"{test_name}-case-{test_case_name_b64}.html"
+    gen_path.write_text("""
+// Download a gzipped JSON file and decode it
+async function fetchGzippedJson(url) {
+    const response = await fetch(url);
+    let jsonBytes = new Uint8Array(await response.arrayBuffer());
+
+    // Some web servers transparently decompress .gz files, so only inflate the data if it
+    // still starts with the gzip magic number.
+    if (jsonBytes.length >= 2 && jsonBytes[0] === 0x1f && jsonBytes[1] === 0x8b) {
+        const inflatedStream = new Blob([jsonBytes]).stream().pipeThrough(new DecompressionStream("gzip"));
+        jsonBytes = new Uint8Array(await new Response(inflatedStream).arrayBuffer());
+    }
+    return JSON.parse(new TextDecoder("utf-8").decode(jsonBytes));
+}
+""")
+
+
+def write_run_output_viewer_script(gen_path: pathlib.Path):
+    """
+    Write out the script used by the test pages to show the output of a test case run.
+    Outputs are not part of the pages themselves.  Instead, each test has one gzipped JSON shard containing
+    the output of all of its runs, which is only downloaded once somebody clicks on a result.
+    """
+    gen_path.write_text("""
+// Cache of the decoded output shard of the test shown on this page
+let runOutputShard = null;
+
+async function loadRunOutputShard(shardUrl) {
+    if (runOutputShard === null) {
+        runOutputShard = await fetchGzippedJson(shardUrl);
+    }
+    return runOutputShard;
+}
+
+async function showRunOutput(shardUrl, caseIdx, targetIdx) {
+    const shard = await loadRunOutputShard(shardUrl);
+    const outputIdx = shard.runs[caseIdx + "," + targetIdx];
+
+    document.getElementById("run-output-target").textContent = shard.targets[targetIdx];
+    document.getElementById("run-output-case").textContent = shard.cases[caseIdx];
+    document.getElementById("run-output-text").textContent = outputIdx === undefined ?
+        "<output not available>" : shard.outputs[outputIdx];
+    $("#run-output-modal").modal("show");
+}
+
+// Links to a specific run look like #run-<case index>-<target index>, so that they can be shared
+function showRunOutputFromLocation(shardUrl) {
+    const runMatch = window.location.hash.match(/^#run-(\\d+)-(\\d+)$/);
+    if (runMatch !== null) {
+        showRunOutput(shardUrl, parseInt(runMatch[1]), parseInt(runMatch[2]));
+    }
+}
+""")
+
+
+def write_run_output_shard(database: MbedTestDatabase, test_name: str, case_names: List[str], target_names: List[str],
+                           out_path: pathlib.Path):
+    """
+    Write the gzipped JSON shard containing the output of every run of one test.
+    Runs are keyed by "<case index>,<target index>" using the ordering of the rows and columns of the test page,
+    and point into a list of outputs where identical outputs are only stored once.
+    """
+    runs, outputs = database.get_test_run_outputs(test_name)
+
+    case_indices = {case_name: case_idx for case_idx, case_name in enumerate(case_names)}
+    target_indices = {target_name: target_idx for target_idx, target_name in enumerate(target_names)}
+
+    output_hashes = list(outputs.keys())
+    output_indices = {output_hash: output_idx for output_idx, output_hash in enumerate(output_hashes)}
+
+    shard = {
+        "cases": case_names,
+        "targets": target_names,
+        "runs": {f"{case_indices[case_name]},{target_indices[target_name]}": output_indices[output_hash]
+                 for case_name, target_name, output_hash in runs},
+        "outputs": [outputs[output_hash] for output_hash in output_hashes]
+    }
+
+    # mtime=0 keeps the shard byte-for-byte identical if the test results have not changed
+    out_path.write_bytes(gzip.compress(json.dumps(shard, separators=(",", ":")).encode("UTF-8"), mtime=0))
+
+
+def generate_search_page(out_path: pathlib.Path):
+    """
+    Generate the search page.  The page downloads the search index written by write_search_index() and
+    looks up queries in it entirely in the browser.
+    """
+
+    with open(out_path, "w", encoding="utf8") as search_page:
+        write_html_header(search_page, "Search Mbed CE Test Results", levels_deep=0)
+
+        search_page.write("""
+<p>Search for targets, drivers, tests, test cases, and failed test runs.  All words must match, and each word
+matches anything starting with it, so e.g. <code>failed spi nucleo</code> finds every failure of an SPI test on a
+Nucleo board.  Failed runs are also indexed by their failure message.</p>
+<div class="ui fluid icon input">
+    <input type="text" id="search-input" placeholder="Search..." autofocus>
+    <i class="search icon"></i>
+</div>
+<p id="search-status"></p>
+<div class="ui divided items" id="search-results"></div>
+<script>
+const MAX_SHOWN_RESULTS = 200;
+let searchIndex = null;
+
+async function loadSearchIndex() {
+    const index = await fetchGzippedJson("search-index.json.gz");
+
+    // Undo the delta encoding of the posting lists
+    for (const postingList of index.postings) {
+        for (let i = 1; i < postingList.length; i++) {
+            postingList[i] += postingList[i - 1];
+        }
+    }
+    return index;
+}
+
+// Must match tokenize() in search_index.py
+function tokenize(text) {
+    return text.toLowerCase().split(/[^a-z0-9_]+/).filter(term => term.length > 0);
+}
+
+// Get the set of documents containing any term starting with the given prefix
+function findDocumentsWithPrefix(prefix) {
+    const terms = searchIndex.terms;
+
+    // Binary search for the first term >= prefix.  All matching terms follow it, since the terms are sorted.
+    let low = 0;
+    let high = terms.length;
+    while (low < high) {
+        const mid = (low + high) >> 1;
+        if (terms[mid] < prefix) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    const documents = new Set();
+    for (let termIdx = low; termIdx < terms.length && terms[termIdx].startsWith(prefix); termIdx++) {
+        for (const documentId of searchIndex.postings[termIdx]) {
+            documents.add(documentId);
+        }
+    }
+    return documents;
+}
+
+function runSearch() {
+    const queryTerms = tokenize(document.getElementById("search-input").value);
+    const resultsDiv = document.getElementById("search-results");
+    const statusText = document.getElementById("search-status");
+    resultsDiv.replaceChildren();
+    if (queryTerms.length === 0) {
+        statusText.textContent = "";
+        return;
+    }
+
+    // Intersect the matches of each term, starting from the smallest set
+    const matchSets = queryTerms.map(findDocumentsWithPrefix).sort((a, b) => a.size - b.size);
+    const matches = [...matchSets[0]].filter(documentId => matchSets.every(matchSet => matchSet.has(documentId)));
+    matches.sort((a, b) => a - b);
+
+    statusText.textContent = matches.length > MAX_SHOWN_RESULTS ?
+        `${matches.length} results, showing the first ${MAX_SHOWN_RESULTS}` : `${matches.length} results`;
+
+    for (const documentId of matches.slice(0, MAX_SHOWN_RESULTS)) {
+        const [kind, title, url, detail] = searchIndex.documents[documentId];
+
+        const item = document.createElement("div");
+        item.className = "item";
+        const content = document.createElement("div");
+        content.className = "content";
+        const label = document.createElement("span");
+        label.className = kind === "failure" ? "ui red label" : "ui label";
+        label.textContent = kind;
+        const link = document.createElement("a");
+        link.className = "header";
+        link.href = url;
+        link.textContent = title;
+        const description = document.createElement("div");
+        description.className = "description";
+        description.textContent = detail;
+        content.append(label, " ", link, description);
+        item.append(content);
+        resultsDiv.append(item);
+    }
+}
+
+loadSearchIndex().then(index => {
+    searchIndex = index;
+    const searchInput = document.getElementById("search-input");
+    searchInput.addEventListener("input", runSearch);
+    runSearch();
+});
+</script>
+""")
+
+        search_page.write("\n</body>")
 
 
 def write_html_header(output_file: TextIO, page_title: str, levels_deep=1):
     """
-    Write the common HTML header to a file.  Includes Semantic CSS and applies the given title.
+    Write the common HTML header to a file.  Includes Semantic CSS and the global script, and applies the given title.
 
     :param levels_deep: How many levels deep from the root folder of the site this page is
     """
@@ -77,8 +274,10 @@ def write_html_header(output_file: TextIO, page_title: str, levels_deep=1):
     <script src=" https://cdn.jsdelivr.net/npm/semantic-ui@2.5.0/dist/semantic.min.js "></script>
     <link href=" https://cdn.jsdelivr.net/npm/semantic-ui@2.5.0/dist/semantic.min.css " rel="stylesheet">
     <link rel="stylesheet" href="{up_to_root_path}mbed-results-site.css">
+    <script src="{up_to_root_path}mbed-results-site.js"></script>
 </head>
 <body>
+    <p><a href="{up_to_root_path}search.html">Search results &gt;</a></p>
     <h1>{page_title}</h1>""")
 
 
@@ -340,6 +539,9 @@ def generate_tests_index_page(database: MbedTestDatabase, out_path: pathlib.Path
     with open(out_path, "w", encoding="utf8") as targets_index:
         write_html_header(targets_index, "All Test Results by Target")
 
+        if len(database.get_targets_with_build_profile_results()) > 0:
+            targets_index.write('<p><a href="build-profiles.html">Compare benchmark results between build profiles &gt;</a></p>')
+
         test_table = prettytable.PrettyTable()
 
         # Figure out list of targets that we have test data for
@@ -376,12 +578,145 @@ def generate_tests_index_page(database: MbedTestDatabase, out_path: pathlib.Path
         targets_index.write("\n</body>")
 
 
+def generate_build_profiles_page(database: MbedTestDatabase, out_path: pathlib.Path):
+    """
+    Generate the page which compares the benchmark results and code size of the tests in each build profile.
+    There is one table per target, where each row is one metric of one test case and each column is one profile.
+    """
+
+    build_profiles = database.get_build_profiles()
+
+    with open(out_path, "w", encoding="utf8") as profiles_page:
+        write_html_header(profiles_page, "Benchmark Results by Build Profile")
+
+        profiles_page.write('<p><a href="index.html">Back to All Test Results ^</a></p>')
+        profiles_page.write(f"<p>Normal test runs use the {DEFAULT_BUILD_PROFILE} profile.  Other profiles only "
+                            "record benchmark results and code size, not test results.</p>\n")
+
+        for target_name in database.get_targets_with_build_profile_results():
+
+            # Maps (test, test case, metric name) to a dict of build profile to formatted value
+            metric_values: Dict[Tuple[str, str, str], Dict[str, str]] = collections.OrderedDict()
+
+            # Code size goes first for each test
+            sizes_cursor = database.get_code_sizes(target_name)
+            for row in sizes_cursor:
+                metric_values.setdefault((row["testName"], "", "Flash used"), {})[row["buildProfile"]] = f'{row["flashBytes"]} B'
+                metric_values.setdefault((row["testName"], "", "Static RAM used"), {})[row["buildProfile"]] = f'{row["ramBytes"]} B'
+            sizes_cursor.close()
+
+            metrics_cursor = database.get_build_profile_metrics(target_name)
+            for row in metrics_cursor:
+                row_values = metric_values.setdefault((row["testName"], row["testCaseName"], row["metricName"]), {})
+                row_values[row["buildProfile"]] = f'{row["value"]:.5g} {row["unit"]}'
+            metrics_cursor.close()
+
+            # Group the rows by test, keeping the code size rows first
+            test_order = list(dict.fromkeys(test_name for test_name, _, _ in metric_values.keys()))
+            sorted_rows = sorted(metric_values.items(), key=lambda item: test_order.index(item[0][0]))
+
+            profiles_page.write(f'<h2>{target_name}</h2>\n')
+            profiles_table = prettytable.PrettyTable()
+            profiles_table.field_names = ["Test", "Test Case", "Metric"] + build_profiles
+            for (test_name, test_case_name, metric_name), row_values in sorted_rows:
+                profiles_table.add_row([f'<a href="{test_name}.html">{test_name}</a>', test_case_name, metric_name] +
+                                       [row_values.get(build_profile, "") for build_profile in build_profiles])
+
+            # Note: html.unescape() prevents HTML in the cells from being escaped in the page (which prettytable
+            # seems to do)
+            profiles_page.write(html.unescape(profiles_table.get_html_string(attributes={"class": "ui celled table"})))
+
+        profiles_page.write("\n</body>")
+
+
+def write_test_metrics_table(database: MbedTestDatabase, test_name: str, test_page: TextIO):
+    """
+    Write the table of benchmark results reported by a test, if it reported any.
+    Each row is one metric of one test case, and each column is one target.
+    """
+
+    # Maps (test case, metric name) to a dict of target name to formatted value
+    metric_values: Dict[Tuple[str, str], Dict[str, str]] = collections.OrderedDict()
+    metrics_cursor = database.get_test_metrics(test_name)
+    for row in metrics_cursor:
+        row_values = metric_values.setdefault((row["testCaseName"], row["metricName"]), {})
+        row_values[row["targetName"]] = f'{row["value"]:.5g} {row["unit"]}'
+    metrics_cursor.close()
+
+    if len(metric_values) == 0:
+        return
+
+    test_page.write("<h2>Benchmark Results</h2>\n")
+
+    # Results depend on the interface chip for some benchmarks, so show it with the target name
+    metrics_table = prettytable.PrettyTable()
+    targets_with_metrics = []
+    table_header_text = ["Test Case", "Metric"]
+    targets_cursor = database.get_targets_with_test(test_name)
+    for row in targets_cursor:
+        if not any(row["targetName"] in row_values for row_values in metric_values.values()):
+            continue
+        targets_with_metrics.append(row["targetName"])
+        interface_chip = "" if row["interfaceChip"] is None else f'<br>({row["interfaceChip"]})'
+        table_header_text.append(f'<div style="writing-mode: vertical-lr;">{row["targetName"]}{interface_chip}</div>')
+    targets_cursor.close()
+
+    for (test_case_name, metric_name), row_values in metric_values.items():
+        metrics_table.add_row([test_case_name, metric_name] +
+                              [row_values.get(target_name, "") for target_name in targets_with_metrics])
+
+    # Note: html.unescape() prevents HTML in the cells from being escaped in the page (which prettytable
+    # seems to do)
+    metrics_table.field_names = table_header_text
+    test_page.write(html.unescape(metrics_table.get_html_string(attributes={"class": "ui celled table"})))
+
+
+# Number of functions to show in the profile of each test case
+PROFILE_TOP_FUNCTIONS = 10
+
+
+def write_test_profiles_table(database: MbedTestDatabase, test_name: str, test_page: TextIO):
+    """
+    Write the table of the functions where each profiled test case spent its time, if any were profiled.
+    Each row is one test case on one target, showing its most sampled functions.
+    """
+
+    # Maps (test case, target) to a list of (function name, samples), most sampled first
+    profiles: Dict[Tuple[str, str], List[Tuple[str, int]]] = collections.OrderedDict()
+    profiles_cursor = database.get_test_profiles(test_name)
+    for row in profiles_cursor:
+        profiles.setdefault((row["testCaseName"], row["targetName"]), []).append((row["functionName"], row["samples"]))
+    profiles_cursor.close()
+
+    if len(profiles) == 0:
+        return
+
+    test_page.write("<h2>Profiles</h2>\n")
+    test_page.write(f"<p>Top {PROFILE_TOP_FUNCTIONS} functions by share of the PC samples taken during each profiled test case.</p>\n")
+
+    profiles_table = prettytable.PrettyTable()
+    profiles_table.field_names = ["Test Case", "Target", "Samples", "Top Functions"]
+    for (test_case_name, target_name), functions in profiles.items():
+        total_samples = sum(samples for _, samples in functions)
+        top_functions = "<br>".join(f"{samples * 100 / total_samples:.1f}% <code>{html.escape(function_name)}</code>"
+                                    for function_name, samples in functions[:PROFILE_TOP_FUNCTIONS])
+        profiles_table.add_row([test_case_name, target_name, total_samples, top_functions])
+
+    # Note: html.unescape() prevents HTML in the cells from being escaped in the page (which prettytable
+    # seems to do).  Function names were escaped above, so C++ names with <> survive this.
+    test_page.write(html.unescape(profiles_table.get_html_string(attributes={"class": "ui celled table"})))
+
+
 def generate_test_page(database: MbedTestDatabase, test_name: str, out_path: pathlib.Path):
 
     """
-    Generate the page that shows each test case of a test and its results on each target
+    Generate the page that shows each test case of a test and its results on each target.
+    Also generates the output shard for the test, which the page loads on demand to show the output of each run.
     """
 
+    shard_path = out_path.parent / "outputs" / f"{test_name}.json.gz"
+    shard_url = f"outputs/{shard_path.name}"
+
     with open(out_path, "w", encoding="utf8") as test_page:
         write_html_header(test_page, f"Results of {test_name}")
 
@@ -399,15 +734,17 @@ def generate_test_page(database: MbedTestDatabase, test_name: str, out_path: pat
         targets_cursor.close()
 
         # Now fill in test results
-        for test_case_name, target_test_results in database.get_test_details(test_name).items():
+        test_details = database.get_test_details(test_name)
+        for test_case_idx, (test_case_name, target_test_results) in enumerate(test_details.items()):
             row_content = [test_case_name]
 
-            for target in targets_with_test_data:
+            for target_idx, target in enumerate(targets_with_test_data):
+                run_link_attrs = f'href="#run-{test_case_idx}-{target_idx}" onclick="showRunOutput(\'{shard_url}\', {test_case_idx}, {target_idx})"'
                 if target in target_test_results:
                     if target_test_results[target] == TestResult.PASSED:
-                        row_content.append(f'<div class="passed-marker"><a href="{str(get_test_case_run_path(test_name, test_case_name, target))}">Passed</a></div>')
+                        row_content.append(f'<div class="passed-marker"><a {run_link_attrs}>Passed</a></div>')
                     elif target_test_results[target] == TestResult.FAILED:
-                        row_content.append(f'<div class="failed-marker"><a href="{str(get_test_case_run_path(test_name, test_case_name, target))}">Failed</a></div>')
+                        row_content.append(f'<div class="failed-marker"><a {run_link_attrs}>Failed</a></div>')
                     elif target_test_results[target] == TestResult.PRIOR_TEST_CASE_CRASHED:
                         row_content.append('<div class="prior-crashed-marker">Prior Case Crashed</div>')
                     else:  # skipped
@@ -423,29 +760,32 @@ def generate_test_page(database: MbedTestDatabase, test_name: str, out_path: pat
         test_table.field_names = target_table_header_text
         test_page.write(html.unescape(test_table.get_html_string(attributes={"class": "ui celled table test_result_table"})))
 
-        test_page.write("\n</body>")
-
-
-def generate_test_case_run_page(database: MbedTestDatabase, test_name: str, test_case_name: str, target_name: str, out_path: pathlib.Path):
-    """
-    Generate a page that shows the result of running a test case on a target.
-    """
-    with open(out_path, "w", encoding="utf8") as test_page:
-        write_html_header(test_page, f"Test Case Output", levels_deep=3)
-        test_page.write(f'<p><a href="../../{test_name}.html">Back to {test_name} Results ^</a></p>')
+        write_test_metrics_table(database, test_name, test_page)
+        write_test_profiles_table(database, test_name, test_page)
 
+        # Modal that run outputs get shown in
         test_page.write(f"""
-<p class="ui">
-<b>Target:</b> {target_name}<br>
-<b>Test:</b> {test_name}<br>
-<b>Test Case:</b> {test_case_name}
-</p>
+<div class="ui large modal" id="run-output-modal">
+    <i class="close icon"></i>
+    <div class="header">Test Case Output</div>
+    <div class="scrolling content">
+        <p class="ui">
+        <b>Target:</b> <span id="run-output-target"></span><br>
+        <b>Test:</b> {test_name}<br>
+        <b>Test Case:</b> <span id="run-output-case"></span>
+        </p>
+        <div class="ui raised segment"><pre><code class="code" id="run-output-text"></code></pre></div>
+    </div>
+</div>
+<script src="run-output-viewer.js"></script>
+<script>showRunOutputFromLocation("{shard_url}");</script>
 """)
 
-        test_page.write(f'<div class="ui raised segment"><pre><code class="code">{database.get_test_case_run_output(test_name, test_case_name, target_name)}</code></pre></div>')
-
         test_page.write("\n</body>")
 
+    shard_path.parent.mkdir(exist_ok=True)
+    write_run_output_shard(database, test_name, list(test_details.keys()), targets_with_test_data, shard_path)
+
 
 def generate_tests_and_targets_website(database: MbedTestDatabase, gen_path: pathlib.Path):
     """
@@ -457,8 +797,9 @@ def generate_tests_and_targets_website(database: MbedTestDatabase, gen_path: pat
 
     gen_path.mkdir(exist_ok=True)
 
-    # Generate CSS
+    # Generate CSS and JS shared by all pages
     write_global_stylesheet(gen_path / "mbed-results-site.css")
+    write_global_script(gen_path / "mbed-results-site.js")
 
     # Generate drivers subdirectory
     drivers_dir = gen_path / "drivers"
@@ -485,16 +826,16 @@ def generate_tests_and_targets_website(database: MbedTestDatabase, gen_path: pat
     # Generate tests subdirectory
     tests_dir = gen_path / "tests"
     tests_dir.mkdir(exist_ok=True)
+    write_run_output_viewer_script(tests_dir / "run-output-viewer.js")
     generate_tests_index_page(database, tests_dir / "index.html")
 
     for test_name in database.get_tests():
         generate_test_page(database, test_name, tests_dir / f"{test_name}.html")
-        test_details = database.get_test_details(test_name)
 
-        for test_case_name in test_details.keys():
-            for target_name, result in test_details[test_case_name].items():
-                if result == TestResult.PASSED or result == TestResult.FAILED:
-                    run_path = tests_dir / get_test_case_run_path(test_name, test_case_name, target_name)
-                    run_path.parent.mkdir(exist_ok=True, parents=True)
-                    generate_test_case_run_page(database, test_name, test_case_name, target_name, run_path)
+    if len(database.get_targets_with_build_profile_results()) > 0:
+        generate_build_profiles_page(database, tests_dir / "build-profiles.html")
+
+    # Generate search page and index
+    generate_search_page(gen_path / "search.html")
+    write_search_index(database, gen_path / "search-index.json.gz")
 
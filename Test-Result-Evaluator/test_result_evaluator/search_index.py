@@ -0,0 +1,164 @@
+"""
+Module to build the search index for the results website.
+
+The website is fully static, so searching is done in the browser.  To keep that fast, all the expensive work
+(reading the database, extracting failure signatures from the test output, and tokenizing) is done here
+when the site is generated, and the result is saved as an inverted index: a sorted list of terms, where each
+term has a posting list of the documents (targets, drivers, tests, test cases, and failed runs) that contain it.
+The browser then only has to binary search the term list and intersect some posting lists.
+"""
+
+import gzip
+import json
+import pathlib
+import re
+from typing import Dict, List, Optional, Set
+
+from .mbed_test_database import MbedTestDatabase
+
+# Matches the line printed by Unity when an assertion fails, e.g.
+# "<greentea test suite>:55::FAIL: Expected 'complete' Was 'failed'".  The message is omitted by some assertions.
+UNITY_FAILURE_RE = re.compile(r":(\d+)::FAIL(?:: (.*))?$", re.MULTILINE)
+
+# Matches the message printed by the Mbed OS fatal error handler, e.g.
+# "Error Message: Mutex: 0x0, Not allowed in ISR context"
+MBED_ERROR_MESSAGE_RE = re.compile(r"Error Message: (.*)$", re.MULTILINE)
+
+# Characters that separate search terms.  Everything else (letters, digits, and underscores) is part of a term.
+TERM_SEPARATOR_RE = re.compile(r"[^a-z0-9_]+")
+
+# Terms longer than this are not indexed.  These are almost always addresses or hex dumps, which just bloat
+# the index.
+MAX_TERM_LENGTH = 32
+
+
+def extract_failure_signature(output: str) -> Optional[str]:
+    """
+    Extract a short, human-readable signature of why a test case failed from its output.
+    This is the first Unity assertion failure message, or failing that, the Mbed OS crash message.
+    Returns None if neither is found.
+    """
+    failure_match = UNITY_FAILURE_RE.search(output)
+    if failure_match is not None:
+        if failure_match.group(2) is None:
+            return f"Assertion failed (line {failure_match.group(1)})"
+        return f"{failure_match.group(2).strip()} (line {failure_match.group(1)})"
+
+    error_match = MBED_ERROR_MESSAGE_RE.search(output)
+    if error_match is not None:
+        return error_match.group(1).strip()
+
+    return None
+
+
+def tokenize(text: str) -> Set[str]:
+    """
+    Split text into the set of search terms it contains.
+    Note: The JavaScript tokenizer in the search page must split queries the same way.
+    """
+    return set(term for term in TERM_SEPARATOR_RE.split(text.lower()) if 0 < len(term) <= MAX_TERM_LENGTH)
+
+
+class SearchIndexBuilder:
+    """
+    Accumulates documents and builds the inverted index out of them.
+    """
+
+    def __init__(self):
+        # Each document is a list of [kind, title, URL (relative to the site root), detail text]
+        self._documents: List[List[str]] = []
+        self._postings: Dict[str, List[int]] = {}
+
+    def add_document(self, kind: str, title: str, url: str, detail: str, searchable_text: str):
+        """
+        Add a document to the index.  The kind and title are always searchable in addition to searchable_text.
+        """
+        document_id = len(self._documents)
+        self._documents.append([kind, title, url, detail])
+
+        for term in tokenize(" ".join((kind, title, searchable_text))):
+            # Document IDs are added in increasing order, so the posting lists stay sorted
+            self._postings.setdefault(term, []).append(document_id)
+
+    def to_json(self) -> dict:
+        """
+        Convert the index into its JSON representation.  Posting lists are delta-encoded to keep the file small.
+        """
+        terms = sorted(self._postings.keys())
+        postings = []
+        for term in terms:
+            deltas = []
+            prev_document_id = 0
+            for document_id in self._postings[term]:
+                deltas.append(document_id - prev_document_id)
+                prev_document_id = document_id
+            postings.append(deltas)
+
+        return {
+            "documents": self._documents,
+            "terms": terms,
+            "postings": postings
+        }
+
+
+def build_search_index(database: MbedTestDatabase) -> SearchIndexBuilder:
+    """
+    Build the search index for all the targets, drivers, tests, test cases, and failed test case runs
+    in the database.  URLs match the layout created by generate_tests_and_targets_website().
+    """
+    builder = SearchIndexBuilder()
+
+    targets_cursor = database.get_all_public_targets()
+    for row in targets_cursor:
+        mcu_family_target = row["mcuFamilyTarget"]
+        details = [detail for detail in (row["mcuVendorName"], row["mcuPartNumber"]) if detail is not None]
+        builder.add_document("target", row["name"], f"targets/{mcu_family_target}.html",
+                             " ".join(details),
+                             " ".join([mcu_family_target] + details))
+    targets_cursor.close()
+
+    for driver in sorted(database.get_all_drivers(), key=lambda driver_info: driver_info.name):
+        description = "" if driver.description is None else driver.description
+        builder.add_document("driver", driver.friendly_name, f"drivers/{driver.name}.html",
+                             description,
+                             f"{driver.name} {driver.type.value} {description}")
+
+    # Indices of the test cases and targets on each test page, used to link straight to a run's output.
+    # These must be computed the same way as in generate_test_page().
+    test_case_indices: Dict[str, Dict[str, int]] = {}
+    target_indices: Dict[str, Dict[str, int]] = {}
+
+    for test_name in database.get_tests():
+        builder.add_document("test", test_name, f"tests/{test_name}.html", "", "")
+
+        test_case_names = list(database.get_test_details(test_name).keys())
+        test_case_indices[test_name] = {case_name: case_idx for case_idx, case_name in enumerate(test_case_names)}
+        for test_case_name in test_case_names:
+            builder.add_document("case", test_case_name, f"tests/{test_name}.html", test_name, test_name)
+
+        targets_cursor = database.get_targets_with_test(test_name)
+        target_indices[test_name] = {row["targetName"]: target_idx for target_idx, row in enumerate(targets_cursor)}
+        targets_cursor.close()
+
+    for test_name, test_case_name, target_name, output in database.get_failed_test_case_runs():
+        signature = extract_failure_signature(output)
+        if signature is None:
+            signature = "No failure message found"
+
+        run_anchor = f"run-{test_case_indices[test_name][test_case_name]}-{target_indices[test_name][target_name]}"
+        builder.add_document("failure", f"{test_name} / {test_case_name} on {target_name}",
+                             f"tests/{test_name}.html#{run_anchor}",
+                             signature,
+                             f"failed {signature}")
+
+    return builder
+
+
+def write_search_index(database: MbedTestDatabase, out_path: pathlib.Path):
+    """
+    Build the search index and write it out as gzipped JSON.
+    """
+    index_json = json.dumps(build_search_index(database).to_json(), separators=(",", ":"))
+
+    # mtime=0 keeps the index byte-for-byte identical if the test results have not changed
+    out_path.write_bytes(gzip.compress(index_json.encode("UTF-8"), mtime=0))
@@ -0,0 +1,110 @@
+"""
+Module to generate the per-target latency profiles used by the native (host PC) simulation of the CI shield.
+
+The native simulation runs test code against emulated hardware with a simulated clock.  Its timing is only useful
+for performance work if it resembles real targets, so instead of guessing at the latencies of each target's HAL,
+we take them from the benchmark results that the target reported in the test database.  Each profile is a
+section of an INI-style file, which the simulation loads with native_sim::load_latency_profile().
+"""
+
+import dataclasses
+import pathlib
+import statistics
+from typing import Callable, Dict, List, Optional
+
+from .mbed_test_database import MbedTestDatabase
+
+# Clock rate used by the async SPI benchmarks in SPIBasicTest.cpp (spiFreq)
+SPI_BENCHMARK_FREQUENCY = 100000
+
+# Bits on the bus per byte
+SPI_BITS_PER_BYTE = 8
+
+PROFILE_HEADER = """# This file is generated by test_result_evaluator.generate_sim_profiles from the benchmark results in the
+# test database.  Do not edit it by hand; regenerate it instead.
+#
+# Each section is the latency profile of one target, loaded by native_sim::load_latency_profile().
+# All times are in nanoseconds.  Parameters without results for a target are left out, and the simulation uses
+# its defaults for them.
+"""
+
+
+def _us_to_ns(value: float) -> float:
+    return value * 1000
+
+
+def _overhead_per_byte(bus_frequency: int, bits_per_byte: int) -> Callable[[float], float]:
+    """
+    Make a conversion from a throughput in B/s to the time spent between bytes on top of clocking them out,
+    i.e. the driver overhead per byte.
+    """
+    def convert(throughput: float) -> float:
+        byte_time_ns = 1e9 / throughput
+        return max(0.0, byte_time_ns - bits_per_byte * 1e9 / bus_frequency)
+    return convert
+
+
+@dataclasses.dataclass
+class ProfileParameter:
+    # Name of the parameter in the profile
+    name: str
+
+    # Test, test case, and metric that the parameter is calculated from.  If test_case_name is None,
+    # the metric is averaged over every test case that reports it.
+    test_name: str
+    test_case_name: Optional[str]
+    metric_names: List[str]
+
+    # Converts the value of the metric to the value of the parameter
+    convert: Callable[[float], float]
+
+
+PROFILE_PARAMETERS = [
+    ProfileParameter("gpio_propagation_time_ns", "testshield-digitalio-prop-time", None,
+                     ["0 -> 1 propagation time", "1 -> 0 propagation time"], _us_to_ns),
+    ProfileParameter("spi_inter_byte_time_ns", "testshield-spi-basic", "Benchmark 8-Bit Async SPI via Interrupts",
+                     ["Throughput"], _overhead_per_byte(SPI_BENCHMARK_FREQUENCY, SPI_BITS_PER_BYTE)),
+    # The switch time is a difference of two timings, so on targets where switching is nearly free it can come out negative
+    ProfileParameter("spi_object_switch_time_ns", "testshield-spi-basic", "Benchmark SPI Object Switching (synchronous API)",
+                     ["Object switch time"], lambda value: max(0.0, _us_to_ns(value))),
+]
+
+
+def get_sim_profiles(database: MbedTestDatabase) -> Dict[str, Dict[str, int]]:
+    """
+    Calculate the latency profile of each target with results for any of the profile parameters.
+    Returns a dict mapping target name to the parameters that could be calculated for it.
+    """
+    profiles: Dict[str, Dict[str, int]] = {}
+    for parameter in PROFILE_PARAMETERS:
+
+        # Maps target name to the values of the metric(s) the parameter comes from
+        values: Dict[str, List[float]] = {}
+        cursor = database.get_test_metrics(parameter.test_name)
+        for row in cursor:
+            if parameter.test_case_name is not None and row["testCaseName"] != parameter.test_case_name:
+                continue
+            if row["metricName"] not in parameter.metric_names:
+                continue
+            values.setdefault(row["targetName"], []).append(row["value"])
+        cursor.close()
+
+        for target_name, target_values in values.items():
+            profiles.setdefault(target_name, {})[parameter.name] = round(parameter.convert(statistics.fmean(target_values)))
+
+    return profiles
+
+
+def write_sim_profiles(database: MbedTestDatabase, out_path: pathlib.Path):
+    """
+    Generate the latency profile file for all targets with results in the database.
+    """
+    profile_text = PROFILE_HEADER
+
+    profiles = get_sim_profiles(database)
+    for target_name in sorted(profiles.keys()):
+        profile_text += f"\n[{target_name}]\n"
+        for parameter_name, value in sorted(profiles[target_name].items()):
+            profile_text += f"{parameter_name} = {value}\n"
+
+    out_path.write_text(profile_text)
@@ -3,13 +3,15 @@ Script to parse the XML resulting from an Mbed test run and add the results to a
 """
 import pathlib
 import re
-from typing import Tuple, List
+from typing import Tuple, List, Optional, Dict
 
 import junitparser.junitparser
 from junitparser import JUnitXml
 
 from test_result_evaluator import mbed_test_database
-from test_result_evaluator.mbed_test_database import TestResult
+from test_result_evaluator.mbed_test_database import TestResult, DEFAULT_BUILD_PROFILE
+from test_result_evaluator.code_size import get_elf_memory_usage
+from test_result_evaluator.pc_profile import SymbolTable, aggregate_profile
 
 # Regexes for parsing Greentea output
 # ------------------------------------------------------------------------
@@ -20,14 +22,139 @@ GREENTEA_TESTCASE_NAME_RE = re.compile(r"\{\{__testcase_name;([^}]+)}}")
 # Matches a test case which completes (either successfully or not) and allows extracting the output
 GREENTEA_TESTCASE_OUTPUT_RE = re.compile(r"(\{\{__testcase_start;[^|]+?}}.+?\{\{__testcase_finish;[^|]+?;(\d);\d}})", re.DOTALL)
 
+# Matches a benchmark result printed by report_metric() in the CI shield tests, e.g.
+# "Metric: Mean round trip time = 1234.000 us".  Allows extracting the name, value, and unit.
+METRIC_RE = re.compile(r"Metric: (.+?) = (-?[0-9.]+(?:[eE][-+]?[0-9]+)?|-?inf|nan) ?([^\r\n]*?)\s*$", re.MULTILINE)
 
-def parse_test_run(database: mbed_test_database.MbedTestDatabase, mbed_target: str, junit_xml_path: pathlib.Path):
+# Matches the interface chip reported by a host test, e.g. "Interface chip: STM32 STLink (0483:374b)"
+INTERFACE_CHIP_RE = re.compile(r"Interface chip: ([^\r\n]+?)\s*$", re.MULTILINE)
+
+# File written into the build directory by CI-Shield-Tests/CMakeLists.txt, containing the build profile name
+BUILD_PROFILE_FILE_NAME = "ci-shield-build-profile.txt"
+
+
+def read_build_profile(elf_dir: Optional[pathlib.Path]) -> Optional[str]:
+    """
+    Get the build profile that the tests in a build directory were built with.
+    Returns None if there's no build directory or it doesn't record its build profile.
+    """
+    if elf_dir is None:
+        return None
+    build_profile_path = elf_dir / BUILD_PROFILE_FILE_NAME
+    if not build_profile_path.exists():
+        return None
+    return build_profile_path.read_text().strip()
+
+
+def add_metrics_from_output(database: mbed_test_database.MbedTestDatabase, test_name: str, test_case_name: str,
+                            mbed_target: str, output: str):
+    """
+    Add any metrics reported in the output of a test case to the database.
+    """
+    for metric_name, value, unit in re.findall(METRIC_RE, output):
+        database.add_metric_record(test_name, test_case_name, mbed_target, metric_name, float(value), unit)
+
+
+def add_profile_from_output(database: mbed_test_database.MbedTestDatabase, test_name: str, test_case_name: str,
+                            mbed_target: str, output: str, symbols: Optional[SymbolTable]):
+    """
+    Add the profile recorded in the output of a test case, if any, to the database.
+    """
+    for function_name, samples in aggregate_profile(output, symbols).items():
+        database.add_profile_record(test_name, test_case_name, mbed_target, function_name, samples)
+
+
+def find_test_elf(elf_dir: Optional[pathlib.Path], test_name: str) -> Optional[pathlib.Path]:
+    """
+    Find the ELF of a test, <test name>.elf, somewhere under elf_dir.
+    Returns None if there's no ELF directory or the test's ELF isn't in it.
+    """
+    if elf_dir is None:
+        return None
+    return next(elf_dir.rglob(f"{test_name}.elf"), None)
+
+
+def load_test_symbols(elf_dir: Optional[pathlib.Path], test_name: str) -> Optional[SymbolTable]:
+    """
+    Load the symbol table of a test from its ELF under elf_dir.
+    Returns None if there's no ELF directory or the test's ELF isn't in it.
+    """
+    elf_path = find_test_elf(elf_dir, test_name)
+    if elf_path is None:
+        return None
+    return SymbolTable.from_elf(elf_path)
+
+
+def add_code_size(database: mbed_test_database.MbedTestDatabase, test_name: str, mbed_target: str,
+                  build_profile: str, elf_dir: Optional[pathlib.Path]):
+    """
+    Record the memory used by a test's ELF under elf_dir, if it's there.
+    """
+    elf_path = find_test_elf(elf_dir, test_name)
+    if elf_path is not None:
+        flash_bytes, ram_bytes = get_elf_memory_usage(elf_path)
+        database.add_code_size_record(test_name, mbed_target, build_profile, flash_bytes, ram_bytes)
+
+
+def get_test_case_outputs(test_output: str) -> List[Tuple[str, str]]:
+    """
+    Split the output of a test into the outputs of the test cases which completed.
+    Returns a list of (test case name, output).
+    """
+    test_case_names = list(dict.fromkeys(re.findall(GREENTEA_TESTCASE_NAME_RE, test_output)))
+    test_case_records = re.findall(GREENTEA_TESTCASE_OUTPUT_RE, test_output)
+    return [(test_case_name, record[0]) for test_case_name, record in zip(test_case_names, test_case_records)]
+
+
+def parse_build_profile_run(database: mbed_test_database.MbedTestDatabase, mbed_target: str, junit_xml_path: pathlib.Path,
+                            build_profile: str, elf_dir: Optional[pathlib.Path] = None):
+    """
+    Parse a JUnit file containing a run of the tests built with a non-default build profile, and add the metrics
+    it reported (and the code size of each test, if elf_dir is given) to the database under that profile.
+    Test results are not recorded, since those come from the normal runs.
+    """
+
+    junit_report = JUnitXml.fromfile(junit_xml_path)
+
+    test_report: junitparser.junitparser.TestCase
+    for test_report in junit_report:
+        if test_report.is_skipped:
+            continue
+
+        database.clear_build_profile_metrics(test_report.classname, mbed_target, build_profile)
+        for test_case_name, output in get_test_case_outputs(test_report.system_out):
+            for metric_name, value, unit in re.findall(METRIC_RE, output):
+                database.add_build_profile_metric_record(test_report.classname, test_case_name, mbed_target, build_profile,
+                                                         metric_name, float(value), unit)
+
+        add_code_size(database, test_report.classname, mbed_target, build_profile, elf_dir)
+
+
+def parse_test_run(database: mbed_test_database.MbedTestDatabase, mbed_target: str, junit_xml_path: pathlib.Path,
+                   elf_dir: Optional[pathlib.Path] = None):
     """
     Parse a JUnit file containing a test run and add/update the test information within into the database.
+    If elf_dir is given, the test ELFs under it are used to add up any profiler samples per function, and to
+    record the code size of each test, under the build profile recorded in that directory.
     """
 
     junit_report = JUnitXml.fromfile(junit_xml_path)
 
+    # Older build directories don't record their profile, and were always built with the default one
+    build_profile = read_build_profile(elf_dir)
+    if build_profile is None:
+        build_profile = DEFAULT_BUILD_PROFILE
+
+    # Symbol table of each test, loaded the first time the test has a profile
+    test_symbols: Dict[str, Optional[SymbolTable]] = {}
+
+    def add_profile(test_name: str, test_case_name: str, output: str):
+        if "Profile: " not in output:
+            return
+        if test_name not in test_symbols:
+            test_symbols[test_name] = load_test_symbols(elf_dir, test_name)
+        add_profile_from_output(database, test_name, test_case_name, mbed_target, output, test_symbols[test_name])
+
     test_report: junitparser.junitparser.TestCase
     for test_report in junit_report:
 
@@ -39,8 +166,11 @@ def parse_test_run(database: mbed_test_database.MbedTestDatabase, mbed_target: s
         else:
             test_suite_result = TestResult.FAILED
 
+        interface_chip_match = re.search(INTERFACE_CHIP_RE, test_report.system_out)
         database.add_test_record(test_report.classname, mbed_target, test_report.time, test_suite_result,
-                                 test_report.system_out)
+                                 test_report.system_out,
+                                 interface_chip_match.group(1) if interface_chip_match is not None else None)
+        add_code_size(database, test_report.classname, mbed_target, build_profile, elf_dir)
 
         if test_suite_result != TestResult.SKIPPED:
             # Now things get a bit more complicated as we have to parse Greentea's output directly to determine
@@ -85,6 +215,9 @@ def parse_test_run(database: mbed_test_database.MbedTestDatabase, mbed_target: s
                                                       mbed_target,
                                                       TestResult.PASSED if test_case_records[test_case_idx][1] == "1" else TestResult.FAILED,
                                                       test_case_records[test_case_idx][0])
+                        add_metrics_from_output(database, test_report.classname, test_case_name, mbed_target,
+                                                test_case_records[test_case_idx][0])
+                        add_profile(test_report.classname, test_case_name, test_case_records[test_case_idx][0])
 
                     # Otherwise, mark it as prior crashed
                     else:
@@ -105,5 +238,9 @@ def parse_test_run(database: mbed_test_database.MbedTestDatabase, mbed_target: s
                                               mbed_target,
                                               test_suite_result,
                                               test_report.system_out)
+                add_metrics_from_output(database, test_report.classname, test_report.classname, mbed_target,
+                                        test_report.system_out)
+                add_profile(test_report.classname, test_report.classname, test_report.system_out)
 
-
+    # Replaced records leave their outputs behind, unless another record has the same output
+    database.delete_unused_outputs()
@@ -0,0 +1,64 @@
+"""
+Module to parse the event traces that the CI shield tests print after each test case (see
+CI-Shield-Tests/ci_test_trace.h) and render them as a text timeline.
+"""
+
+import re
+from dataclasses import dataclass
+from typing import List, Tuple
+
+# Matches one traced event, e.g. "Trace: 123456 TransferStart 32".  Allows extracting the timestamp (us),
+# event name, and argument.
+TRACE_EVENT_RE = re.compile(r"Trace: (\d+) (\w+) (\d+)\s*$", re.MULTILINE)
+
+# Matches the line printed when the trace buffer overflowed, e.g. "Trace: dropped 12 events"
+TRACE_DROPPED_RE = re.compile(r"Trace: dropped (\d+) events", re.MULTILINE)
+
+# Timestamps are the low 32 bits of the microsecond clock
+TIMESTAMP_MODULUS = 2 ** 32
+
+# Width of the bar showing the gap before each event, for the longest gap
+MAX_BAR_WIDTH = 40
+
+
+@dataclass
+class TraceEvent:
+    timestamp: int  # us
+    name: str
+    arg: int
+
+
+def parse_trace(output: str) -> Tuple[List[TraceEvent], int]:
+    """
+    Get the traced events from the output of a test case.
+    Returns (events in the order they were recorded, number of events which were dropped before them).
+    """
+    events = [TraceEvent(int(timestamp), name, int(arg)) for timestamp, name, arg in re.findall(TRACE_EVENT_RE, output)]
+    dropped = sum(int(count) for count in re.findall(TRACE_DROPPED_RE, output))
+    return events, dropped
+
+
+def render_timeline(events: List[TraceEvent], dropped: int = 0) -> str:
+    """
+    Render traced events as a text timeline.  Each line shows the time since the first event, the time since
+    the previous event (also drawn as a bar, so that long gaps stand out), and the event.
+    """
+    if len(events) == 0:
+        return "(no events traced)\n"
+
+    deltas = [0] + [(event.timestamp - previous.timestamp) % TIMESTAMP_MODULUS
+                    for previous, event in zip(events, events[1:])]
+    max_delta = max(deltas)
+
+    lines = []
+    if dropped > 0:
+        lines.append(f"({dropped} earlier events were dropped)")
+    lines.append(f"{'Time (us)':>12} {'Delta (us)':>12}  {'Event':<32} Gap")
+
+    elapsed = 0
+    for event, delta in zip(events, deltas):
+        elapsed += delta
+        bar = "#" * (round(delta * MAX_BAR_WIDTH / max_delta) if max_delta > 0 else 0)
+        lines.append(f"{elapsed:>12} {'+' + str(delta):>12}  {event.name + ' ' + str(event.arg):<32} {bar}")
+
+    return "\n".join(lines) + "\n"